@@ -3,19 +3,22 @@
         - The HW interrupt takes samples @ 10Hz from the ADC pin
         When it takes 10 samples it unblocks task A
 
-        - Task A (averageCalc) calculates the average of the 10 samples
-        and stores it in a global variable (avg)
+        - Task A (averageCalc) feeds the samples to a StreamStats and
+        stores the average of the last 10 in a global variable (avg)
 
         - Task B (terminal) reads Serial and waits for the 'avg' user command
-        when introduced, the task prints the average.
+        when introduced, the task prints the average. 'stats' prints the
+        rest: EMA, mean and std dev, min/max, percentiles.
 
-        The used circular buffer only stores 20 samples. If the user
+        The used circular buffer only stores 32 samples. If the user
         does not introduce the 'avg' command at time, avgs are lost.
 */
 
 #include <Arduino.h>
 #include <stdlib.h>
 #include <getit.h>
+#include <spscRing.h>
+#include <streamStats.h>
 
 static const BaseType_t pro_cpu = 0;
 static const BaseType_t app_cpu = 1;
@@ -46,19 +49,23 @@ static hw_timer_t *timer = NULL;
 static SemaphoreHandle_t bin_sem = NULL;
 static SemaphoreHandle_t avgMutex = NULL;
 
-enum {TAM = 20};                    //Circular buffer's size
+enum {TAM = 32};                    //Circular buffer's size (a power of 2)
 enum{MSG_LEN = 100};
-static uint16_t circBuf[TAM];       //Circular buffer   
-static uint8_t rd, wr;              //Circular buffer's head and tail
-static bool fullFlag=false;         //Flag to tell that buffer is full
+static SpscRing<uint16_t, TAM> circBuf; //Circular buffer: ISR writes, averageCalc reads
 static volatile uint8_t count=0;    //Volatile!!
 static float avg=0;                 //store the avg of samples
-
-/* Circular buffer: 3 rules
-    - When data is added, wr advances
-    - When data is consumed, rd advances
-    - If the end of the buffer is reached, pointers will wrap around to the beginning
-        This is achieved with modulus operation.
+static StreamStats<10> stats;       //avg is its moving average (Includes/streamStats.h)
+
+/* Circular buffer: SpscRing (Includes/spscRing.h)
+    - When data is added, the ISR advances head (and only the ISR writes it)
+    - When data is consumed, the task advances tail (and only the task writes it)
+    - Both just count up; the slot is index & (TAM - 1), so they wrap around
+        to the beginning without a modulus. head - tail is the number of
+        samples waiting: empty is head == tail, full is head - tail == TAM,
+        no fullFlag needed.
+
+    The sample is written before head is published (release) and read after
+    head is loaded (acquire), so it's safe even with the ISR on another core.
 */
 
 //************************************************************
@@ -68,16 +75,10 @@ void IRAM_ATTR ontimer(){
 
     BaseType_t task_woken = pdFALSE;
 
-    if(!fullFlag){
-        circBuf[wr] = analogRead(adc_pin);
-        
-        wr = (wr+1)%TAM;
+    //If the buffer is full, the sample is lost
+    if(circBuf.push(analogRead(adc_pin)))
         count++;
 
-        if(wr == rd)
-            fullFlag = true;
-    }
-
     if(count == 10){
         //Serial.println("hi!")
         count = 0;
@@ -97,19 +98,14 @@ void IRAM_ATTR ontimer(){
 
 bool isBufferEmpty(void){
 
-    if((rd == wr) && !fullFlag)
-        return true;
-    else
-        return false;   
+    return circBuf.empty();
 
 }
 
 uint16_t readCircBuf(){
     
-    uint16_t tmp;
-    tmp = circBuf[rd];
-    rd = (rd+1)%TAM;
-    fullFlag = false;
+    uint16_t tmp = 0;
+    circBuf.pop(&tmp);
     return tmp;
 
 }
@@ -150,10 +146,12 @@ void averageCalc(void * parameters){
             //mutex to keep it safe.
             xSemaphoreTake(avgMutex, portMAX_DELAY);
 
-            for (short i = 9; i >= 0; --i)
-                avg += readCircBuf();
-            
-            avg /= 10;
+            //Everything in the buffer, so no 0 is averaged in if the ISR
+            //dropped a sample. avg used to keep 1/10 of the last average.
+            while(!isBufferEmpty())
+                stats.add(readCircBuf());
+
+            avg = stats.window.mean();
 
             //return average mutex
             xSemaphoreGive(avgMutex);
@@ -178,6 +176,19 @@ void terminal(void *parameters){
             Serial.println(avg);
             xSemaphoreGive(avgMutex);
         }
+        //the rest of the statistics
+        else if(strcmp(str, "stats")==0){
+            xSemaphoreTake(avgMutex, portMAX_DELAY);
+            StatsSnapshot s = stats.snapshot();
+            xSemaphoreGive(avgMutex);
+            Serial.print("Samples: ");  Serial.println(s.count);
+            Serial.print("EMA: ");      Serial.println(s.ema);
+            Serial.print("Mean: ");     Serial.println(s.total_mean);
+            Serial.print("Std dev: ");  Serial.println(s.stddev);
+            Serial.print("Min/Max: ");  Serial.print(s.min);  Serial.print(" / ");  Serial.println(s.max);
+            Serial.print("p50/p90/p99: ");
+            Serial.print(s.p50);  Serial.print(" / ");  Serial.print(s.p90);  Serial.print(" / ");  Serial.println(s.p99);
+        }
 
         vPortFree(str); //free the command string
         // Don't hog the CPU. Yield to other tasks for a while
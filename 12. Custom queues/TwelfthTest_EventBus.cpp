@@ -0,0 +1,168 @@
+/*
+    Publish/subscribe event bus
+
+    blinkTask sends "Message received"/"blinked" to the terminal task only,
+    averageCalc keeps its average for the terminal only, and myTimerCallback
+    just prints. If a second task wanted those events we'd need a second queue
+    and a second copy of every message.
+
+    EventBus (Includes/eventBus.h) keeps the events in a pool. Publishing puts
+    a POINTER to the event in the inbox of every subscriber of that topic and
+    counts how many subscribers hold it. The last one to release it returns
+    it to the pool. No copies, whatever the number of subscribers.
+
+    This program publishes 32-byte events to 1, 2, 4, 8 and 16 subscribers
+    (spread over both cores) through:
+        - bus:    EventBus publish (one pointer per subscriber)
+        - queues: one kernel queue per subscriber (one copy per subscriber)
+    and prints the publisher's cycles per event and the total time as CSV.
+*/
+
+#include <Arduino.h>
+#include <stdlib.h>
+#include <eventBus.h>
+
+static const BaseType_t pro_cpu = 0;
+static const BaseType_t app_cpu = 1;
+
+//Settings
+enum {EVT_SIZE = 32, POOL_LEN = 32, MAX_SUBS = 16, INBOX_LEN = 32};
+enum {TOPIC_STATUS = 0};
+static const uint16_t num_events = 2000;
+static const uint8_t sub_counts[] = {1, 2, 4, 8, 16};
+
+typedef EventBus<EVT_SIZE, POOL_LEN, MAX_SUBS, INBOX_LEN> StatusBus;
+
+//Globals
+static StatusBus *bus;
+static QueueHandle_t queues[MAX_SUBS];
+static bool use_bus;
+static SemaphoreHandle_t ready_sem;     //counts subscribers ready
+static SemaphoreHandle_t done_sem;      //counts subscribers done
+static volatile uint32_t sink;
+
+//************************************************************
+//FreeRTOS TASKS
+
+void subscriber(void *parameters){
+
+    uint8_t num = (uintptr_t)parameters;     //the number travels in the pointer itself
+    uint8_t item[EVT_SIZE];
+
+    if(use_bus){
+        int8_t me = bus->subscribe(1 << TOPIC_STATUS);
+        xSemaphoreGive(ready_sem);
+        for(uint16_t i = 0; i < num_events; i++){
+            StatusBus::Event *ev = bus->receive(me, portMAX_DELAY);
+            sink += ev->data[0];
+            bus->release(ev);
+        }
+    }
+    else{
+        xSemaphoreGive(ready_sem);
+        for(uint16_t i = 0; i < num_events; i++){
+            xQueueReceive(queues[num], (void*)item, portMAX_DELAY);
+            sink += item[0];
+        }
+    }
+
+    xSemaphoreGive(done_sem);
+    vTaskDelete(NULL);
+}
+
+void runRound(uint8_t num_subs, bool bus_round){
+
+    uint8_t payload[EVT_SIZE];
+    uint32_t start, cycles = 0, elapsed;
+
+    use_bus = bus_round;
+    memset(payload, 0x55, EVT_SIZE);
+
+    if(use_bus)
+        bus = new StatusBus();
+    else
+        for(uint8_t i = 0; i < num_subs; i++)
+            queues[i] = xQueueCreate(INBOX_LEN, EVT_SIZE);
+
+    for(uint8_t i = 0; i < num_subs; i++)
+        xTaskCreatePinnedToCore(subscriber, "Sub", 2048, (void*)(uintptr_t)i, 1, NULL, (i % 2) ? app_cpu : pro_cpu);
+    for(uint8_t i = 0; i < num_subs; i++)
+        xSemaphoreTake(ready_sem, portMAX_DELAY);
+
+    elapsed = micros();
+    for(uint16_t i = 0; i < num_events; i++){
+        if(use_bus){
+            StatusBus::Event *ev;
+            //Pool empty: subscribers are behind, let them run
+            while((ev = bus->alloc()) == NULL)
+                vTaskDelay(1);
+            start = ESP.getCycleCount();
+            memcpy(ev->data, payload, EVT_SIZE);
+            ev->len = EVT_SIZE;
+            bus->publish(TOPIC_STATUS, ev);
+            cycles += ESP.getCycleCount() - start;
+        }
+        else{
+            for(uint8_t s = 0; s < num_subs; s++){
+                //Full queue: subscriber is behind, let it run (not counted)
+                while(uxQueueSpacesAvailable(queues[s]) == 0)
+                    vTaskDelay(1);
+                start = ESP.getCycleCount();
+                xQueueSend(queues[s], (void*)payload, 0);
+                cycles += ESP.getCycleCount() - start;
+            }
+        }
+    }
+
+    for(uint8_t i = 0; i < num_subs; i++)
+        xSemaphoreTake(done_sem, portMAX_DELAY);
+    elapsed = micros() - elapsed;
+
+    Serial.printf("%s,%u,%lu,%lu\n", use_bus ? "bus" : "queues", num_subs,
+                    (unsigned long)(cycles / num_events), (unsigned long)elapsed);
+
+    if(use_bus)
+        delete bus;
+    else
+        for(uint8_t i = 0; i < num_subs; i++)
+            vQueueDelete(queues[i]);
+}
+
+void benchTask(void *parameters){
+
+    Serial.println("design,subscribers,publish_cycles_per_event,total_us");
+
+    for(uint8_t i = 0; i < sizeof(sub_counts); i++){
+        runRound(sub_counts[i], true);
+        runRound(sub_counts[i], false);
+    }
+
+    Serial.println("done.");
+    vTaskDelete(NULL);
+}
+
+void setup(){
+
+    Serial.begin(115200);
+
+    vTaskDelay(1000/portTICK_PERIOD_MS);
+    Serial.println();
+    Serial.println("---FreeRTOS Event bus demo---");
+
+    ready_sem = xSemaphoreCreateCounting(MAX_SUBS, 0);
+    done_sem = xSemaphoreCreateCounting(MAX_SUBS, 0);
+
+    if(ready_sem == NULL || done_sem == NULL){
+        Serial.println("ERROR: COULD NOT CREATE SEMAPHORE");
+        ESP.restart();
+    }
+
+    //Publisher above the subscribers so it measures its own cost
+    xTaskCreatePinnedToCore(benchTask, "Bench", 4096, NULL, 2, NULL, app_cpu);
+
+    vTaskDelete(NULL);
+}
+
+void loop(){
+    //Never reached
+}
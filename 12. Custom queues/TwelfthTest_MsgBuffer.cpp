@@ -0,0 +1,171 @@
+/*
+    Variable-length message buffer
+
+    The blink struct in FourthTest_Queues_EtxekoLan.cpp and the Message struct
+    in Sixth_semaphore_2.cpp carry text in a fixed char msg[20]. A 6 character
+    command wastes 14 bytes of the slot, and anything longer than 19 is cut.
+
+    MsgBuffer (Includes/msgBuffer.h) stores each message as
+        [4-byte length][data padded to 4 bytes]
+    one after the other in a ring, so a message takes only what it needs.
+    Messages are contiguous, so the writer can build a message in place
+    (reserve/commit) and the reader can use it in place (read/release).
+
+    This program compares it with a kernel queue of fixed 64-byte slots using
+    the same amount of RAM (2 kB), sending text commands of random length:
+        1. Memory: how many messages fit before the buffer is full
+        2. Throughput: writer on core 0, reader on core 1, messages per second
+    Results are printed as CSV.
+*/
+
+#include <Arduino.h>
+#include <stdlib.h>
+#include <msgBuffer.h>
+
+static const BaseType_t pro_cpu = 0;
+static const BaseType_t app_cpu = 1;
+
+//Settings
+enum {RAM_BYTES = 2048};                    //same memory for both designs
+enum {SLOT_LEN = 64};                       //fixed slot, must hold the longest message
+enum {NUM_LENS = 256};
+static const uint32_t num_msgs = 20000;     //messages for the throughput test
+static const uint8_t min_len = 4;
+static const uint8_t max_len = SLOT_LEN;
+
+//Globals
+static MsgBuffer<RAM_BYTES> msg_buf;
+static QueueHandle_t slot_queue;
+static uint8_t lens[NUM_LENS];              //same random lengths for both tests
+static char text[SLOT_LEN];
+static SemaphoreHandle_t done_sem;
+static volatile uint32_t sink;
+
+//************************************************************
+//FreeRTOS TASKS
+
+void bufWriter(void *parameters){
+
+    for(uint32_t i = 0; i < num_msgs; i++){
+        uint8_t len = lens[i % NUM_LENS];
+        //Build the message directly in the buffer
+        uint8_t *p = msg_buf.reserve(len, portMAX_DELAY);
+        memcpy(p, text, len);
+        msg_buf.commit(len);
+    }
+    vTaskDelete(NULL);
+}
+
+void bufReader(void *parameters){
+
+    uint16_t len;
+
+    for(uint32_t i = 0; i < num_msgs; i++){
+        const uint8_t *p = msg_buf.read(&len, portMAX_DELAY);
+        sink += p[len - 1];
+        msg_buf.release();
+    }
+    xSemaphoreGive(done_sem);
+    vTaskDelete(NULL);
+}
+
+void slotWriter(void *parameters){
+
+    char slot[SLOT_LEN];
+
+    for(uint32_t i = 0; i < num_msgs; i++){
+        uint8_t len = lens[i % NUM_LENS];
+        memcpy(slot, text, len);
+        xQueueSend(slot_queue, (void*)slot, portMAX_DELAY);
+    }
+    vTaskDelete(NULL);
+}
+
+void slotReader(void *parameters){
+
+    char slot[SLOT_LEN];
+
+    for(uint32_t i = 0; i < num_msgs; i++){
+        xQueueReceive(slot_queue, (void*)slot, portMAX_DELAY);
+        sink += slot[0];
+    }
+    xSemaphoreGive(done_sem);
+    vTaskDelete(NULL);
+}
+
+void benchTask(void *parameters){
+
+    uint32_t start, elapsed, stored, payload;
+    char scratch[SLOT_LEN];
+
+    //1. Memory: fill both with no reader
+    Serial.println("design,msgs_stored,payload_bytes,ram_bytes,efficiency_pct");
+
+    stored = payload = 0;
+    while(msg_buf.send(text, lens[stored % NUM_LENS], 0) == pdTRUE)
+        payload += lens[stored++ % NUM_LENS];
+    Serial.printf("msgbuffer,%lu,%lu,%u,%lu\n", (unsigned long)stored, (unsigned long)payload,
+                    RAM_BYTES, (unsigned long)(100 * payload / RAM_BYTES));
+    while(msg_buf.receive(scratch, SLOT_LEN, 0) >= 0);
+
+    stored = payload = 0;
+    while(xQueueSend(slot_queue, (void*)text, 0) == pdTRUE)
+        payload += lens[stored++ % NUM_LENS];
+    Serial.printf("fixed_slots,%lu,%lu,%u,%lu\n", (unsigned long)stored, (unsigned long)payload,
+                    RAM_BYTES, (unsigned long)(100 * payload / RAM_BYTES));
+    while(xQueueReceive(slot_queue, (void*)scratch, 0) == pdTRUE);
+
+    //2. Throughput: writer and reader on different cores
+    Serial.println("design,msgs,elapsed_us,msgs_per_s");
+
+    start = micros();
+    xTaskCreatePinnedToCore(bufReader, "Buf reader", 2048, NULL, 1, NULL, app_cpu);
+    xTaskCreatePinnedToCore(bufWriter, "Buf writer", 2048, NULL, 1, NULL, pro_cpu);
+    xSemaphoreTake(done_sem, portMAX_DELAY);
+    elapsed = micros() - start;
+    Serial.printf("msgbuffer,%lu,%lu,%lu\n", (unsigned long)num_msgs, (unsigned long)elapsed,
+                    (unsigned long)((uint64_t)num_msgs * 1000000 / elapsed));
+
+    start = micros();
+    xTaskCreatePinnedToCore(slotReader, "Slot reader", 2048, NULL, 1, NULL, app_cpu);
+    xTaskCreatePinnedToCore(slotWriter, "Slot writer", 2048, NULL, 1, NULL, pro_cpu);
+    xSemaphoreTake(done_sem, portMAX_DELAY);
+    elapsed = micros() - start;
+    Serial.printf("fixed_slots,%lu,%lu,%lu\n", (unsigned long)num_msgs, (unsigned long)elapsed,
+                    (unsigned long)((uint64_t)num_msgs * 1000000 / elapsed));
+
+    Serial.println("done.");
+    vTaskDelete(NULL);
+}
+
+void setup(){
+
+    Serial.begin(115200);
+
+    vTaskDelay(1000/portTICK_PERIOD_MS);
+    Serial.println();
+    Serial.println("---FreeRTOS Message buffer demo---");
+
+    done_sem = xSemaphoreCreateBinary();
+    slot_queue = xQueueCreate(RAM_BYTES / SLOT_LEN, SLOT_LEN);
+
+    if(done_sem == NULL || slot_queue == NULL || !msg_buf.begin()){
+        Serial.println("ERROR: COULD NOT CREATE BUFFERS");
+        ESP.restart();
+    }
+
+    //Text commands: mostly short, a few long ones
+    randomSeed(42);
+    for(uint16_t i = 0; i < NUM_LENS; i++)
+        lens[i] = (random(4) == 0) ? random(min_len, max_len + 1) : random(min_len, 16);
+    for(uint8_t i = 0; i < SLOT_LEN; i++)
+        text[i] = 'a' + i % 26;
+
+    xTaskCreatePinnedToCore(benchTask, "Bench", 4096, NULL, 2, NULL, app_cpu);
+
+    vTaskDelete(NULL);
+}
+
+void loop(){
+    //Never reached
+}
@@ -0,0 +1,148 @@
+/*
+    Overflow policies benchmark
+
+    In FourthTest_Queues.cpp, when the sender runs every 500 ms and the reader
+    every 1000 ms, the queue fills up and xQueueSend waits 10 ticks before
+    giving up. In EigthTest_HWInterrupts_Challenge.cpp the circular buffer just
+    stops sampling when fullFlag is set. Both are "overflow policies", but
+    nobody chose them.
+
+    PolicyQueue (Includes/policyQueue.h) lets every queue pick one:
+        - QUEUE_BLOCK:       wait for a free slot (what xQueueSend does)
+        - QUEUE_DROP_NEWEST: throw the new item away
+        - QUEUE_DROP_OLDEST: overwrite the oldest item
+        - QUEUE_COALESCE:    replace the item with the same key (latest value wins),
+                             perfect for blink rates: only the last one matters
+
+    This program overloads a queue with each policy: the producer sends twice
+    as fast as the consumer reads. For every policy it prints
+        - how long the producer was stalled inside send()
+        - how many items were dropped/replaced
+        - how many items the consumer got
+*/
+
+#include <Arduino.h>
+#include <stdlib.h>
+#include <policyQueue.h>
+
+// Use only core 1 for demo purposes
+#if CONFIG_FREERTOS_UNICORE
+  static const BaseType_t app_cpu = 0;
+#else
+  static const BaseType_t app_cpu = 1;
+#endif
+
+typedef struct{
+    uint8_t led;        //which LED (the key when coalescing)
+    uint16_t rate;      //new blink rate (ms)
+}blinkRate;
+
+//Settings
+static const uint8_t msg_queue_len = 5;
+static const uint16_t num_msgs = 200;            //messages sent per policy
+static const TickType_t prod_period = 5;         //producer sends every 5 ticks
+static const TickType_t cons_period = 10;        //consumer is twice as slow
+static const TickType_t block_ticks = 10;        //like the lesson: try for 10 ticks
+static const uint8_t num_leds = 3;
+
+//Globals
+static PolicyQueue *queue;
+static volatile bool running;
+static volatile uint32_t received;
+static SemaphoreHandle_t done_sem;
+
+static const char *policy_names[] = {"block", "drop-newest", "drop-oldest", "coalesce"};
+
+//************************************************************
+//Functions
+
+uint32_t ledKey(const void *item){
+    return ((const blinkRate*)item)->led;
+}
+
+//************************************************************
+//FreeRTOS TASKS
+
+void consumer(void *parameters){
+
+    blinkRate item;
+
+    while(running || queue->waiting() > 0){
+        if(queue->receive(&item, cons_period) == pdTRUE)
+            received++;
+        vTaskDelay(cons_period);
+    }
+
+    xSemaphoreGive(done_sem);
+    vTaskDelete(NULL);
+}
+
+void benchTask(void *parameters){
+
+    blinkRate item;
+    uint32_t start, stall, worst;
+
+    Serial.println("policy,sent,received,dropped,stall_total_us,stall_max_us");
+
+    for(uint8_t p = QUEUE_BLOCK; p <= QUEUE_COALESCE; p++){
+
+        queue = new PolicyQueue();
+        if(!queue->begin(msg_queue_len, sizeof(blinkRate), (QueuePolicy)p, ledKey)){
+            Serial.println("ERROR: COULD NOT CREATE QUEUE");
+            ESP.restart();
+        }
+
+        running = true;
+        received = 0;
+        stall = worst = 0;
+        xTaskCreatePinnedToCore(consumer, "Consumer", 2048, NULL, 1, NULL, app_cpu);
+
+        for(uint16_t i = 0; i < num_msgs; i++){
+            item.led = i % num_leds;
+            item.rate = 100 + i;
+
+            //Time spent inside send is time the producer couldn't do anything else
+            start = micros();
+            queue->send(&item, block_ticks);
+            start = micros() - start;
+
+            stall += start;
+            if(start > worst)
+                worst = start;
+
+            vTaskDelay(prod_period);
+        }
+
+        running = false;
+        xSemaphoreTake(done_sem, portMAX_DELAY);
+
+        Serial.printf("%s,%u,%lu,%lu,%lu,%lu\n", policy_names[p], num_msgs,
+                        (unsigned long)received, (unsigned long)queue->dropped(),
+                        (unsigned long)stall, (unsigned long)worst);
+
+        delete queue;
+    }
+
+    Serial.println("done.");
+    vTaskDelete(NULL);
+}
+
+void setup(){
+
+    Serial.begin(115200);
+
+    vTaskDelay(1000/portTICK_PERIOD_MS);
+    Serial.println();
+    Serial.println("---FreeRTOS Queue overflow policies---");
+
+    done_sem = xSemaphoreCreateBinary();
+
+    //Producer runs at a higher priority so it isn't slowed down by the consumer
+    xTaskCreatePinnedToCore(benchTask, "Bench", 2048, NULL, 2, NULL, app_cpu);
+
+    vTaskDelete(NULL);
+}
+
+void loop(){
+    //Never reached
+}
@@ -0,0 +1,129 @@
+/*
+    Priority/deadline ordered queue
+
+    In FourthTest_Queues_EtxekoLan.cpp a new blink rate on queue1 has to wait
+    behind whatever is already in the queue, because queues are FIFO.
+    PrioQueue (Includes/prioQueue.h) gives out the message with the lowest
+    rank first, where the rank is a priority or a deadline in ticks.
+
+    Inside it's a binary heap:
+        - the most urgent message is always at the root (index 0)
+        - the children of slot i are 2i+1 and 2i+2
+        - send and receive move one entry up or down the tree, so they
+          cost O(log N) instead of O(N) for a sorted list
+
+    The first part shows an urgent message overtaking bulk status messages.
+    The second part measures the cycles of send and receive with the queue
+    filled to depths from 8 to 1024, and prints them as CSV.
+*/
+
+#include <Arduino.h>
+#include <stdlib.h>
+#include <prioQueue.h>
+
+// Use only core 1 for demo purposes
+#if CONFIG_FREERTOS_UNICORE
+  static const BaseType_t app_cpu = 0;
+#else
+  static const BaseType_t app_cpu = 1;
+#endif
+
+typedef struct{
+    char msg[20];
+    uint16_t num;
+}blink;
+
+//Settings
+enum {PRIO_URGENT = 0, PRIO_BULK = 10};
+static const uint8_t msg_queue_len = 8;
+
+//Globals
+static PrioQueue<blink, msg_queue_len> queue1;
+
+//************************************************************
+//Functions
+
+//Fill a queue of depth N with random ranks and drain it, measuring cycles
+template <uint16_t N>
+void benchDepth(){
+
+    PrioQueue<uint32_t, N> *q = new PrioQueue<uint32_t, N>();
+    uint32_t item, start, send_cycles, recv_cycles;
+
+    if(q == NULL || !q->begin()){
+        Serial.println("ERROR: COULD NOT CREATE QUEUE");
+        return;
+    }
+
+    start = ESP.getCycleCount();
+    for(uint16_t i = 0; i < N; i++)
+        q->send(i, random(0, 1000), 0);
+    send_cycles = ESP.getCycleCount() - start;
+
+    start = ESP.getCycleCount();
+    for(uint16_t i = 0; i < N; i++)
+        q->receive(&item, 0);
+    recv_cycles = ESP.getCycleCount() - start;
+
+    Serial.printf("%u,%lu,%lu\n", N, (unsigned long)(send_cycles / N), (unsigned long)(recv_cycles / N));
+
+    delete q;
+}
+
+//************************************************************
+//FreeRTOS TASKS
+
+void benchTask(void *parameters){
+
+    blink b;
+
+    //Part 1: bulk messages first, then an urgent one
+    for(uint8_t i = 0; i < 5; i++){
+        sprintf(b.msg, "status %u", i);
+        b.num = i;
+        queue1.send(b, PRIO_BULK, 10);
+    }
+    strcpy(b.msg, "delay 100");
+    b.num = 100;
+    queue1.send(b, PRIO_URGENT, 10);
+
+    Serial.println("Delivery order:");
+    while(queue1.receive(&b, 0) == pdTRUE)
+        Serial.printf("\t%s\n", b.msg);
+
+    //Part 2: cost per operation
+    Serial.println("depth,send_cycles,receive_cycles");
+    benchDepth<8>();
+    benchDepth<16>();
+    benchDepth<32>();
+    benchDepth<64>();
+    benchDepth<128>();
+    benchDepth<256>();
+    benchDepth<512>();
+    benchDepth<1024>();
+
+    Serial.println("done.");
+    vTaskDelete(NULL);
+}
+
+void setup(){
+
+    Serial.begin(115200);
+
+    vTaskDelay(1000/portTICK_PERIOD_MS);
+    Serial.println();
+    Serial.println("---FreeRTOS Priority queue demo---");
+
+    if(!queue1.begin()){
+        Serial.println("ERROR: COULD NOT CREATE QUEUE");
+        ESP.restart();
+    }
+
+    xTaskCreatePinnedToCore(benchTask, "Bench", 4096, NULL, 1, NULL, app_cpu);
+
+    vTaskDelete(NULL);
+}
+
+void loop(){
+    //Never reached
+}
@@ -0,0 +1,172 @@
+/*
+    Type-safe queue: Queue<T, N>
+
+    FourthTest_Queues_EtxekoLan.cpp builds every blink message in a local
+    variable and then xQueueSend copies it into the queue:
+
+        strcpy(b.msg, "blinked");
+        b.num = times;
+        xQueueSend(queue2, (void*)&b, 10);
+
+    and xQueueReceive copies it out again on the other side. That's two copies
+    per message, plus a (void*) cast and a sizeof that the compiler can't check.
+
+    With Queue<blink, 5> (Includes/typedQueue.h):
+        queue2.produce(10, [](blink &b){         //built directly in the slot
+            strcpy(b.msg, "blinked");
+            b.num = times;
+        });
+        queue2.consume(0, [](blink &b){ ... });  //used directly from the slot
+
+    This program sends messages of 4, 24 and 256 bytes through
+        - kernel:  xQueueSend/xQueueReceive
+        - typed:   Queue::send/receive (same copies, but type checked)
+        - emplace: Queue::emplace/consume (no copies)
+    and prints the copies and cycles per message as CSV. All three build the
+    message from the same constructor (in a local variable, or in the slot)
+    and the cycles count everything from there until the consumer read it.
+*/
+
+#include <Arduino.h>
+#include <stdlib.h>
+#include <typedQueue.h>
+
+// Use only core 1 for demo purposes
+#if CONFIG_FREERTOS_UNICORE
+  static const BaseType_t app_cpu = 0;
+#else
+  static const BaseType_t app_cpu = 1;
+#endif
+
+//Settings
+static const uint8_t msg_queue_len = 5;
+static const uint16_t num_msgs = 1000;
+
+//Globals
+static uint32_t copies = 0;          //every copy of a payload is counted here
+static volatile uint32_t sink = 0;   //so the compiler doesn't remove the reads
+
+//Payload of S bytes that counts its own copies
+template <uint16_t S>
+struct payload{
+
+    uint8_t data[S];
+
+    payload(){}
+    payload(uint32_t seed){
+        memset(data, (uint8_t)seed, S);
+    }
+    payload(const payload &o){
+        memcpy(data, o.data, S);
+        copies++;
+    }
+    payload& operator=(const payload &o){
+        memcpy(data, o.data, S);
+        copies++;
+        return *this;
+    }
+};
+
+//************************************************************
+//Functions
+
+//The kernel memcpy's the item in and out, where payload can't count it:
+//count a copy for every item that went through
+static void kernelSend(QueueHandle_t queue, const void *item){
+    if(xQueueSend(queue, item, 0) == pdTRUE)
+        copies++;
+}
+
+static void kernelReceive(QueueHandle_t queue, void *item){
+    if(xQueueReceive(queue, item, 0) == pdTRUE)
+        copies++;
+}
+
+static void printPath(uint16_t bytes, const char *path, uint32_t cycles){
+    Serial.printf("%u,%s,%lu,%lu\n", bytes, path, (unsigned long)(copies / num_msgs),
+                    (unsigned long)(cycles / num_msgs));
+}
+
+template <uint16_t S>
+void benchSize(){
+
+    typedef payload<S> msg;
+    uint32_t start, cycles;
+
+    //Kernel queue: the struct is memcpy'd in and out
+    QueueHandle_t kqueue = xQueueCreate(msg_queue_len, sizeof(msg));
+    msg out;
+
+    copies = 0;
+    start = ESP.getCycleCount();
+    for(uint16_t i = 0; i < num_msgs; i++){
+        msg local(i);
+        kernelSend(kqueue, (void*)&local);
+        kernelReceive(kqueue, (void*)&out);
+        sink += out.data[0];
+    }
+    cycles = ESP.getCycleCount() - start;
+    printPath(S, "kernel", cycles);
+    vQueueDelete(kqueue);
+
+    Queue<msg, msg_queue_len> *queue = new Queue<msg, msg_queue_len>();
+    if(queue == NULL || !queue->begin()){
+        Serial.println("ERROR: COULD NOT CREATE QUEUE");
+        return;
+    }
+
+    //Typed send/receive: same copies as the kernel, but checked by the compiler
+    copies = 0;
+    start = ESP.getCycleCount();
+    for(uint16_t i = 0; i < num_msgs; i++){
+        msg local(i);
+        queue->send(local, 0);
+        queue->receive(&out, 0);
+        sink += out.data[0];
+    }
+    cycles = ESP.getCycleCount() - start;
+    printPath(S, "typed", cycles);
+
+    //emplace/consume: built in the slot, read in the slot
+    copies = 0;
+    start = ESP.getCycleCount();
+    for(uint16_t i = 0; i < num_msgs; i++){
+        queue->emplace(0, (uint32_t)i);
+        queue->consume(0, [](msg &m){ sink += m.data[0]; });
+    }
+    cycles = ESP.getCycleCount() - start;
+    printPath(S, "emplace", cycles);
+
+    delete queue;
+}
+
+//************************************************************
+//FreeRTOS TASKS
+
+void benchTask(void *parameters){
+
+    Serial.println("bytes,path,copies_per_msg,cycles_per_msg");
+    benchSize<4>();
+    benchSize<24>();
+    benchSize<256>();
+
+    Serial.println("done.");
+    vTaskDelete(NULL);
+}
+
+void setup(){
+
+    Serial.begin(115200);
+
+    vTaskDelay(1000/portTICK_PERIOD_MS);
+    Serial.println();
+    Serial.println("---FreeRTOS Typed queue demo---");
+
+    xTaskCreatePinnedToCore(benchTask, "Bench", 4096, NULL, 1, NULL, app_cpu);
+
+    vTaskDelete(NULL);
+}
+
+void loop(){
+    //Never reached
+}
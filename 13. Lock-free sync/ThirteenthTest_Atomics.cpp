@@ -0,0 +1,177 @@
+/*
+    Atomics and seqlocks vs mutexes
+
+    FifthTest_Mutex.cpp protects shared_var++ with a mutex, and when the mutex
+    is busy incTask keeps calling xSemaphoreTake(mutex, 0) in a tight loop.
+    The HW interrupt challenges take avgMutex just to read one float.
+
+    For such small pieces of state, Includes/lockFree.h has:
+        - AtomicCounter: shared_var++ in one atomic instruction (S32C1I),
+          works across cores and inside ISRs, never blocks
+        - SeqLock<T>: readers copy a multi-word struct without locking, and
+          retry in the rare case a write happened at the same time
+
+    This program measures the cycles per operation of
+        1. A counter: mutex vs critical section (spinlock) vs atomic
+        2. A (avg, count, timestamp) snapshot: mutex vs seqlock
+    each one uncontended (one task), contended on one core (two tasks on the
+    same core) and contended on two cores (one task per core).
+    Results are printed as CSV.
+*/
+
+#include <Arduino.h>
+#include <stdlib.h>
+#include <lockFree.h>
+
+static const BaseType_t pro_cpu = 0;
+static const BaseType_t app_cpu = 1;
+
+//Settings
+static const uint32_t num_ops = 100000;     //operations per task
+
+typedef struct{
+    float avg;
+    uint32_t samples;
+    uint32_t timestamp;
+}avgSnapshot;
+
+enum method {M_MUTEX, M_SPINLOCK, M_ATOMIC, M_SNAP_MUTEX, M_SNAP_SEQLOCK};
+static const char *method_names[] = {"counter_mutex", "counter_spinlock", "counter_atomic",
+                                     "snapshot_mutex", "snapshot_seqlock"};
+
+//Globals
+static SemaphoreHandle_t mutex;
+static portMUX_TYPE spinlock = portMUX_INITIALIZER_UNLOCKED;
+static uint32_t plain_counter;
+static AtomicCounter atomic_counter;
+static avgSnapshot plain_snap;
+static SeqLock<avgSnapshot> seq_snap;
+
+static SemaphoreHandle_t done_sem;
+static volatile method current;
+static volatile uint32_t task_cycles[2];
+static volatile uint32_t sink;
+
+//************************************************************
+//FreeRTOS TASKS
+
+//Worker 0 writes, worker 1 reads (for the snapshot tests) or both increment
+void worker(void *parameters){
+
+    uint8_t num = (uintptr_t)parameters;
+    uint32_t start = ESP.getCycleCount();
+    avgSnapshot s = {0, 0, 0};
+
+    for(uint32_t i = 0; i < num_ops; i++){
+        switch(current){
+            case M_MUTEX:
+                xSemaphoreTake(mutex, portMAX_DELAY);
+                plain_counter++;
+                xSemaphoreGive(mutex);
+                break;
+            case M_SPINLOCK:
+                portENTER_CRITICAL(&spinlock);
+                plain_counter++;
+                portEXIT_CRITICAL(&spinlock);
+                break;
+            case M_ATOMIC:
+                atomic_counter.increment();
+                break;
+            case M_SNAP_MUTEX:
+                xSemaphoreTake(mutex, portMAX_DELAY);
+                if(num == 0){
+                    plain_snap.avg = i * 0.5f;
+                    plain_snap.samples = i;
+                    plain_snap.timestamp = start;
+                }
+                else
+                    s = plain_snap;
+                xSemaphoreGive(mutex);
+                sink += s.samples;
+                break;
+            case M_SNAP_SEQLOCK:
+                if(num == 0){
+                    s.avg = i * 0.5f;
+                    s.samples = i;
+                    s.timestamp = start;
+                    seq_snap.write(s);
+                }
+                else{
+                    s = seq_snap.read();
+                    sink += s.samples;
+                }
+                break;
+        }
+        //Let the other task on this core get in, so there's real contention
+        if((i & 0xFF) == 0)
+            taskYIELD();
+    }
+
+    task_cycles[num] = ESP.getCycleCount() - start;
+    xSemaphoreGive(done_sem);
+    vTaskDelete(NULL);
+}
+
+//tasks: 1 or 2, cores: where each of them runs
+void runCase(method m, uint8_t tasks, BaseType_t core0, BaseType_t core1, const char *scenario){
+
+    current = m;
+    plain_counter = 0;
+    atomic_counter.set(0);
+    task_cycles[0] = task_cycles[1] = 0;
+
+    xTaskCreatePinnedToCore(worker, "Worker 0", 2048, (void*)0, 1, NULL, core0);
+    if(tasks == 2)
+        xTaskCreatePinnedToCore(worker, "Worker 1", 2048, (void*)1, 1, NULL, core1);
+
+    for(uint8_t i = 0; i < tasks; i++)
+        xSemaphoreTake(done_sem, portMAX_DELAY);
+
+    //The counters must be exact, that's the whole point
+    uint32_t count = (m == M_ATOMIC) ? atomic_counter.get() : plain_counter;
+    bool ok = (m >= M_SNAP_MUTEX) || count == tasks * num_ops;
+
+    Serial.printf("%s,%s,%lu,%lu,%s\n", method_names[m], scenario,
+                    (unsigned long)(task_cycles[0] / num_ops), (unsigned long)(task_cycles[1] / num_ops),
+                    ok ? "ok" : "LOST UPDATES");
+}
+
+void benchTask(void *parameters){
+
+    Serial.println("method,scenario,task0_cycles_per_op,task1_cycles_per_op,check");
+
+    for(uint8_t m = M_MUTEX; m <= M_SNAP_SEQLOCK; m++){
+        runCase((method)m, 1, app_cpu, app_cpu, "uncontended");
+        runCase((method)m, 2, app_cpu, app_cpu, "same_core");
+        runCase((method)m, 2, pro_cpu, app_cpu, "cross_core");
+    }
+
+    Serial.println("done.");
+    vTaskDelete(NULL);
+}
+
+void setup(){
+
+    Serial.begin(115200);
+
+    vTaskDelay(1000/portTICK_PERIOD_MS);
+    Serial.println();
+    Serial.println("---FreeRTOS Atomics vs mutex---");
+
+    mutex = xSemaphoreCreateMutex();
+    done_sem = xSemaphoreCreateCounting(2, 0);
+
+    if(mutex == NULL || done_sem == NULL){
+        Serial.println("ERROR: COULD NOT CREATE SEMAPHORE");
+        ESP.restart();
+    }
+
+    //Bench task above the workers so it only wakes up to print
+    xTaskCreatePinnedToCore(benchTask, "Bench", 4096, NULL, 2, NULL, app_cpu);
+
+    vTaskDelete(NULL);
+}
+
+void loop(){
+    //Never reached
+}
@@ -0,0 +1,193 @@
+/*
+    Latch and barrier vs counting semaphore loops
+
+    DiningPhilosophers.cpp, PhilosopherArbitrator.cpp and Sixth_semaphore_2.cpp
+    wait for N tasks by taking a counting semaphore N times, so the waiting
+    task can wake up to N times. Includes/barrier.h has a CountdownLatch
+    that wakes it once, when the last task is done.
+
+    Part 1, join: N workers (spread over both cores) work for a random time
+    and signal that they finished. The main task waits for all of them with
+    the semaphore loop and with the latch. We count how many times it was
+    woken and how long after the last worker finished it woke up.
+
+    Part 2, rounds: P tasks meet at a barrier again and again. CyclicBarrier
+    against xEventGroupSync (the FreeRTOS way, one bit per task).
+*/
+
+#include <Arduino.h>
+#include <stdlib.h>
+#include <atomic>
+#include <barrier.h>
+#include <lockFree.h>
+
+// Use only core 1 for demo purposes
+#if CONFIG_FREERTOS_UNICORE
+  static const BaseType_t app_cpu = 0;
+#else
+  static const BaseType_t app_cpu = 1;
+#endif
+
+//Settings
+enum {MAX_WORKERS = 16};
+static const uint8_t join_counts[] = {5, 16};
+static const uint8_t join_repeats = 20;
+static const uint8_t barrier_parties[] = {2, 4, 8};
+static const uint32_t barrier_rounds = 2000;
+
+//Globals
+static SemaphoreHandle_t done_sem;
+static CountdownLatch done_latch;
+static CyclicBarrier barrier;
+static EventGroupHandle_t sync_group;
+static SemaphoreHandle_t finished;          //barrier tasks tell the bench they're gone
+
+static bool use_latch;
+static uint8_t parties;
+static std::atomic<uint32_t> last_done_us;  //when the last worker finished
+
+//************************************************************
+//Functions
+
+static uint32_t maxU32(uint32_t a, uint32_t b){
+    return a > b ? a : b;
+}
+
+//************************************************************
+//FreeRTOS TASKS
+
+void joinWorker(void *parameters){
+
+    //Random amount of work, with some of them finishing together
+    vTaskDelay(random(1, 20) / portTICK_PERIOD_MS);
+
+    uint32_t now = micros();
+    atomicUpdate(last_done_us, [now](uint32_t v){ return maxU32(v, now); });
+
+    if(use_latch)
+        done_latch.countDown();
+    else
+        xSemaphoreGive(done_sem);
+
+    vTaskDelete(NULL);
+}
+
+void barrierWorker(void *parameters){
+
+    bool use_sync = (uintptr_t)parameters & 0x100;
+    uint8_t num = (uintptr_t)parameters & 0xFF;
+    EventBits_t all = (1 << parties) - 1;
+
+    for(uint32_t i = 0; i < barrier_rounds; i++){
+        if(use_sync)
+            xEventGroupSync(sync_group, 1 << num, all, portMAX_DELAY);
+        else
+            barrier.arriveAndWait();
+    }
+
+    xSemaphoreGive(finished);
+    vTaskDelete(NULL);
+}
+
+//Returns how many times the waiter was woken, and the wake latency in latency_us
+uint32_t joinOnce(uint8_t n, uint32_t *latency_us){
+
+    uint32_t wakes = 0;
+
+    last_done_us.store(0);
+    if(use_latch)
+        done_latch.begin(n);
+
+    for(uint8_t i = 0; i < n; i++)
+        xTaskCreatePinnedToCore(joinWorker, "Worker", 2048, NULL, 1, NULL, i % 2);
+
+    if(use_latch){
+        if(done_latch.getCount() > 0)
+            wakes++;
+        done_latch.wait(portMAX_DELAY);
+    }
+    else{
+        for(uint8_t i = 0; i < n; i++){
+            //Only count the takes that really had to sleep
+            if(xSemaphoreTake(done_sem, 0) != pdTRUE){
+                wakes++;
+                xSemaphoreTake(done_sem, portMAX_DELAY);
+            }
+        }
+    }
+    *latency_us = micros() - last_done_us.load();
+
+    vTaskDelay(30 / portTICK_PERIOD_MS);    //let the idle task free the workers
+    return wakes;
+}
+
+void benchTask(void *parameters){
+
+    Serial.println("join,workers,repeats,avg_wakes,avg_latency_us,max_latency_us");
+
+    for(uint8_t c = 0; c < sizeof(join_counts); c++){
+        for(uint8_t l = 0; l < 2; l++){
+            uint32_t wakes = 0, lat, lat_total = 0, lat_max = 0;
+            use_latch = l;
+            for(uint8_t r = 0; r < join_repeats; r++){
+                wakes += joinOnce(join_counts[c], &lat);
+                lat_total += lat;
+                lat_max = maxU32(lat_max, lat);
+            }
+            Serial.printf("%s,%u,%u,%.1f,%lu,%lu\n", use_latch ? "latch" : "sem_loop", join_counts[c], join_repeats,
+                            (float)wakes / join_repeats, (unsigned long)(lat_total / join_repeats), (unsigned long)lat_max);
+        }
+    }
+
+    Serial.println("barrier,parties,rounds,us,rounds_per_s");
+
+    for(uint8_t p = 0; p < sizeof(barrier_parties); p++){
+        for(uint8_t s = 0; s < 2; s++){
+            parties = barrier_parties[p];
+            barrier.begin(parties);
+            xEventGroupClearBits(sync_group, 0xFFFF);
+
+            uint32_t start = micros();
+            for(uint8_t i = 0; i < parties; i++)
+                xTaskCreatePinnedToCore(barrierWorker, "Party", 2048, (void*)(uintptr_t)(i | (s ? 0x100 : 0)), 1, NULL, i % 2);
+            for(uint8_t i = 0; i < parties; i++)
+                xSemaphoreTake(finished, portMAX_DELAY);
+            uint32_t elapsed = micros() - start;
+
+            Serial.printf("%s,%u,%lu,%lu,%lu\n", s ? "xEventGroupSync" : "CyclicBarrier", parties,
+                            (unsigned long)barrier_rounds, (unsigned long)elapsed,
+                            (unsigned long)((uint64_t)barrier_rounds * 1000000 / elapsed));
+            vTaskDelay(30 / portTICK_PERIOD_MS);
+        }
+    }
+
+    Serial.println("done.");
+    vTaskDelete(NULL);
+}
+
+void setup(){
+
+    Serial.begin(115200);
+
+    vTaskDelay(1000 / portTICK_PERIOD_MS);
+    Serial.println();
+    Serial.println("---FreeRTOS Latch and barrier---");
+
+    done_sem = xSemaphoreCreateCounting(MAX_WORKERS, 0);
+    finished = xSemaphoreCreateCounting(MAX_WORKERS, 0);
+    sync_group = xEventGroupCreate();
+
+    if(done_sem == NULL || finished == NULL || sync_group == NULL || !done_latch.begin(0) || !barrier.begin(1)){
+        Serial.println("ERROR: COULD NOT CREATE SEMAPHORE");
+        ESP.restart();
+    }
+
+    //Higher priority than the workers, like the main task waiting on done_sem
+    xTaskCreatePinnedToCore(benchTask, "Bench", 4096, NULL, 2, NULL, app_cpu);
+
+    vTaskDelete(NULL);
+}
+
+void loop(){
+    //Never reached
+}
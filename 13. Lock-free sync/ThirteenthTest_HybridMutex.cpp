@@ -0,0 +1,187 @@
+/*
+    Hybrid mutex vs FreeRTOS mutex vs spinlock
+
+    - FreeRTOS mutex: every take/give is a kernel call, even with no contention
+    - portMUX spinlock: cheap, but disables interrupts and the other core spins
+      for the whole critical section (EleventhTest_Multicore_criticalSection.cpp)
+    - HybridMutex (Includes/hybridMutex.h): one CAS when free, a short spin if
+      the holder runs on the other core, and only then it blocks. It also
+      raises the holder's priority while a higher priority task waits.
+
+    Every combination of
+        - short critical section (a counter++) or long (~50 us of work)
+        - two tasks on the same core or one task on each core
+    is run with the three locks, printing the microseconds per lock/unlock
+    and, for the hybrid mutex, how many locks were fast/spun/blocked.
+
+    At the end, a low priority task holds the hybrid mutex while a high
+    priority task waits for it, and prints its priority to show the boost.
+*/
+
+#include <Arduino.h>
+#include <stdlib.h>
+#include <hybridMutex.h>
+
+static const BaseType_t pro_cpu = 0;
+static const BaseType_t app_cpu = 1;
+
+//Settings
+static const uint32_t num_short = 20000;    //iterations with a short critical section
+static const uint32_t num_long = 2000;      //iterations with a long critical section
+static const uint32_t long_cycles = 12000;  //~50 us at 240 MHz
+
+enum lockType {L_MUTEX, L_SPINLOCK, L_HYBRID};
+static const char *lock_names[] = {"freertos_mutex", "spinlock", "hybrid"};
+
+//Globals
+static SemaphoreHandle_t mutex;
+static portMUX_TYPE spinlock = portMUX_INITIALIZER_UNLOCKED;
+static HybridMutex hmutex;
+
+static SemaphoreHandle_t done_sem;
+static volatile lockType current;
+static volatile bool long_section;
+static volatile uint32_t counter;
+
+//************************************************************
+//Functions
+
+static void busyCycles(uint32_t cycles){
+    uint32_t start = ESP.getCycleCount();
+    while(ESP.getCycleCount() - start < cycles);
+}
+
+static void takeLock(){
+    switch(current){
+        case L_MUTEX:    xSemaphoreTake(mutex, portMAX_DELAY); break;
+        case L_SPINLOCK: portENTER_CRITICAL(&spinlock); break;
+        case L_HYBRID:   hmutex.lock(); break;
+    }
+}
+
+static void giveLock(){
+    switch(current){
+        case L_MUTEX:    xSemaphoreGive(mutex); break;
+        case L_SPINLOCK: portEXIT_CRITICAL(&spinlock); break;
+        case L_HYBRID:   hmutex.unlock(); break;
+    }
+}
+
+//************************************************************
+//FreeRTOS TASKS
+
+void worker(void *parameters){
+
+    uint32_t n = long_section ? num_long : num_short;
+
+    for(uint32_t i = 0; i < n; i++){
+        takeLock();
+        counter++;
+        if(long_section)
+            busyCycles(long_cycles);
+        giveLock();
+
+        //Let the other task on this core run now and then
+        if((i & 0x3F) == 0)
+            taskYIELD();
+    }
+
+    xSemaphoreGive(done_sem);
+    vTaskDelete(NULL);
+}
+
+void runCase(lockType l, bool long_cs, bool cross_core){
+
+    uint32_t n = long_cs ? num_long : num_short;
+    uint32_t elapsed;
+
+    current = l;
+    long_section = long_cs;
+    counter = 0;
+    hmutex.resetStats();
+
+    elapsed = micros();
+    xTaskCreatePinnedToCore(worker, "Worker 0", 2048, NULL, 1, NULL, cross_core ? pro_cpu : app_cpu);
+    xTaskCreatePinnedToCore(worker, "Worker 1", 2048, NULL, 1, NULL, app_cpu);
+    xSemaphoreTake(done_sem, portMAX_DELAY);
+    xSemaphoreTake(done_sem, portMAX_DELAY);
+    elapsed = micros() - elapsed;
+
+    Serial.printf("%s,%s,%s,%lu,%lu,%lu,%lu,%s\n", lock_names[l], long_cs ? "long" : "short",
+                    cross_core ? "cross_core" : "same_core",
+                    (unsigned long)((uint64_t)elapsed * 1000 / (2 * n)),
+                    (unsigned long)hmutex.fastCount(), (unsigned long)hmutex.spinCount(),
+                    (unsigned long)hmutex.blockCount(), counter == 2 * n ? "ok" : "LOST UPDATES");
+}
+
+//Holds the hybrid mutex for a while and prints its own priority
+void lowTask(void *parameters){
+
+    hmutex.lock();
+    Serial.printf("Low task priority before the wait: %u\n", uxTaskPriorityGet(NULL));
+    xSemaphoreGive(done_sem);                 //now start the high priority task
+    busyCycles(long_cycles * 100);
+    Serial.printf("Low task priority while high waits: %u\n", uxTaskPriorityGet(NULL));
+    hmutex.unlock();
+    Serial.printf("Low task priority after unlock: %u\n", uxTaskPriorityGet(NULL));
+
+    xSemaphoreGive(done_sem);
+    vTaskDelete(NULL);
+}
+
+void highTask(void *parameters){
+
+    hmutex.lock();
+    hmutex.unlock();
+
+    xSemaphoreGive(done_sem);
+    vTaskDelete(NULL);
+}
+
+void benchTask(void *parameters){
+
+    Serial.println("lock,section,scenario,ns_per_lock,hybrid_fast,hybrid_spun,hybrid_blocked,check");
+
+    for(uint8_t l = L_MUTEX; l <= L_HYBRID; l++){
+        runCase((lockType)l, false, false);
+        runCase((lockType)l, false, true);
+        runCase((lockType)l, true, false);
+        runCase((lockType)l, true, true);
+    }
+
+    //Priority inheritance
+    xTaskCreatePinnedToCore(lowTask, "Low", 2048, NULL, 1, NULL, app_cpu);
+    xSemaphoreTake(done_sem, portMAX_DELAY);
+    xTaskCreatePinnedToCore(highTask, "High", 2048, NULL, 3, NULL, app_cpu);
+    xSemaphoreTake(done_sem, portMAX_DELAY);
+    xSemaphoreTake(done_sem, portMAX_DELAY);
+
+    Serial.println("done.");
+    vTaskDelete(NULL);
+}
+
+void setup(){
+
+    Serial.begin(115200);
+
+    vTaskDelay(1000/portTICK_PERIOD_MS);
+    Serial.println();
+    Serial.println("---FreeRTOS Hybrid mutex---");
+
+    mutex = xSemaphoreCreateMutex();
+    done_sem = xSemaphoreCreateCounting(2, 0);
+
+    if(mutex == NULL || done_sem == NULL || !hmutex.begin()){
+        Serial.println("ERROR: COULD NOT CREATE SEMAPHORE");
+        ESP.restart();
+    }
+
+    //Bench task above the workers, on core 0 so it doesn't get in their way
+    xTaskCreatePinnedToCore(benchTask, "Bench", 4096, NULL, 2, NULL, pro_cpu);
+
+    vTaskDelete(NULL);
+}
+
+void loop(){
+    //Never reached
+}
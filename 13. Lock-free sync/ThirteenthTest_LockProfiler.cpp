@@ -0,0 +1,135 @@
+/*
+    Lock contention profiler
+
+    TenthTest_PriorityHierarchy.cpp prints how long task H waited for the lock,
+    measured by hand with xTaskGetTickCount() (1 ms resolution, one lock).
+    Includes/lockProf.h does that for every lock taken through LOCK_TAKE and
+    LOCK_GIVE, in microseconds, and tells us which lock makes tasks wait the most.
+
+    Build with the profiler on (platformio.ini):
+        build_flags = -DLOCKPROF_ENABLE=1
+    Without it, LOCK_TAKE/LOCK_GIVE are plain xSemaphoreTake/xSemaphoreGive.
+
+    Same L/M/H tasks as the priority inversion lesson, plus three workers
+    fighting for a "serial" mutex. Every 10 s the report task prints the most
+    contended locks with their wait/hold histograms, and the wait per task.
+*/
+
+#include <Arduino.h>
+#include <stdlib.h>
+#include <lockProf.h>
+
+// Use only core 1 for demo purposes
+#if CONFIG_FREERTOS_UNICORE
+  static const BaseType_t app_cpu = 0;
+#else
+  static const BaseType_t app_cpu = 1;
+#endif
+
+//Settings
+static const TickType_t cs_wait = 250;          //ms inside the critical section
+static const TickType_t med_wait = 1000;        //ms task M hogs the CPU
+static const TickType_t report_period = 10000 / portTICK_PERIOD_MS;
+static const uint8_t num_workers = 3;
+
+//Globals
+static SemaphoreHandle_t lock;
+static SemaphoreHandle_t serialMutex;
+
+//************************************************************
+//Functions
+
+static void hogMs(TickType_t ms){
+    TickType_t timestamp = xTaskGetTickCount() * portTICK_PERIOD_MS;
+    while((xTaskGetTickCount() * portTICK_PERIOD_MS) - timestamp < ms);
+}
+
+//************************************************************
+//FreeRTOS TASKS
+
+//L and H share the lock, exactly like in the priority inversion lesson
+void doTaskL(void *parameters){
+    while(1){
+        LOCK_TAKE(lock, portMAX_DELAY);
+        hogMs(cs_wait);
+        LOCK_GIVE(lock);
+        vTaskDelay(500 / portTICK_PERIOD_MS);
+    }
+}
+
+void doTaskM(void *parameters){
+    while(1){
+        hogMs(med_wait);
+        vTaskDelay(500 / portTICK_PERIOD_MS);
+    }
+}
+
+void doTaskH(void *parameters){
+    while(1){
+        LOCK_TAKE(lock, portMAX_DELAY);
+        hogMs(cs_wait);
+        LOCK_GIVE(lock);
+        vTaskDelay(500 / portTICK_PERIOD_MS);
+    }
+}
+
+//Workers hold the serial mutex for a short random time
+void worker(void *parameters){
+    while(1){
+        LOCK_TAKE(serialMutex, portMAX_DELAY);
+        delayMicroseconds(random(50, 2000));
+        LOCK_GIVE(serialMutex);
+        vTaskDelay(random(1, 5));
+    }
+}
+
+void reportTask(void *parameters){
+    while(1){
+        vTaskDelay(report_period);
+        LOCK_REPORT(5);
+    }
+}
+
+void setup(){
+
+    char task_name[12];
+
+    Serial.begin(115200);
+
+    vTaskDelay(1000 / portTICK_PERIOD_MS);
+    Serial.println();
+    Serial.println("---FreeRTOS Lock profiler demo---");
+
+#if !LOCKPROF_ENABLE
+    Serial.println("Profiler is compiled out, add -DLOCKPROF_ENABLE=1 to build_flags");
+#endif
+
+    lock = xSemaphoreCreateMutex();
+    serialMutex = xSemaphoreCreateMutex();
+
+    if(lock == NULL || serialMutex == NULL){
+        Serial.println("ERROR: COULD NOT CREATE SEMAPHORE");
+        ESP.restart();
+    }
+
+    LOCK_NAME(lock, "lock");
+    LOCK_NAME(serialMutex, "serialMutex");
+
+    xTaskCreatePinnedToCore(doTaskL, "task L", 2048, NULL, 1, NULL, app_cpu);
+    vTaskDelay(1 / portTICK_PERIOD_MS);
+    xTaskCreatePinnedToCore(doTaskH, "task H", 2048, NULL, 3, NULL, app_cpu);
+    xTaskCreatePinnedToCore(doTaskM, "task M", 2048, NULL, 2, NULL, app_cpu);
+
+    for(uint8_t i = 0; i < num_workers; i++){
+        sprintf(task_name, "Worker %u", i);
+        xTaskCreatePinnedToCore(worker, task_name, 2048, NULL, 1, NULL, 0);
+    }
+
+    xTaskCreatePinnedToCore(reportTask, "Report", 4096, NULL, 4, NULL, 0);
+
+    vTaskDelete(NULL);
+}
+
+void loop(){
+    //Never reached
+}
@@ -0,0 +1,224 @@
+/*
+    Lock-free ring vs semaphores + mutexes
+
+    Sixth_Semaphore_Challenge.cpp: producers write into a circular buffer
+    protected by prod_sem/cons_sem (counting semaphores) and headMutex/tailMutex.
+    Every item costs 5 kernel calls for the producer and 5 for the consumer.
+
+    Includes/mpmcRing.h does the same job with atomic tickets, and only calls
+    the kernel when the buffer is full or empty and someone has to wait.
+
+    This program moves items_per_prod items from every producer to the
+    consumers through both buffers, with the lesson's 5 producers / 2
+    consumers and with more tasks, all on one core and spread on both cores.
+    It prints items per second as CSV, and checks that every item arrived
+    exactly once (sum of the items).
+*/
+
+#include <Arduino.h>
+#include <stdlib.h>
+#include <atomic>
+#include <mpmcRing.h>
+#include <spawnTask.h>
+
+// Use only core 1 for demo purposes
+#if CONFIG_FREERTOS_UNICORE
+  static const BaseType_t app_cpu = 0;
+#else
+  static const BaseType_t app_cpu = 1;
+#endif
+
+//Settings
+enum {BUF_SIZE = 16};                           //Power of 2 for the ring
+static const uint32_t items_per_prod = 5000;
+static const uint32_t STOP = 0xFFFFFFFF;        //tells a consumer to finish
+
+typedef struct{
+    uint8_t producers;
+    uint8_t consumers;
+    uint8_t cores;                              //1: all on app_cpu, 2: alternate
+}benchConfig;
+
+static const benchConfig configs[] = {
+    {5, 2, 1},                                  //the lesson
+    {5, 2, 2},
+    {8, 4, 1},
+    {8, 4, 2},
+    {16, 8, 2},
+};
+
+enum backend {B_SEM, B_RING};
+static const char *backend_names[] = {"sem+mutex", "mpmc_ring"};
+
+typedef struct{
+    backend b;
+    uint8_t num;
+}workerParams;
+
+//Globals
+//The lesson's buffer
+static uint32_t buf[BUF_SIZE];
+static uint8_t head = 0;
+static uint8_t tail = 0;
+static SemaphoreHandle_t prod_sem;
+static SemaphoreHandle_t cons_sem;
+static SemaphoreHandle_t headMutex;
+static SemaphoreHandle_t tailMutex;
+
+//The lock-free one
+static MpmcRing<uint32_t, BUF_SIZE> ring;
+
+static EventGroupHandle_t start_group;          //releases all the workers at once
+static const EventBits_t GO = 1;
+static SemaphoreHandle_t done_sem;              //one give per finished worker
+static std::atomic<uint32_t> checksum;
+
+//************************************************************
+//Functions
+
+static void semSend(uint32_t item){
+    xSemaphoreTake(prod_sem, portMAX_DELAY);
+    xSemaphoreTake(headMutex, portMAX_DELAY);
+    buf[head] = item;
+    head = (head + 1) % BUF_SIZE;
+    xSemaphoreGive(headMutex);
+    xSemaphoreGive(cons_sem);
+}
+
+static uint32_t semReceive(){
+    uint32_t item;
+    xSemaphoreTake(cons_sem, portMAX_DELAY);
+    xSemaphoreTake(tailMutex, portMAX_DELAY);
+    item = buf[tail];
+    tail = (tail + 1) % BUF_SIZE;
+    xSemaphoreGive(tailMutex);
+    xSemaphoreGive(prod_sem);
+    return item;
+}
+
+static void send(backend b, uint32_t item){
+    if(b == B_SEM)
+        semSend(item);
+    else
+        ring.send(item, portMAX_DELAY);
+}
+
+static uint32_t receive(backend b){
+    uint32_t item = 0;
+    if(b == B_SEM)
+        item = semReceive();
+    else
+        ring.receive(&item, portMAX_DELAY);
+    return item;
+}
+
+//Item i of producer p, never STOP
+static uint32_t makeItem(uint8_t p, uint32_t i){
+    return ((uint32_t)p << 24) | i;
+}
+
+//************************************************************
+//FreeRTOS TASKS
+
+void producer(const workerParams &params){
+    xEventGroupWaitBits(start_group, GO, pdFALSE, pdTRUE, portMAX_DELAY);
+    for(uint32_t i = 0; i < items_per_prod; i++)
+        send(params.b, makeItem(params.num, i));
+    xSemaphoreGive(done_sem);
+}
+
+void consumer(const workerParams &params){
+    uint32_t item, sum = 0;
+    xEventGroupWaitBits(start_group, GO, pdFALSE, pdTRUE, portMAX_DELAY);
+    while((item = receive(params.b)) != STOP)
+        sum += item;
+    checksum.fetch_add(sum, std::memory_order_relaxed);
+    xSemaphoreGive(done_sem);
+}
+
+void runCase(backend b, const benchConfig &cfg){
+
+    uint32_t start, elapsed, expected = 0, total;
+    char task_name[12];
+
+    checksum.store(0);
+    xEventGroupClearBits(start_group, GO);
+
+    for(uint8_t i = 0; i < cfg.producers; i++){
+        workerParams params = {b, i};
+        sprintf(task_name, "Prod %u", i);
+        spawnTask(producer, task_name, 2048, params, 1, NULL, cfg.cores == 1 ? app_cpu : i % 2);
+        for(uint32_t n = 0; n < items_per_prod; n++)
+            expected += makeItem(i, n);
+    }
+    for(uint8_t i = 0; i < cfg.consumers; i++){
+        workerParams params = {b, i};
+        sprintf(task_name, "Cons %u", i);
+        spawnTask(consumer, task_name, 2048, params, 1, NULL, cfg.cores == 1 ? app_cpu : (i + 1) % 2);
+    }
+
+    start = micros();
+    xEventGroupSetBits(start_group, GO);
+
+    //Producers done, then one STOP per consumer (they come after all the items)
+    for(uint8_t i = 0; i < cfg.producers; i++)
+        xSemaphoreTake(done_sem, portMAX_DELAY);
+    for(uint8_t i = 0; i < cfg.consumers; i++)
+        send(b, STOP);
+    for(uint8_t i = 0; i < cfg.consumers; i++)
+        xSemaphoreTake(done_sem, portMAX_DELAY);
+    elapsed = micros() - start;
+
+    total = cfg.producers * items_per_prod;
+    Serial.printf("%s,%u,%u,%u,%lu,%lu,%lu,%s\n", backend_names[b], cfg.producers, cfg.consumers, cfg.cores,
+                    (unsigned long)total, (unsigned long)elapsed,
+                    (unsigned long)((uint64_t)total * 1000000 / elapsed),
+                    checksum.load() == expected ? "ok" : "BAD");
+
+    //Let the idle task clean up the deleted workers
+    vTaskDelay(50 / portTICK_PERIOD_MS);
+}
+
+void benchTask(void *parameters){
+
+    Serial.println("backend,producers,consumers,cores,items,us,items_per_s,check");
+
+    for(uint8_t i = 0; i < sizeof(configs) / sizeof(configs[0]); i++){
+        runCase(B_SEM, configs[i]);
+        runCase(B_RING, configs[i]);
+    }
+
+    Serial.println("done.");
+    vTaskDelete(NULL);
+}
+
+void setup(){
+
+    Serial.begin(115200);
+
+    vTaskDelay(1000 / portTICK_PERIOD_MS);
+    Serial.println();
+    Serial.println("---FreeRTOS Lock-free MPMC ring---");
+
+    prod_sem = xSemaphoreCreateCounting(BUF_SIZE, BUF_SIZE);
+    cons_sem = xSemaphoreCreateCounting(BUF_SIZE, 0);
+    headMutex = xSemaphoreCreateMutex();
+    tailMutex = xSemaphoreCreateMutex();
+    done_sem = xSemaphoreCreateCounting(64, 0);
+    start_group = xEventGroupCreate();
+
+    if(prod_sem == NULL || cons_sem == NULL || headMutex == NULL || tailMutex == NULL ||
+       done_sem == NULL || start_group == NULL || !ring.begin()){
+        Serial.println("ERROR: COULD NOT CREATE SEMAPHORE");
+        ESP.restart();
+    }
+
+    //Higher priority than the workers, so it can create them all before they start
+    xTaskCreatePinnedToCore(benchTask, "Bench", 4096, NULL, 2, NULL, app_cpu);
+
+    vTaskDelete(NULL);
+}
+
+void loop(){
+    //Never reached
+}
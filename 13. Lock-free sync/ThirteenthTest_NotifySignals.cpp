@@ -0,0 +1,213 @@
+/*
+    Give -> wake latency: semaphore vs queue vs task notification
+
+    EigthTest_HWInterrupts_3.cpp says task notifications are faster than a
+    binary semaphore, but every signal in the project still uses
+    xSemaphoreGive. This program measures it.
+
+    A bench task and a responder task play ping-pong with each mechanism:
+    the bench gives "ping", the responder wakes, gives "pong", the bench wakes.
+    The cycle counter is read by the bench only (each core has its own
+    counter), so we time the round trip and half of it is one give -> wake.
+    The responder has a higher priority, so on the same core every give
+    switches task right away; on the other core the give has to interrupt
+    the other core to wake it.
+
+    Mechanisms: binary semaphore, counting semaphore, queue of one uint32_t,
+    and NotifyBinary / NotifyCounting / NotifyBits from Includes/notifySync.h
+*/
+
+#include <Arduino.h>
+#include <stdlib.h>
+#include <notifySync.h>
+
+// Use only core 1 for demo purposes
+#if CONFIG_FREERTOS_UNICORE
+  static const BaseType_t app_cpu = 0;
+#else
+  static const BaseType_t app_cpu = 1;
+#endif
+
+//Settings
+static const uint32_t iterations = 2000;
+static const uint32_t warmup = 20;
+
+//************************************************************
+//Functions
+
+//One mechanism, seen from the task that waits on it
+class Signal{
+public:
+    Signal(const char *name) : name(name) {}
+    virtual bool begin() = 0;               //called by the waiter
+    virtual void give() = 0;
+    virtual void take() = 0;
+    const char *name;
+};
+
+class BinarySemSignal : public Signal{
+public:
+    BinarySemSignal() : Signal("binary_sem"), sem(NULL) {}
+    bool begin(){ if(sem == NULL) sem = xSemaphoreCreateBinary(); return sem != NULL; }
+    void give(){ xSemaphoreGive(sem); }
+    void take(){ xSemaphoreTake(sem, portMAX_DELAY); }
+    SemaphoreHandle_t sem;
+};
+
+class CountingSemSignal : public Signal{
+public:
+    CountingSemSignal() : Signal("counting_sem"), sem(NULL) {}
+    bool begin(){ if(sem == NULL) sem = xSemaphoreCreateCounting(10, 0); return sem != NULL; }
+    void give(){ xSemaphoreGive(sem); }
+    void take(){ xSemaphoreTake(sem, portMAX_DELAY); }
+    SemaphoreHandle_t sem;
+};
+
+class QueueSignal : public Signal{
+public:
+    QueueSignal() : Signal("queue"), queue(NULL) {}
+    bool begin(){ if(queue == NULL) queue = xQueueCreate(1, sizeof(uint32_t)); return queue != NULL; }
+    void give(){ uint32_t v = 1; xQueueSend(queue, &v, portMAX_DELAY); }
+    void take(){ uint32_t v; xQueueReceive(queue, &v, portMAX_DELAY); }
+    QueueHandle_t queue;
+};
+
+class NotifyBinarySignal : public Signal{
+public:
+    NotifyBinarySignal() : Signal("notify_binary") {}
+    bool begin(){ return event.begin(); }
+    void give(){ event.give(); }
+    void take(){ event.take(portMAX_DELAY); }
+    NotifyBinary event;
+};
+
+class NotifyCountingSignal : public Signal{
+public:
+    NotifyCountingSignal() : Signal("notify_counting") {}
+    bool begin(){ return event.begin(); }
+    void give(){ event.give(); }
+    void take(){ event.take(portMAX_DELAY); }
+    NotifyCounting event;
+};
+
+class NotifyBitsSignal : public Signal{
+public:
+    NotifyBitsSignal() : Signal("notify_bits") {}
+    bool begin(){ return bits.begin(); }
+    void give(){ bits.setBits(1); }
+    void take(){ bits.waitBits(1, pdTRUE, pdTRUE, portMAX_DELAY); }
+    NotifyBits bits;
+};
+
+typedef struct{
+    Signal *ping;                           //bench -> responder
+    Signal *pong;                           //responder -> bench
+}signalPair;
+
+static BinarySemSignal sem_ping, sem_pong;
+static CountingSemSignal csem_ping, csem_pong;
+static QueueSignal queue_ping, queue_pong;
+static NotifyBinarySignal nbin_ping, nbin_pong;
+static NotifyCountingSignal ncount_ping, ncount_pong;
+static NotifyBitsSignal nbits_ping, nbits_pong;
+
+static signalPair pairs[] = {
+    {&sem_ping, &sem_pong},
+    {&csem_ping, &csem_pong},
+    {&queue_ping, &queue_pong},
+    {&nbin_ping, &nbin_pong},
+    {&ncount_ping, &ncount_pong},
+    {&nbits_ping, &nbits_pong},
+};
+
+//************************************************************
+//FreeRTOS TASKS
+
+void responder(void *parameters){
+
+    signalPair *pair = (signalPair*)parameters;
+
+    //ping waits on us. Once it exists, tell the bench with the first pong.
+    if(!pair->ping->begin()){
+        Serial.println("ERROR: COULD NOT CREATE SIGNAL");
+        ESP.restart();
+    }
+    pair->pong->give();
+
+    for(uint32_t i = 0; i < warmup + iterations; i++){
+        pair->ping->take();
+        pair->pong->give();
+    }
+
+    vTaskDelete(NULL);
+}
+
+void runCase(signalPair &pair, BaseType_t core){
+
+    uint32_t t0, cycles, min = 0xFFFFFFFF, max = 0;
+    uint64_t total = 0;
+
+    //The notify ones are tied to their waiter, so begin() again every run
+    if(!pair.pong->begin()){
+        Serial.println("ERROR: COULD NOT CREATE SIGNAL");
+        ESP.restart();
+    }
+
+    xTaskCreatePinnedToCore(responder, "Responder", 2048, &pair, 3, NULL, core);
+    pair.pong->take();                      //responder is ready
+
+    for(uint32_t i = 0; i < warmup + iterations; i++){
+        t0 = ESP.getCycleCount();
+        pair.ping->give();
+        pair.pong->take();
+        cycles = ESP.getCycleCount() - t0;
+
+        if(i < warmup)
+            continue;
+        total += cycles;
+        if(cycles < min)
+            min = cycles;
+        if(cycles > max)
+            max = cycles;
+    }
+
+    //Half a round trip is one give -> wake
+    uint32_t avg = total / iterations;
+    Serial.printf("%s,%s,%lu,%lu,%lu,%lu,%.2f\n", pair.ping->name, core == app_cpu ? "same" : "other",
+                    (unsigned long)iterations, (unsigned long)min, (unsigned long)avg, (unsigned long)max,
+                    (float)avg / 2 / getCpuFrequencyMhz());
+
+    vTaskDelay(50 / portTICK_PERIOD_MS);
+}
+
+void benchTask(void *parameters){
+
+    Serial.println("mechanism,core,iterations,rtt_min_cycles,rtt_avg_cycles,rtt_max_cycles,one_way_avg_us");
+
+    for(uint8_t i = 0; i < sizeof(pairs) / sizeof(pairs[0]); i++){
+        runCase(pairs[i], app_cpu);
+#if !CONFIG_FREERTOS_UNICORE
+        runCase(pairs[i], 1 - app_cpu);
+#endif
+    }
+
+    Serial.println("done.");
+    vTaskDelete(NULL);
+}
+
+void setup(){
+
+    Serial.begin(115200);
+
+    vTaskDelay(1000 / portTICK_PERIOD_MS);
+    Serial.println();
+    Serial.println("---FreeRTOS Notification signals---");
+
+    xTaskCreatePinnedToCore(benchTask, "Bench", 4096, NULL, 2, NULL, app_cpu);
+
+    vTaskDelete(NULL);
+}
+
+void loop(){
+    //Never reached
+}
@@ -0,0 +1,183 @@
+/*
+    Reader-writer lock scaling
+
+    In EigthTest_HWInterrupts_Challenge.cpp and EleventhTest_Challenge.cpp,
+    averageCalc writes avg once per second, and the terminal reads it under
+    the same avgMutex. With one reader that's fine. With many readers polling
+    avg, they queue up behind each other for no reason: reading doesn't
+    change anything.
+
+    RWLock (Includes/rwLock.h) lets all readers in at once, and readers don't
+    call the kernel unless a writer is there.
+
+    This program runs one writer (updating an (avg, samples) pair every 10 ms)
+    and 1 to 8 readers spread over both cores, for one second each, first with
+    a plain mutex and then with RWLock. Every reader copies the pair and does
+    a bit of work with it inside the lock, and checks that it never sees half
+    of an update. Prints reads per second as CSV.
+*/
+
+#include <Arduino.h>
+#include <stdlib.h>
+#include <rwLock.h>
+
+static const BaseType_t pro_cpu = 0;
+static const BaseType_t app_cpu = 1;
+
+//Settings
+enum {MAX_READERS = 8};
+static const TickType_t run_time = 1000 / portTICK_PERIOD_MS;
+static const TickType_t write_period = 10 / portTICK_PERIOD_MS;
+static const uint32_t read_work = 400;          //cycles spent inside the read lock
+
+//Globals
+static SemaphoreHandle_t avgMutex;
+static RWLock avgLock;
+static bool use_rwlock;
+static volatile bool running;
+
+static float avg = 0;
+static uint32_t samples = 0;                    //always avg * 2, to check for torn reads
+
+static volatile uint32_t reads[MAX_READERS];
+static volatile uint32_t torn;
+static SemaphoreHandle_t done_sem;
+
+//************************************************************
+//Functions
+
+static void busyCycles(uint32_t cycles){
+    uint32_t start = ESP.getCycleCount();
+    while(ESP.getCycleCount() - start < cycles);
+}
+
+//************************************************************
+//FreeRTOS TASKS
+
+void writerTask(void *parameters){
+
+    TickType_t last = xTaskGetTickCount();
+
+    while(running){
+        if(use_rwlock)
+            avgLock.writeLock();
+        else
+            xSemaphoreTake(avgMutex, portMAX_DELAY);
+
+        avg += 1;
+        busyCycles(read_work);      //the two values are out of step for a while
+        samples = avg * 2;
+
+        if(use_rwlock)
+            avgLock.writeUnlock();
+        else
+            xSemaphoreGive(avgMutex);
+
+        vTaskDelayUntil(&last, write_period);
+    }
+
+    xSemaphoreGive(done_sem);
+    vTaskDelete(NULL);
+}
+
+void readerTask(void *parameters){
+
+    uint8_t num = (uintptr_t)parameters;
+    float a;
+    uint32_t s;
+
+    while(running){
+        if(use_rwlock)
+            avgLock.readLock();
+        else
+            xSemaphoreTake(avgMutex, portMAX_DELAY);
+
+        a = avg;
+        busyCycles(read_work);
+        s = samples;
+
+        if(use_rwlock)
+            avgLock.readUnlock();
+        else
+            xSemaphoreGive(avgMutex);
+
+        if(s != (uint32_t)(a * 2))
+            torn++;
+        reads[num]++;
+
+        //Readers are polling, not hogging: let the other tasks in
+        if((reads[num] & 0x0F) == 0)
+            taskYIELD();
+    }
+
+    xSemaphoreGive(done_sem);
+    vTaskDelete(NULL);
+}
+
+void runCase(uint8_t num_readers, bool rw){
+
+    uint32_t total = 0;
+
+    use_rwlock = rw;
+    running = true;
+    torn = 0;
+    avgLock.resetStats();
+    for(uint8_t i = 0; i < MAX_READERS; i++)
+        reads[i] = 0;
+
+    xTaskCreatePinnedToCore(writerTask, "Writer", 2048, NULL, 2, NULL, app_cpu);
+    for(uint8_t i = 0; i < num_readers; i++)
+        xTaskCreatePinnedToCore(readerTask, "Reader", 2048, (void*)(uintptr_t)i, 1, NULL, (i % 2) ? app_cpu : pro_cpu);
+
+    vTaskDelay(run_time);
+    running = false;
+
+    for(uint8_t i = 0; i < num_readers + 1; i++)
+        xSemaphoreTake(done_sem, portMAX_DELAY);
+
+    for(uint8_t i = 0; i < num_readers; i++)
+        total += reads[i];
+
+    Serial.printf("%s,%u,%lu,%lu,%lu\n", rw ? "rwlock" : "mutex", num_readers,
+                    (unsigned long)(total * configTICK_RATE_HZ / run_time),
+                    (unsigned long)(rw ? avgLock.slowReads() : 0), (unsigned long)torn);
+}
+
+void benchTask(void *parameters){
+
+    Serial.println("lock,readers,reads_per_s,slow_reads,torn_reads");
+
+    for(uint8_t n = 1; n <= MAX_READERS; n *= 2){
+        runCase(n, false);
+        runCase(n, true);
+    }
+
+    Serial.println("done.");
+    vTaskDelete(NULL);
+}
+
+void setup(){
+
+    Serial.begin(115200);
+
+    vTaskDelay(1000/portTICK_PERIOD_MS);
+    Serial.println();
+    Serial.println("---FreeRTOS Reader-writer lock---");
+
+    avgMutex = xSemaphoreCreateMutex();
+    done_sem = xSemaphoreCreateCounting(MAX_READERS + 1, 0);
+
+    if(avgMutex == NULL || done_sem == NULL || !avgLock.begin()){
+        Serial.println("ERROR: COULD NOT CREATE SEMAPHORE");
+        ESP.restart();
+    }
+
+    //Bench task above everyone so it wakes up on time
+    xTaskCreatePinnedToCore(benchTask, "Bench", 4096, NULL, 3, NULL, pro_cpu);
+
+    vTaskDelete(NULL);
+}
+
+void loop(){
+    //Never reached
+}
@@ -0,0 +1,148 @@
+/*
+    By-value task parameters without a handshake
+
+    FifthTest_EtxeanGaizki.cpp, Sixth_semaphore_1.cpp, Sixth_semaphore_2.cpp,
+    the semaphore challenges and the dining philosophers all pass &local to
+    xTaskCreatePinnedToCore, and then wait on a semaphore until the new task
+    has copied the value. Task N+1 can't be created until task N has run.
+
+    spawnTask (Includes/spawnTask.h) copies the parameter for the new task, so
+    the creator just goes on.
+
+    This program creates N tasks (N = 5, 10, 20, 50) that each receive their
+    number, three ways:
+        - naive:     &i without waiting (what the handshake protects against)
+        - handshake: &i and wait on a binary semaphore (the lessons)
+        - spawn:     spawnTask, no waiting
+    and prints how long the creator took, how long until every task had its
+    number, and how many tasks got the wrong number.
+*/
+
+#include <Arduino.h>
+#include <stdlib.h>
+#include <spawnTask.h>
+
+// Use only core 1 for demo purposes
+#if CONFIG_FREERTOS_UNICORE
+  static const BaseType_t app_cpu = 0;
+#else
+  static const BaseType_t app_cpu = 1;
+#endif
+
+//Settings
+enum {MAX_TASKS = 50};
+static const uint8_t task_counts[] = {5, 10, 20, 50};
+
+enum method {M_NAIVE, M_HANDSHAKE, M_SPAWN};
+static const char *method_names[] = {"naive", "handshake", "spawn"};
+
+//Globals
+static SemaphoreHandle_t bin_sem;           //handshake: parameter was copied
+static SemaphoreHandle_t done_sem;          //counts tasks that have their number
+static volatile uint8_t got[MAX_TASKS];     //how many tasks got each number
+
+//************************************************************
+//FreeRTOS TASKS
+
+static void record(uint8_t num){
+    if(num < MAX_TASKS)
+        got[num]++;
+    xSemaphoreGive(done_sem);
+}
+
+void naiveTask(void *parameters){
+    record(*(uint8_t*)parameters);
+    vTaskDelete(NULL);
+}
+
+void handshakeTask(void *parameters){
+    uint8_t num = *(uint8_t*)parameters;
+    xSemaphoreGive(bin_sem);
+    record(num);
+    vTaskDelete(NULL);
+}
+
+//With spawnTask there's no void*: the function gets its own copy
+void spawnedTask(const uint8_t &num){
+    record(num);
+}
+
+void runCase(method m, uint8_t n){
+
+    uint32_t start, create_us, all_us;
+    uint8_t wrong = 0;
+
+    for(uint8_t i = 0; i < MAX_TASKS; i++)
+        got[i] = 0;
+
+    start = micros();
+    for(uint8_t i = 0; i < n; i++){
+        switch(m){
+            case M_NAIVE:
+                xTaskCreatePinnedToCore(naiveTask, "Naive", 1024, (void*)&i, 1, NULL, app_cpu);
+                break;
+            case M_HANDSHAKE:
+                xTaskCreatePinnedToCore(handshakeTask, "Handshake", 1024, (void*)&i, 1, NULL, app_cpu);
+                xSemaphoreTake(bin_sem, portMAX_DELAY);
+                break;
+            case M_SPAWN:
+                spawnTask(spawnedTask, "Spawn", 1024, i, 1, NULL, app_cpu);
+                break;
+        }
+    }
+    create_us = micros() - start;
+
+    for(uint8_t i = 0; i < n; i++)
+        xSemaphoreTake(done_sem, portMAX_DELAY);
+    all_us = micros() - start;
+
+    for(uint8_t i = 0; i < n; i++)
+        if(got[i] != 1)
+            wrong++;
+
+    Serial.printf("%s,%u,%lu,%lu,%u\n", method_names[m], n,
+                    (unsigned long)create_us, (unsigned long)all_us, wrong);
+
+    //Give the idle task time to free the deleted tasks' memory
+    vTaskDelay(50 / portTICK_PERIOD_MS);
+}
+
+void benchTask(void *parameters){
+
+    Serial.println("method,tasks,creator_us,all_started_us,wrong_params");
+
+    for(uint8_t i = 0; i < sizeof(task_counts); i++){
+        runCase(M_NAIVE, task_counts[i]);
+        runCase(M_HANDSHAKE, task_counts[i]);
+        runCase(M_SPAWN, task_counts[i]);
+    }
+
+    Serial.println("done.");
+    vTaskDelete(NULL);
+}
+
+void setup(){
+
+    Serial.begin(115200);
+
+    vTaskDelay(1000 / portTICK_PERIOD_MS);
+    Serial.println();
+    Serial.println("---FreeRTOS By-value task parameters---");
+
+    bin_sem = xSemaphoreCreateBinary();
+    done_sem = xSemaphoreCreateCounting(MAX_TASKS, 0);
+
+    if(bin_sem == NULL || done_sem == NULL){
+        Serial.println("ERROR: COULD NOT CREATE SEMAPHORE");
+        ESP.restart();
+    }
+
+    //Same priority as the tasks it creates, like setup() in the lessons
+    xTaskCreatePinnedToCore(benchTask, "Bench", 4096, NULL, 1, NULL, app_cpu);
+
+    vTaskDelete(NULL);
+}
+
+void loop(){
+    //Never reached
+}
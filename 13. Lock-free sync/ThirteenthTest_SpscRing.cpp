@@ -0,0 +1,264 @@
+/*
+    SPSC ring: ISR to task stress test and throughput
+
+    Part 1, stress: a hardware timer ISR on core 0 pushes samples at
+    10 kHz to 200 kHz (the challenges use 10 Hz) and a task on core 1 reads
+    them, with:
+        - circbuf: the lessons' circBuf/rd/wr/fullFlag code, unchanged
+        - spsc:    Includes/spscRing.h
+    Every sample is {seq, ~seq}. The reader counts:
+        - corrupt:  seq and ~seq don't match (a half-written slot)
+        - order:    seq went backwards or repeated (stale or reread slot)
+        - missing:  seq numbers never seen, which must equal the ISR's own
+                    "ring full" count. Anything else is a lost sample.
+
+    Part 2, throughput: one task on each core moves items_tput items
+    through a SpscRing (one at a time and in blocks) and through a FreeRTOS
+    queue, and we print items per second.
+*/
+
+#include <Arduino.h>
+#include <stdlib.h>
+#include <spscRing.h>
+
+static const BaseType_t pro_cpu = 0;
+static const BaseType_t app_cpu = 1;
+
+//Settings
+static const uint16_t timer_divider = 80;                       //1 MHz
+static const uint32_t isr_periods_us[] = {100, 20, 10, 5};      //10 kHz .. 200 kHz
+static const TickType_t stress_time = 3000 / portTICK_PERIOD_MS;
+static const uint32_t wake_every = 32;                          //samples per notification
+static const uint32_t items_tput = 1000000;
+enum {TAM = 256, BLOCK = 32};
+
+typedef struct{
+    uint32_t seq;
+    uint32_t inv;               //~seq
+}Sample;
+
+enum {B_CIRCBUF, B_SPSC};
+static const char *backend_names[] = {"circbuf", "spsc"};
+
+//Globals
+static hw_timer_t *timer = NULL;
+static TaskHandle_t reader = NULL;
+static volatile uint8_t backend;
+static volatile bool stress_on;
+static volatile uint32_t isr_seq, isr_full;
+
+//The lessons' buffer, as it was
+static Sample circBuf[TAM];
+static uint8_t rd, wr;
+static bool fullFlag = false;
+
+static SpscRing<Sample, TAM> ring;
+static SpscRing<uint32_t, TAM> tput_ring;
+static QueueHandle_t tput_queue;
+static SemaphoreHandle_t done_sem;
+
+//************************************************************
+//Interrupt Service Routines - ISRs
+
+void IRAM_ATTR ontimer(){
+
+    BaseType_t task_woken = pdFALSE;
+    Sample s;
+
+    if(!stress_on)
+        return;
+
+    s.seq = isr_seq++;
+    s.inv = ~s.seq;
+
+    if(backend == B_CIRCBUF){
+        //TAM is 256, so the % of the lesson is the uint8_t wrap here
+        if(!fullFlag){
+            circBuf[wr] = s;
+            wr = (wr + 1) % TAM;
+            if(wr == rd)
+                fullFlag = true;
+        }
+        else
+            isr_full++;
+    }
+    else if(!ring.push(s))
+        isr_full++;
+
+    if(isr_seq % wake_every == 0)
+        vTaskNotifyGiveFromISR(reader, &task_woken);
+    if(task_woken)
+        portYIELD_FROM_ISR();
+}
+
+//************************************************************
+//Functions
+
+static bool readCircBuf(Sample *s){
+    if((rd == wr) && !fullFlag)
+        return false;
+    *s = circBuf[rd];
+    rd = (rd + 1) % TAM;
+    fullFlag = false;
+    return true;
+}
+
+//************************************************************
+//FreeRTOS TASKS
+
+//Pinned to core 0, so the timer interrupt is allocated there
+void timerTask(void *parameters){
+    timer = timerBegin(0, timer_divider, true);
+    timerAttachInterrupt(timer, &ontimer, true);
+    xSemaphoreGive(done_sem);
+    vTaskDelete(NULL);
+}
+
+static void stress(uint8_t b, uint32_t period_us){
+
+    uint32_t corrupt = 0, order = 0, missing = 0, got = 0;
+    uint32_t expected = 0;
+    Sample s;
+
+    backend = b;
+    rd = wr = 0;
+    fullFlag = false;
+    while(ring.pop(&s));
+    isr_seq = isr_full = 0;
+
+    stress_on = true;
+    timerAlarmWrite(timer, period_us, true);
+    timerAlarmEnable(timer);
+
+    TickType_t end = xTaskGetTickCount() + stress_time;
+    while(stress_on){
+        if((int32_t)(end - xTaskGetTickCount()) <= 0){
+            //Stop the ISR, then one last pass to drain what's left
+            stress_on = false;
+            timerAlarmDisable(timer);
+        }
+        else
+            ulTaskNotifyTake(pdTRUE, 10 / portTICK_PERIOD_MS);
+
+        while(b == B_CIRCBUF ? readCircBuf(&s) : ring.pop(&s)){
+            got++;
+            if(s.inv != ~s.seq)
+                corrupt++;
+            else if(s.seq < expected)
+                order++;
+            else{
+                missing += s.seq - expected;
+                expected = s.seq + 1;
+            }
+        }
+    }
+    missing += isr_seq - expected;
+
+    Serial.printf("%s,%lu,%lu,%lu,%lu,%lu,%lu,%ld\n", backend_names[b], (unsigned long)(1000000 / period_us),
+                    (unsigned long)isr_seq, (unsigned long)got, (unsigned long)isr_full,
+                    (unsigned long)corrupt, (unsigned long)order, (long)(missing - isr_full));
+}
+
+enum {T_SPSC, T_SPSC_BLOCK, T_QUEUE};
+static const char *tput_names[] = {"spsc", "spsc_block", "queue"};
+
+void producerTask(void *parameters){
+
+    uint8_t mode = (uintptr_t)parameters;
+    uint32_t block[BLOCK];
+
+    for(uint32_t i = 0; i < items_tput;){
+        if(mode == T_SPSC){
+            if(tput_ring.push(i))
+                i++;
+        }
+        else if(mode == T_SPSC_BLOCK){
+            uint32_t n = items_tput - i < (uint32_t)BLOCK ? items_tput - i : (uint32_t)BLOCK;
+            for(uint32_t k = 0; k < n; k++)
+                block[k] = i + k;
+            i += tput_ring.pushBlock(block, n);
+        }
+        else{
+            xQueueSend(tput_queue, &i, portMAX_DELAY);
+            i++;
+        }
+    }
+    vTaskDelete(NULL);
+}
+
+static void throughput(uint8_t mode){
+
+    uint32_t next = 0, bad = 0, block[BLOCK], v;
+
+    uint32_t t0 = micros();
+    xTaskCreatePinnedToCore(producerTask, "Producer", 2048, (void*)(uintptr_t)mode, 1, NULL, pro_cpu);
+
+    while(next < items_tput){
+        if(mode == T_SPSC){
+            if(tput_ring.pop(&v)){
+                bad += v != next;
+                next++;
+            }
+        }
+        else if(mode == T_SPSC_BLOCK){
+            uint32_t n = tput_ring.popBlock(block, BLOCK);
+            for(uint32_t k = 0; k < n; k++, next++)
+                bad += block[k] != next;
+        }
+        else{
+            xQueueReceive(tput_queue, &v, portMAX_DELAY);
+            bad += v != next;
+            next++;
+        }
+    }
+    uint32_t elapsed = micros() - t0;
+
+    Serial.printf("%s,%lu,%lu,%.0f,%lu\n", tput_names[mode], (unsigned long)items_tput, (unsigned long)elapsed,
+                    items_tput * 1e6f / elapsed, (unsigned long)bad);
+}
+
+void benchTask(void *parameters){
+
+    reader = xTaskGetCurrentTaskHandle();
+
+    Serial.println("buffer,rate_hz,pushed,read,ring_full,corrupt,order,lost");
+    for(uint8_t p = 0; p < sizeof(isr_periods_us) / sizeof(isr_periods_us[0]); p++)
+        for(uint8_t b = B_CIRCBUF; b <= B_SPSC; b++)
+            stress(b, isr_periods_us[p]);
+
+    Serial.println("mode,items,us,items_per_s,bad");
+    for(uint8_t m = T_SPSC; m <= T_QUEUE; m++)
+        throughput(m);
+
+    Serial.println("done.");
+    vTaskDelete(NULL);
+}
+
+void setup(){
+
+    Serial.begin(115200);
+
+    vTaskDelay(1000 / portTICK_PERIOD_MS);
+    Serial.println();
+    Serial.println("---FreeRTOS SPSC ring---");
+
+    done_sem = xSemaphoreCreateBinary();
+    tput_queue = xQueueCreate(TAM, sizeof(uint32_t));
+
+    if(done_sem == NULL || tput_queue == NULL){
+        Serial.println("ERROR: COULD NOT CREATE QUEUE");
+        ESP.restart();
+    }
+
+    //ISR on core 0, reader on core 1
+    xTaskCreatePinnedToCore(timerTask, "Timer", 2048, NULL, 1, NULL, pro_cpu);
+    xSemaphoreTake(done_sem, portMAX_DELAY);
+
+    xTaskCreatePinnedToCore(benchTask, "Bench", 4096, NULL, 1, NULL, app_cpu);
+
+    vTaskDelete(NULL);
+}
+
+void loop(){
+    //Never reached
+}
@@ -0,0 +1,90 @@
+/*
+    Producer/consumer benchmark sweep
+
+    Sixth_Semaphore_Challenge.cpp and Sixth_Challenge_2.cpp solve the same
+    problem (5 producers, 2 consumers, a 10 item buffer) with semaphores +
+    mutexes and with a queue. Includes/pcBench.h runs that topology with any
+    number of tasks, buffer size, payload, priorities and cores, and measures
+    it instead of printing the values.
+
+    This program runs every scenario in the table with every backend and
+    prints one CSV line per run (paste the output into a spreadsheet):
+        - the lesson itself, on one core and on both
+        - more producers/consumers
+        - bigger buffers and payloads
+        - consumers with higher priority than producers, and the reverse
+        - consumers that do some work per item
+*/
+
+#include <Arduino.h>
+#include <stdlib.h>
+#include <pcBench.h>
+
+// Use only core 1 for demo purposes
+#if CONFIG_FREERTOS_UNICORE
+  static const BaseType_t app_cpu = 0;
+#else
+  static const BaseType_t app_cpu = 1;
+#endif
+
+//Settings
+static const uint32_t items_per_prod = 2000;
+
+//producers, consumers, buf_len, payload, prod_prio, cons_prio, prod_core, cons_core, items_per_prod,
+//work_cycles, heavy_every, heavy_cycles
+static const pcConfig scenarios[] = {
+    {5, 2, 10, 8, 1, 1, app_cpu, app_cpu, items_per_prod, 0, 0, 0},      //the lesson
+    {5, 2, 10, 8, 1, 1, PC_SPREAD, PC_SPREAD, items_per_prod, 0, 0, 0},
+    {8, 4, 10, 8, 1, 1, PC_SPREAD, PC_SPREAD, items_per_prod, 0, 0, 0},
+    {16, 8, 32, 8, 1, 1, PC_SPREAD, PC_SPREAD, items_per_prod, 0, 0, 0},
+    {5, 2, 64, 8, 1, 1, PC_SPREAD, PC_SPREAD, items_per_prod, 0, 0, 0},
+    {5, 2, 256, 8, 1, 1, PC_SPREAD, PC_SPREAD, items_per_prod, 0, 0, 0},
+    {5, 2, 10, 64, 1, 1, PC_SPREAD, PC_SPREAD, items_per_prod, 0, 0, 0},
+    {5, 2, 10, 256, 1, 1, PC_SPREAD, PC_SPREAD, items_per_prod, 0, 0, 0},
+    {5, 2, 10, 8, 1, 2, app_cpu, app_cpu, items_per_prod, 0, 0, 0},      //consumers first
+    {5, 2, 10, 8, 2, 1, app_cpu, app_cpu, items_per_prod, 0, 0, 0},      //producers first
+    {5, 2, 10, 8, 1, 1, 0, 1, items_per_prod, 0, 0, 0},                  //one core each side
+    {5, 2, 10, 8, 1, 1, PC_SPREAD, PC_SPREAD, items_per_prod, 2400, 0, 0},   //~10 us of work
+};
+
+//************************************************************
+//FreeRTOS TASKS
+
+void benchTask(void *parameters){
+
+    pcBackend *backends[] = {&pcSemMutex(), &pcKernelQueue(), &pcLockFree(), &pcWorkStealing()};
+    pcResult res;
+
+    pcPrintHeader();
+
+    for(uint8_t s = 0; s < sizeof(scenarios) / sizeof(scenarios[0]); s++){
+        for(uint8_t b = 0; b < sizeof(backends) / sizeof(backends[0]); b++){
+            if(!pcRun(*backends[b], scenarios[s], &res)){
+                Serial.printf("ERROR: scenario %u could not run on %s\n", s, backends[b]->name());
+                continue;
+            }
+            pcPrintResult(*backends[b], scenarios[s], res);
+        }
+    }
+
+    Serial.println("done.");
+    vTaskDelete(NULL);
+}
+
+void setup(){
+
+    Serial.begin(115200);
+
+    vTaskDelay(1000 / portTICK_PERIOD_MS);
+    Serial.println();
+    Serial.println("---FreeRTOS Producer/consumer benchmark---");
+
+    //Above every worker priority used in the scenarios
+    xTaskCreatePinnedToCore(benchTask, "Bench", 4096, NULL, 5, NULL, app_cpu);
+
+    vTaskDelete(NULL);
+}
+
+void loop(){
+    //Never reached
+}
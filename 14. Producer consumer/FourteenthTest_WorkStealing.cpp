@@ -0,0 +1,84 @@
+/*
+    Work stealing vs one shared queue, with skewed item costs
+
+    In Sixth_Challenge_2.cpp both consumers pull from one queue. Here the
+    consumers do real work per item, and some items are much more expensive
+    than the rest (like a consumer stuck printing while holding serialMutex).
+    We look at what that does to the latency of the OTHER items, in
+    particular the p99 and max, with:
+        - kernel_queue:  the lesson's shared FreeRTOS queue
+        - lock_free:     a shared MpmcRing (Includes/mpmcRing.h)
+        - work_stealing: one deque per consumer, idle consumers steal the
+                         backlog of busy ones (Includes/workPool.h)
+
+    Runs on Includes/pcBench.h, so the CSV has the same columns as
+    FourteenthTest_PCHarness.cpp.
+*/
+
+#include <Arduino.h>
+#include <stdlib.h>
+#include <pcBench.h>
+
+// Use only core 1 for demo purposes
+#if CONFIG_FREERTOS_UNICORE
+  static const BaseType_t app_cpu = 0;
+#else
+  static const BaseType_t app_cpu = 1;
+#endif
+
+//Settings
+static const uint32_t items_per_prod = 1000;
+static const uint32_t light_cycles = 2400;          //~10 us at 240 MHz
+static const uint32_t heavy_cycles = 240000;        //~1 ms
+
+//producers, consumers, buf_len, payload, prod_prio, cons_prio, prod_core, cons_core, items_per_prod,
+//work_cycles, heavy_every, heavy_cycles
+static const pcConfig scenarios[] = {
+    {5, 2, 32, 8, 1, 1, PC_SPREAD, PC_SPREAD, items_per_prod, light_cycles, 0, 0},             //no skew
+    {5, 2, 32, 8, 1, 1, PC_SPREAD, PC_SPREAD, items_per_prod, light_cycles, 100, heavy_cycles},
+    {5, 2, 32, 8, 1, 1, PC_SPREAD, PC_SPREAD, items_per_prod, light_cycles, 20, heavy_cycles},
+    {5, 4, 64, 8, 1, 1, PC_SPREAD, PC_SPREAD, items_per_prod, light_cycles, 20, heavy_cycles},
+    {8, 4, 64, 8, 1, 1, PC_SPREAD, PC_SPREAD, items_per_prod, light_cycles, 10, heavy_cycles},
+    {8, 8, 128, 8, 1, 1, PC_SPREAD, PC_SPREAD, items_per_prod, light_cycles, 10, heavy_cycles},
+};
+
+//************************************************************
+//FreeRTOS TASKS
+
+void benchTask(void *parameters){
+
+    pcBackend *backends[] = {&pcKernelQueue(), &pcLockFree(), &pcWorkStealing()};
+    pcResult res;
+
+    pcPrintHeader();
+
+    for(uint8_t s = 0; s < sizeof(scenarios) / sizeof(scenarios[0]); s++){
+        for(uint8_t b = 0; b < sizeof(backends) / sizeof(backends[0]); b++){
+            if(!pcRun(*backends[b], scenarios[s], &res)){
+                Serial.printf("ERROR: scenario %u could not run on %s\n", s, backends[b]->name());
+                continue;
+            }
+            pcPrintResult(*backends[b], scenarios[s], res);
+        }
+    }
+
+    Serial.println("done.");
+    vTaskDelete(NULL);
+}
+
+void setup(){
+
+    Serial.begin(115200);
+
+    vTaskDelay(1000 / portTICK_PERIOD_MS);
+    Serial.println();
+    Serial.println("---FreeRTOS Work-stealing consumer pool---");
+
+    xTaskCreatePinnedToCore(benchTask, "Bench", 4096, NULL, 5, NULL, app_cpu);
+
+    vTaskDelete(NULL);
+}
+
+void loop(){
+    //Never reached
+}
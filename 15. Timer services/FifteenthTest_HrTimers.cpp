@@ -0,0 +1,144 @@
+/*
+    Microsecond timers on one hardware timer
+
+    SeventhTest_SWTimers.cpp can't go below one tick (1 ms), and the HW
+    interrupt lessons spend a whole hardware timer on one period. Here one
+    hardware timer (Includes/hrTimer.h) runs several timers at once, periodic
+    and one-shot, some with the callback in the ISR and some in the service's
+    dispatch task.
+
+    Everything runs for a few seconds, then each timer reports how many
+    times it fired (against the expected count) and how late its callbacks
+    ran: average and max, in us. A task keeps core 1 busy in the meantime, like
+    the lessons' hog tasks, to show that ISR callbacks don't care and task
+    callbacks only depend on their priority.
+*/
+
+#include <Arduino.h>
+#include <stdlib.h>
+#include <hrTimer.h>
+
+// Use only core 1 for demo purposes
+#if CONFIG_FREERTOS_UNICORE
+  static const BaseType_t app_cpu = 0;
+#else
+  static const BaseType_t app_cpu = 1;
+#endif
+
+//Settings
+static const TickType_t run_time = 5000 / portTICK_PERIOD_MS;
+
+struct TimerSetup{
+    const char *name;
+    HrDispatch dispatch;
+    uint32_t period_us;         //0: one-shot, restarted by its callback with a random delay
+};
+
+static const TimerSetup setups[] = {
+    {"isr_50us",   HR_IN_ISR,  50},
+    {"isr_100us",  HR_IN_ISR,  100},
+    {"task_250us", HR_IN_TASK, 250},
+    {"task_1ms",   HR_IN_TASK, 1000},
+    {"isr_once",   HR_IN_ISR,  0},
+    {"task_once",  HR_IN_TASK, 0},
+};
+enum {TIMERS = sizeof(setups) / sizeof(setups[0])};
+static const uint32_t once_min_us = 30, once_max_us = 500;
+
+//Globals
+static HrTimerService hr;
+static HrTimer timers[TIMERS];
+static volatile bool running;
+
+//************************************************************
+//Functions
+
+//random() isn't meant for ISRs: a small LCG is enough here
+static uint32_t IRAM_ATTR nextDelay(){
+    static uint32_t seed = 12345;
+    seed = seed * 1664525 + 1013904223;
+    return once_min_us + (seed >> 8) % (once_max_us - once_min_us);
+}
+
+//Callback functions
+void IRAM_ATTR timerCallback(HrTimer *timer){
+    //One-shots keep themselves going until the end of the run
+    if(timer->period == 0 && running)
+        hr.startOnce(timer, nextDelay());
+}
+
+//************************************************************
+//FreeRTOS TASKS
+
+void hogTask(void *parameters){
+    while(1){
+        uint32_t t0 = millis();
+        while(millis() - t0 < 50);
+        vTaskDelay(1);
+    }
+}
+
+void benchTask(void *parameters){
+
+    uint32_t irqs;
+    uint64_t t_start, elapsed;
+
+    for(uint8_t i = 0; i < TIMERS; i++)
+        hr.init(&timers[i], timerCallback, (void*)setups[i].name, setups[i].dispatch);
+
+    running = true;
+    t_start = hr.now();
+    irqs = hr.interrupts();
+    for(uint8_t i = 0; i < TIMERS; i++){
+        if(setups[i].period_us)
+            hr.startPeriodic(&timers[i], setups[i].period_us);
+        else
+            hr.startOnce(&timers[i], nextDelay());
+    }
+
+    vTaskDelay(run_time);
+
+    running = false;
+    for(uint8_t i = 0; i < TIMERS; i++)
+        hr.stop(&timers[i]);
+    elapsed = hr.now() - t_start;
+    irqs = hr.interrupts() - irqs;
+
+    Serial.println("timer,dispatch,period_us,fired,expected,overruns,late_avg_us,late_max_us");
+    for(uint8_t i = 0; i < TIMERS; i++){
+        HrTimer *t = &timers[i];
+        uint32_t expected = setups[i].period_us ? elapsed / setups[i].period_us : 0;
+        Serial.printf("%s,%s,%lu,%lu,%lu,%lu,%.2f,%lu\n", (const char*)t->arg,
+                        t->dispatch == HR_IN_ISR ? "isr" : "task", (unsigned long)setups[i].period_us,
+                        (unsigned long)t->fired, (unsigned long)expected, (unsigned long)t->overruns,
+                        t->fired ? (float)t->late_sum / t->fired : 0.0f, (unsigned long)t->late_max);
+    }
+    Serial.printf("interrupts: %lu in %lu us\n", (unsigned long)irqs, (unsigned long)elapsed);
+
+    Serial.println("done.");
+    vTaskDelete(NULL);
+}
+
+void setup(){
+
+    Serial.begin(115200);
+
+    vTaskDelay(1000 / portTICK_PERIOD_MS);
+    Serial.println();
+    Serial.println("---FreeRTOS Microsecond timers---");
+
+    //Interrupt on the core running setup(), dispatch task above everything
+    if(!hr.begin(0, configMAX_PRIORITIES - 1, app_cpu)){
+        Serial.println("ERROR: COULD NOT START TIMER SERVICE");
+        ESP.restart();
+    }
+
+    xTaskCreatePinnedToCore(hogTask, "Hog", 1024, NULL, 1, NULL, app_cpu);
+    xTaskCreatePinnedToCore(benchTask, "Bench", 4096, NULL, 2, NULL, app_cpu);
+
+    vTaskDelete(NULL);
+}
+
+void loop(){
+    //Never reached
+}
@@ -0,0 +1,171 @@
+/*
+    Inactivity timer: xTimerReset per character vs a lazy reset
+
+    SeventhTest_SWTimer_Challenge.cpp turns an LED on for every character
+    and calls xTimerReset() so it goes off after some time without input.
+    Here the characters come in bursts (like pasting text in the terminal)
+    and the echo path is measured with:
+        - reset: xTimerReset(timer, portMAX_DELAY), one daemon command per
+                 character, as in the lesson
+        - lazy:  LazyTimer::kick() (Includes/lazyTimer.h), only stores the
+                 new deadline
+
+    For each we print the daemon commands sent, the echo latency per
+    character (LED on + reset, the Serial.print is left out so the UART
+    doesn't hide everything) and how many times the LED went off, which must
+    be the same for both: once per long pause. "result" says LOST when an
+    expiry went missing (or came twice).
+
+    The "loaded" runs add a task that shares the daemon's core and
+    priority, so the daemon doesn't keep up and its queue fills. retries
+    counts the lazy timer's re-arms that didn't fit in the queue then: they
+    must not lose an expiry.
+*/
+
+#include <Arduino.h>
+#include <stdlib.h>
+#include <lazyTimer.h>
+
+// Use only core 1 for demo purposes
+#if CONFIG_FREERTOS_UNICORE
+  static const BaseType_t app_cpu = 0;
+#else
+  static const BaseType_t app_cpu = 1;
+#endif
+
+//Settings
+static const int pin = 25;
+static const TickType_t timeout = 50 / portTICK_PERIOD_MS;    //the lesson uses 5 s
+static const uint32_t bursts = 200;
+static const uint32_t burst_len = 64;                           //characters, back to back
+static const TickType_t burst_gap = 20 / portTICK_PERIOD_MS;    //shorter than timeout
+static const uint32_t pause_every = 50;                         //bursts, then a long pause
+static const uint32_t hog_ms = 5;                               //load: busy 5 ms of every 10
+enum {MAX_SAMPLES = bursts * burst_len};
+
+//Globals
+static TimerHandle_t reset_timer = NULL;
+static LazyTimer lazy_timer;
+static volatile uint32_t led_offs;
+static volatile bool hog_on;
+static uint32_t samples[MAX_SAMPLES];
+
+//************************************************************
+//Functions
+
+//Callback functions
+void myTimerCallback(TimerHandle_t xTimer){
+    digitalWrite(pin, LOW);
+    led_offs++;
+}
+
+void lazyCallback(LazyTimer *timer){
+    digitalWrite(pin, LOW);
+    led_offs++;
+}
+
+static int cmpSamples(const void *a, const void *b){
+    uint32_t x = *(const uint32_t*)a, y = *(const uint32_t*)b;
+    return x < y ? -1 : x > y;
+}
+
+static float toUs(uint32_t cycles){
+    return (float)cycles / getCpuFrequencyMhz();
+}
+
+void runEcho(bool lazy, bool loaded){
+
+    uint32_t n = 0, commands, retries;
+    uint64_t sum = 0;
+    uint32_t start_cmds = lazy_timer.commands();
+    uint32_t start_retries = lazy_timer.retries();
+    uint32_t expected = bursts / pause_every;
+
+    led_offs = 0;
+    hog_on = loaded;
+
+    for(uint32_t b = 0; b < bursts; b++){
+        for(uint32_t i = 0; i < burst_len; i++){
+            //What echoTask does with every character
+            uint32_t t0 = ESP.getCycleCount();
+            digitalWrite(pin, HIGH);
+            if(lazy)
+                lazy_timer.kick();
+            else
+                xTimerReset(reset_timer, portMAX_DELAY);
+            samples[n] = ESP.getCycleCount() - t0;
+            sum += samples[n++];
+        }
+
+        if((b + 1) % pause_every == 0)
+            vTaskDelay(2 * timeout);        //LED must go off
+        else
+            vTaskDelay(burst_gap);
+    }
+
+    hog_on = false;
+    vTaskDelay(2 * timeout);
+
+    commands = lazy ? lazy_timer.commands() - start_cmds : n;
+    retries = lazy ? lazy_timer.retries() - start_retries : 0;
+    qsort(samples, n, sizeof(samples[0]), cmpSamples);
+
+    Serial.printf("%s,%s,%lu,%lu,%lu,%.2f,%.2f,%.2f,%.2f,%lu,%lu,%s\n", lazy ? "lazy" : "reset", loaded ? "yes" : "no",
+                    (unsigned long)n, (unsigned long)commands, (unsigned long)retries, toUs(sum / n),
+                    toUs(samples[n / 2]), toUs(samples[n * 99 / 100]), toUs(samples[n - 1]),
+                    (unsigned long)led_offs, (unsigned long)expected, led_offs == expected ? "ok" : "LOST");
+}
+
+//************************************************************
+//FreeRTOS TASKS
+
+//Shares the daemon's core and priority: they take turns every tick
+void hogTask(void *parameters){
+    while(1){
+        if(hog_on){
+            uint32_t t0 = millis();
+            while(millis() - t0 < hog_ms);
+        }
+        vTaskDelay((2 * hog_ms) / portTICK_PERIOD_MS);
+    }
+}
+
+void benchTask(void *parameters){
+
+    Serial.println("mode,loaded,chars,daemon_cmds,retries,avg_us,p50_us,p99_us,max_us,led_offs,expected_offs,result");
+    for(uint8_t loaded = 0; loaded < 2; loaded++){
+        runEcho(false, loaded);
+        runEcho(true, loaded);
+    }
+
+    Serial.println("done.");
+    vTaskDelete(NULL);
+}
+
+void setup(){
+
+    Serial.begin(115200);
+    pinMode(pin, OUTPUT);
+
+    vTaskDelay(1000 / portTICK_PERIOD_MS);
+    Serial.println();
+    Serial.println("---FreeRTOS Lazy timer reset---");
+
+    //One-shot, so every inactivity period turns the LED off once
+    reset_timer = xTimerCreate("Reset timer", timeout, pdFALSE, (void*)1, myTimerCallback);
+
+    if(reset_timer == NULL || !lazy_timer.begin("Lazy timer", timeout, lazyCallback)){
+        Serial.println("ERROR: COULD NOT CREATE TIMERS");
+        ESP.restart();
+    }
+
+    //The daemon runs on core 0 on the ESP32
+    xTaskCreatePinnedToCore(hogTask, "Hog", 1024, NULL, configTIMER_TASK_PRIORITY, NULL, 0);
+    xTaskCreatePinnedToCore(benchTask, "Echo Task", 4096, NULL, 1, NULL, app_cpu);
+
+    vTaskDelete(NULL);
+}
+
+void loop(){
+    //Never reached
+}
@@ -0,0 +1,185 @@
+/*
+    One slow timer callback vs everybody else
+
+    Like myTimerCallback in SeventhTest_SWTimers.cpp, the "slow" timer here
+    prints from its callback, and keeps the CPU a while on top (~20 ms). The
+    three "fast" timers only check how late they were called, in ticks.
+
+    Two runs:
+        - daemon:   every callback in the timer daemon, as in the lesson.
+                    Each time the slow one runs, the fast ones wait for it.
+        - executor: the same timers through Includes/timerExecutor.h. The
+                    fast ones stay in the daemon (EXEC_FAST), the slow one
+                    goes to a worker task at priority 1.
+
+    For every timer: how many times it fired, and its average and maximum
+    lateness in ticks. For the executor run, also how long each callback
+    waited for a worker and ran, in us.
+*/
+
+#include <Arduino.h>
+#include <stdlib.h>
+#include <timerExecutor.h>
+
+// Use only core 1 for demo purposes
+#if CONFIG_FREERTOS_UNICORE
+  static const BaseType_t app_cpu = 0;
+#else
+  static const BaseType_t app_cpu = 1;
+#endif
+
+//Settings
+static const TickType_t run_time = 5000 / portTICK_PERIOD_MS;
+static const TickType_t slow_period = 100 / portTICK_PERIOD_MS;
+static const TickType_t fast_periods[] = {5 / portTICK_PERIOD_MS, 10 / portTICK_PERIOD_MS, 15 / portTICK_PERIOD_MS};
+static const uint32_t slow_busy_ms = 20;
+enum {FAST = sizeof(fast_periods) / sizeof(fast_periods[0])};
+
+//Each fast timer's ID points to its probe
+struct Probe{
+    TickType_t expected;        //next expiry
+    TickType_t period;
+    uint32_t fired;
+    uint32_t late_max;
+    uint32_t late_sum;
+};
+
+//Globals
+static TimerExecutor exec;
+static Probe probes[FAST];
+static volatile uint32_t slow_runs;
+
+//************************************************************
+//Functions
+
+static void probe(Probe *p){
+    int32_t late = (int32_t)(xTaskGetTickCount() - p->expected);
+    if(late < 0)
+        late = 0;
+    p->fired++;
+    p->late_sum += late;
+    if((uint32_t)late > p->late_max)
+        p->late_max = late;
+    p->expected += p->period;
+}
+
+static void resetProbes(){
+    for(uint8_t i = 0; i < FAST; i++){
+        probes[i].period = fast_periods[i];
+        probes[i].fired = probes[i].late_max = probes[i].late_sum = 0;
+    }
+    slow_runs = 0;
+}
+
+//Callback functions
+void slowCallback(TimerHandle_t xTimer){
+    Serial.println("Slow timer expired, printing from the callback like the lesson does.");
+    uint32_t t0 = millis();
+    while(millis() - t0 < slow_busy_ms);
+    slow_runs++;
+}
+
+void fastCallback(TimerHandle_t xTimer){
+    probe((Probe*)pvTimerGetTimerID(xTimer));
+}
+
+void fastExecCallback(TimerHandle_t xTimer){
+    probe((Probe*)TimerExecutor::getID(xTimer));
+}
+
+//Starts them all, waits, stops them
+static void runTimers(TimerHandle_t slow, TimerHandle_t *fast){
+
+    TickType_t now = xTaskGetTickCount();
+    for(uint8_t i = 0; i < FAST; i++)
+        probes[i].expected = now + probes[i].period;
+
+    //Commands carry the tick they were sent at, so all of them start at "now"
+    xTimerStart(slow, portMAX_DELAY);
+    for(uint8_t i = 0; i < FAST; i++)
+        xTimerStart(fast[i], portMAX_DELAY);
+
+    vTaskDelay(run_time);
+
+    xTimerStop(slow, portMAX_DELAY);
+    for(uint8_t i = 0; i < FAST; i++)
+        xTimerStop(fast[i], portMAX_DELAY);
+    vTaskDelay(2 * slow_busy_ms / portTICK_PERIOD_MS);
+}
+
+static void printProbes(const char *mode){
+    for(uint8_t i = 0; i < FAST; i++){
+        Probe *p = &probes[i];
+        Serial.printf("%s,fast_%lu,%lu,%.2f,%lu\n", mode, (unsigned long)(p->period * portTICK_PERIOD_MS),
+                        (unsigned long)p->fired, p->fired ? (float)p->late_sum / p->fired : 0.0f,
+                        (unsigned long)p->late_max);
+    }
+    Serial.printf("%s,slow,%lu,,\n", mode, (unsigned long)slow_runs);
+}
+
+static void printStats(const char *name, TimerHandle_t timer){
+    ExecStats s = exec.stats(timer);
+    Serial.printf("%s,%lu,%lu,%.1f,%lu,%.1f,%lu\n", name, (unsigned long)s.runs, (unsigned long)s.dropped,
+                    s.runs ? (float)s.wait_sum_us / s.runs : 0.0f, (unsigned long)s.wait_max_us,
+                    s.runs ? (float)s.run_sum_us / s.runs : 0.0f, (unsigned long)s.run_max_us);
+}
+
+//************************************************************
+//FreeRTOS TASKS
+
+void benchTask(void *parameters){
+
+    TimerHandle_t slow, fast[FAST];
+    char name[16];
+
+    Serial.println("mode,timer,fired,late_avg_ticks,late_max_ticks");
+
+    //Everything in the daemon, like the lesson
+    resetProbes();
+    slow = xTimerCreate("Slow", slow_period, pdTRUE, NULL, slowCallback);
+    for(uint8_t i = 0; i < FAST; i++)
+        fast[i] = xTimerCreate("Fast", fast_periods[i], pdTRUE, &probes[i], fastCallback);
+    runTimers(slow, fast);
+    printProbes("daemon");
+
+    //Through the executor
+    resetProbes();
+    slow = exec.create("Slow", slow_period, pdTRUE, NULL, slowCallback, 1);
+    for(uint8_t i = 0; i < FAST; i++)
+        fast[i] = exec.create("Fast", fast_periods[i], pdTRUE, &probes[i], fastExecCallback, TimerExecutor::EXEC_FAST);
+    runTimers(slow, fast);
+    printProbes("executor");
+
+    Serial.println("timer,runs,dropped,wait_avg_us,wait_max_us,run_avg_us,run_max_us");
+    printStats("slow", slow);
+    for(uint8_t i = 0; i < FAST; i++){
+        snprintf(name, sizeof(name), "fast_%lu", (unsigned long)(fast_periods[i] * portTICK_PERIOD_MS));
+        printStats(name, fast[i]);
+    }
+
+    Serial.println("done.");
+    vTaskDelete(NULL);
+}
+
+void setup(){
+
+    Serial.begin(115200);
+
+    vTaskDelay(1000 / portTICK_PERIOD_MS);
+    Serial.println();
+    Serial.println("---FreeRTOS Timer callback executor---");
+
+    //Workers on the app core, the daemon is on core 0
+    if(!exec.begin(2, 4096, app_cpu)){
+        Serial.println("ERROR: COULD NOT CREATE TIMER EXECUTOR");
+        ESP.restart();
+    }
+
+    xTaskCreatePinnedToCore(benchTask, "Bench", 4096, NULL, 2, NULL, app_cpu);
+
+    vTaskDelete(NULL);
+}
+
+void loop(){
+    //Never reached
+}
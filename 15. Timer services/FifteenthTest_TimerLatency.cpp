@@ -0,0 +1,342 @@
+/*
+    Timer lateness under load
+
+    How late do timers fire when the system is busy? Every scenario in the
+    table arms the same timers on four services:
+        - daemon:  FreeRTOS software timers (SeventhTest_SWTimers.cpp)
+        - wheel:   Includes/timerWheel.h
+        - hw_isr:  Includes/hrTimer.h, callback in the timer interrupt
+        - hw_task: Includes/hrTimer.h, callback in its dispatch task
+    Each one gets some periodic timers with different periods and some
+    one-shots that restart themselves with a random delay.
+
+    Meanwhile, load tasks run like the lessons' ones: hog_delay loops at some
+    priority (EleventhTest_Multithreading_Basic.cpp), or spinlock critical
+    sections (EleventhTest_Multicore_criticalSection.cpp), which stop the
+    scheduler AND the interrupts of their core for as long as they last.
+    The priority, core and critical section length are set in the table.
+
+    Every callback records actual - expected expiry in us. The software
+    timers count in ticks, so their expected time is the tick converted to
+    us from a point taken right after a tick: a constant error of a few us.
+    Values are signed: a timer that fires early gives a negative one, and
+    the min column shows it (for the software timers, down to minus that
+    constant error is still on time).
+    Output: one CSV line per scenario and service, with count, min, average,
+    p50/p90/p99 and max. Percentiles come from a fixed size random sample of
+    the callbacks (reservoir sampling), the min and max from all of them.
+*/
+
+#include <Arduino.h>
+#include <stdlib.h>
+#include <barrier.h>
+#include <hrTimer.h>
+#include <timerWheel.h>
+
+// Use only core 1 for demo purposes
+#if CONFIG_FREERTOS_UNICORE
+  static const BaseType_t app_cpu = 0;
+#else
+  static const BaseType_t app_cpu = 1;
+#endif
+
+//Settings
+static const TickType_t run_time = 3000 / portTICK_PERIOD_MS;
+static const TickType_t sw_periods[] = {5, 7, 10, 13, 20, 33};          //ticks
+static const uint32_t hw_periods[] = {400, 600, 900, 1400, 2000, 3200}; //us
+enum {PERIODIC = sizeof(sw_periods) / sizeof(sw_periods[0]), ONESHOT = 3, TIMERS = PERIODIC + ONESHOT};
+static const uint32_t sw_once_min = 1, sw_once_max = 20;                //ticks
+static const uint32_t hw_once_min = 50, hw_once_max = 2000;             //us
+
+//Where the services run. The daemon is on core 0 at configTIMER_TASK_PRIORITY.
+static const UBaseType_t wheel_prio = configTIMER_TASK_PRIORITY;
+static const BaseType_t wheel_core = 0;
+static const UBaseType_t hr_task_prio = configMAX_PRIORITIES - 1;
+static const BaseType_t hr_task_core = app_cpu;
+
+#define LOAD_SPREAD -1          //one load task per core
+
+struct LoadConfig{
+    const char *name;
+    uint8_t tasks;
+    UBaseType_t prio;
+    BaseType_t core;            //0, 1 or LOAD_SPREAD
+    uint32_t busy_us;           //hog_delay style, outside the critical section
+    uint32_t cs_us;             //inside portENTER_CRITICAL, 0 for none
+    TickType_t idle;            //vTaskDelay between rounds, lets the idle task feed the watchdog
+};
+
+static const LoadConfig scenarios[] = {
+    {"idle",            0, 0, 0,           0,     0,    0},
+    {"hog_p1_both",     2, 1, LOAD_SPREAD, 50000, 0,    1},
+    {"hog_p2_core0",    1, 2, 0,           50000, 0,    1},     //above the daemon and the wheel
+    {"hog_p2_core1",    1, 2, 1,           50000, 0,    1},
+    {"cs_100us_core0",  1, 1, 0,           900,   100,  1},
+    {"cs_1ms_core1",    1, 1, 1,           1000,  1000, 1},
+    {"cs_5ms_both",     2, 1, LOAD_SPREAD, 5000,  5000, 1},
+};
+
+enum {DAEMON, WHEEL, HW_ISR, HW_TASK, SOURCES};
+static const char *source_names[SOURCES] = {"daemon", "wheel", "hw_isr", "hw_task"};
+enum {MAX_SAMPLES = 2048};
+
+struct Samples{
+    uint32_t seen;
+    uint32_t kept;
+    int32_t min, max;
+    int64_t sum;
+    uint32_t seed;
+    int32_t buf[MAX_SAMPLES];
+};
+
+//Globals
+static TimerWheel wheel;
+static HrTimerService hr;
+static TimerHandle_t daemon_timers[TIMERS];
+static WheelTimer wheel_timers[TIMERS];
+static HrTimer hw_timers[2][TIMERS];
+static TickType_t expected_tick[2][TIMERS];     //daemon, wheel
+static Samples samples[SOURCES];                //one writer each: daemon, wheel task, ISR, hr task
+static volatile bool running, load_on;
+static CountdownLatch load_done;
+static portMUX_TYPE spinlock = portMUX_INITIALIZER_UNLOCKED;
+
+//Tick to us conversion, taken right after a tick
+static TickType_t anchor_tick;
+static uint32_t anchor_us;
+
+//************************************************************
+//Functions
+
+static uint32_t IRAM_ATTR lcg(uint32_t *seed){
+    *seed = *seed * 1664525 + 1013904223;
+    return *seed >> 8;
+}
+
+static uint32_t IRAM_ATTR randomIn(uint32_t *seed, uint32_t lo, uint32_t hi){
+    return lo + lcg(seed) % (hi - lo);
+}
+
+//Early is negative, not clamped to 0
+static void IRAM_ATTR record(uint8_t src, int32_t v){
+    Samples *s = &samples[src];
+
+    if(s->seen == 0 || v < s->min)
+        s->min = v;
+    if(s->seen == 0 || v > s->max)
+        s->max = v;
+    s->seen++;
+    s->sum += v;
+
+    //Reservoir: every callback has the same chance to be in the sample
+    if(s->kept < MAX_SAMPLES)
+        s->buf[s->kept++] = v;
+    else{
+        uint32_t j = lcg(&s->seed) % s->seen;
+        if(j < MAX_SAMPLES)
+            s->buf[j] = v;
+    }
+}
+
+static int32_t lateFromTick(TickType_t expected){
+    uint32_t expected_us = anchor_us + (int32_t)(expected - anchor_tick) * (1000000 / configTICK_RATE_HZ);
+    return (int32_t)(micros() - expected_us);
+}
+
+static void busyUs(uint32_t us){
+    uint32_t cycles = us * getCpuFrequencyMhz();
+    uint32_t t0 = ESP.getCycleCount();
+    while(ESP.getCycleCount() - t0 < cycles);
+}
+
+//Callback functions
+
+//Index in the ID. Periodic ones first, then the one-shots.
+void daemonCallback(TimerHandle_t xTimer){
+    static uint32_t seed = 1;
+    uint32_t i = (uint32_t)(uintptr_t)pvTimerGetTimerID(xTimer);
+
+    record(DAEMON, lateFromTick(expected_tick[0][i]));
+    if(i < PERIODIC)
+        expected_tick[0][i] += sw_periods[i];
+    else if(running){
+        TickType_t d = randomIn(&seed, sw_once_min, sw_once_max);
+        expected_tick[0][i] = xTaskGetTickCount() + d;
+        xTimerChangePeriod(xTimer, d, 0);
+    }
+}
+
+void wheelCallback(TimerHandle_t timer){
+    static uint32_t seed = 2;
+    uint32_t i = (uint32_t)(uintptr_t)wheel.getID(timer);
+
+    record(WHEEL, lateFromTick(expected_tick[1][i]));
+    if(i < PERIODIC)
+        expected_tick[1][i] += sw_periods[i];
+    else if(running){
+        wheel.changePeriod(timer, randomIn(&seed, sw_once_min, sw_once_max));
+        expected_tick[1][i] = wheel.getExpiryTime(timer);
+    }
+}
+
+void IRAM_ATTR hwCallback(HrTimer *timer){
+    static uint32_t seed[2] = {3, 4};
+    uint8_t src = timer->dispatch == HR_IN_ISR ? HW_ISR : HW_TASK;
+
+    record(src, (int32_t)(hr.now() - timer->due));
+    if(timer->period == 0 && running)
+        hr.startOnce(timer, randomIn(&seed[src - HW_ISR], hw_once_min, hw_once_max));
+}
+
+static void startTimers(){
+
+    uint32_t seed = 5;
+
+    //Right after a tick
+    vTaskDelay(1);
+    anchor_tick = xTaskGetTickCount();
+    anchor_us = micros();
+
+    running = true;
+    for(uint8_t i = 0; i < TIMERS; i++){
+        TickType_t period = i < PERIODIC ? sw_periods[i] : randomIn(&seed, sw_once_min, sw_once_max);
+
+        expected_tick[0][i] = anchor_tick + period;
+        xTimerChangePeriod(daemon_timers[i], period, portMAX_DELAY);
+
+        wheel.changePeriod(&wheel_timers[i], period);
+        expected_tick[1][i] = wheel.getExpiryTime(&wheel_timers[i]);
+
+        for(uint8_t k = 0; k < 2; k++){
+            if(i < PERIODIC)
+                hr.startPeriodic(&hw_timers[k][i], hw_periods[i]);
+            else
+                hr.startOnce(&hw_timers[k][i], randomIn(&seed, hw_once_min, hw_once_max));
+        }
+    }
+}
+
+static void stopTimers(){
+    running = false;
+    for(uint8_t i = 0; i < TIMERS; i++){
+        xTimerStop(daemon_timers[i], portMAX_DELAY);
+        wheel.stop(&wheel_timers[i]);
+        hr.stop(&hw_timers[0][i]);
+        hr.stop(&hw_timers[1][i]);
+    }
+    //Let the callbacks that were already running finish
+    vTaskDelay(10 / portTICK_PERIOD_MS);
+}
+
+static int cmpSamples(const void *a, const void *b){
+    int32_t x = *(const int32_t*)a, y = *(const int32_t*)b;
+    return x < y ? -1 : x > y;
+}
+
+static void printResults(const LoadConfig &cfg){
+    for(uint8_t src = 0; src < SOURCES; src++){
+        Samples *s = &samples[src];
+        uint32_t n = s->kept;
+        if(n == 0){
+            Serial.printf("%s,%s,0,,,,,,\n", cfg.name, source_names[src]);
+            continue;
+        }
+        qsort(s->buf, n, sizeof(s->buf[0]), cmpSamples);
+        Serial.printf("%s,%s,%lu,%ld,%.1f,%ld,%ld,%ld,%ld\n", cfg.name, source_names[src], (unsigned long)s->seen,
+                        (long)s->min, (float)s->sum / s->seen, (long)s->buf[n / 2], (long)s->buf[n * 90 / 100],
+                        (long)s->buf[n * 99 / 100], (long)s->max);
+    }
+}
+
+//************************************************************
+//FreeRTOS TASKS
+
+void loadTask(void *parameters){
+
+    const LoadConfig *cfg = (const LoadConfig*)parameters;
+
+    while(load_on){
+        if(cfg->cs_us){
+            portENTER_CRITICAL(&spinlock);
+            busyUs(cfg->cs_us);
+            portEXIT_CRITICAL(&spinlock);
+        }
+        busyUs(cfg->busy_us);
+        vTaskDelay(cfg->idle);
+    }
+
+    load_done.countDown();
+    vTaskDelete(NULL);
+}
+
+void benchTask(void *parameters){
+
+    Serial.println("scenario,service,callbacks,min_us,avg_us,p50_us,p90_us,p99_us,max_us");
+
+    for(uint8_t s = 0; s < sizeof(scenarios) / sizeof(scenarios[0]); s++){
+        const LoadConfig &cfg = scenarios[s];
+
+        memset(samples, 0, sizeof(samples));
+        for(uint8_t src = 0; src < SOURCES; src++)
+            samples[src].seed = src + 1;
+
+        load_on = true;
+        load_done.reset(cfg.tasks);
+        for(uint8_t t = 0; t < cfg.tasks; t++){
+            BaseType_t core = cfg.core == LOAD_SPREAD ? t % 2 : cfg.core;
+            if(xTaskCreatePinnedToCore(loadTask, "Load", 2048, (void*)&cfg, cfg.prio, NULL, core) != pdPASS){
+                Serial.println("ERROR: COULD NOT CREATE LOAD TASK");
+                load_done.countDown();
+            }
+        }
+
+        startTimers();
+        vTaskDelay(run_time);
+        stopTimers();
+
+        load_on = false;
+        load_done.wait(portMAX_DELAY);
+
+        printResults(cfg);
+    }
+
+    Serial.println("done.");
+    vTaskDelete(NULL);
+}
+
+void setup(){
+
+    Serial.begin(115200);
+
+    vTaskDelay(1000 / portTICK_PERIOD_MS);
+    Serial.println();
+    Serial.println("---FreeRTOS Timer lateness under load---");
+
+    bool ok = load_done.begin(0) && wheel.begin(wheel_prio, 4096, wheel_core) &&
+              hr.begin(0, hr_task_prio, hr_task_core);
+
+    for(uint8_t i = 0; i < TIMERS && ok; i++){
+        UBaseType_t reload = i < PERIODIC ? pdTRUE : pdFALSE;
+        TickType_t period = i < PERIODIC ? sw_periods[i] : sw_once_min;
+
+        daemon_timers[i] = xTimerCreate("Daemon", period, reload, (void*)(uintptr_t)i, daemonCallback);
+        ok = daemon_timers[i] != NULL;
+        wheel.init(&wheel_timers[i], "Wheel", period, reload, (void*)(uintptr_t)i, wheelCallback);
+        hr.init(&hw_timers[0][i], hwCallback, NULL, HR_IN_ISR);
+        hr.init(&hw_timers[1][i], hwCallback, NULL, HR_IN_TASK);
+    }
+
+    if(!ok){
+        Serial.println("ERROR: COULD NOT CREATE TIMERS");
+        ESP.restart();
+    }
+
+    //Above every load task, it only wakes up to start and stop things
+    xTaskCreatePinnedToCore(benchTask, "Bench", 4096, NULL, configMAX_PRIORITIES - 2, NULL, app_cpu);
+
+    vTaskDelete(NULL);
+}
+
+void loop(){
+    //Never reached
+}
@@ -0,0 +1,347 @@
+/*
+    Timing wheel vs the FreeRTOS timer daemon
+
+    SeventhTest_SWTimers.cpp uses xTimerCreate/xTimerStart. The daemon keeps
+    the active timers in a sorted list, so every start/reset costs O(n), and
+    every command goes through the daemon's queue (10 commands long on the
+    ESP32, so the caller blocks when it's full).
+
+    Includes/timerWheel.h files the timers in a timing wheel: O(1) start,
+    stop and reset, done directly under a spinlock.
+
+    Part 1, operation cost: with N timers already running, how many cycles a
+    start, a reset and a stop take. For the daemon it's measured until the
+    daemon really did the work (a pended function call at the end tells us).
+    A WheelTimer is 28 bytes, allocated CHUNK at a time (no heap region has
+    room for them all in one piece) until the heap runs out: N = 100000 is
+    ~2.8 MB and won't fit, so the first N that doesn't fit is run with all
+    the timers that did (the "timers" column says how many) and the bigger
+    ones are left out. A start/stop only touches the timer and one slot
+    head, and internal RAM has no cache, so the cost should stay flat.
+
+    Part 2, lateness: N auto-reload timers with random periods (10 to 2000
+    ticks, so most of them go through level 1 and cascade) run for a while,
+    and every callback writes down how many ticks late it ran: negative is
+    early, which must never happen. The wheel task also counts its busy
+    cycles, and the timers re-filed by cascades and what that cost.
+    When N doesn't fit, the row runs real_timers timers from the same
+    distribution, and only est_busy_pct is extrapolated to N: expiries and
+    cascades per tick both grow in proportion to the timers. The lateness
+    columns are what real_timers timers measured, NOT what N timers would
+    see (a callback waiting behind N / real_timers times more work).
+*/
+
+#include <Arduino.h>
+#include <stdlib.h>
+#include <timerWheel.h>
+
+// Use only core 1 for demo purposes
+#if CONFIG_FREERTOS_UNICORE
+  static const BaseType_t app_cpu = 0;
+#else
+  static const BaseType_t app_cpu = 1;
+#endif
+
+//Settings
+static const uint32_t op_counts[] = {100, 1000, 5000, 10000, 20000, 50000, 100000};
+static const uint32_t daemon_max = 1000;        //FreeRTOS timers live in internal RAM
+static const uint32_t late_counts[] = {100, 1000, 10000, 100000};
+static const TickType_t late_run = 10000 / portTICK_PERIOD_MS;
+static const uint32_t heap_reserve = 16384;     //left for everything else
+enum {BUCKETS = 8};                             //lateness: 0, 1, 2-3, 4-7... ticks
+enum {CHUNK = 1024, MAX_CHUNKS = 100};          //timers per malloc
+
+//Globals
+static TimerWheel wheel;
+static WheelTimer *chunks[MAX_CHUNKS];
+static uint32_t chunk_count;
+static SemaphoreHandle_t daemon_done;
+static uint32_t late_hist[BUCKETS];
+static int32_t late_min, late_max;
+static uint32_t fired, early;
+
+//************************************************************
+//Functions
+
+static uint8_t bucket(uint32_t ticks){
+    uint8_t b = ticks ? 32 - __builtin_clz(ticks) : 0;
+    return b < BUCKETS ? b : BUCKETS - 1;
+}
+
+//Each timer's ID holds the tick when it should expire next. Early ones
+//are counted apart, the histogram is for the late ones.
+static void recordLateness(uint32_t expected){
+    int32_t late = (int32_t)(xTaskGetTickCount() - expected);
+    if(late < 0)
+        early++;
+    else
+        late_hist[bucket(late)]++;
+    if(fired == 0 || late < late_min)
+        late_min = late;
+    if(fired == 0 || late > late_max)
+        late_max = late;
+    fired++;
+}
+
+//Same signature as myTimerCallback
+void wheelCallback(TimerHandle_t timer){
+    uint32_t expected = (uint32_t)(uintptr_t)wheel.getID(timer);
+    recordLateness(expected);
+    wheel.setID(timer, (void*)(uintptr_t)(expected + wheel.getPeriod(timer)));
+}
+
+void daemonCallback(TimerHandle_t timer){
+    uint32_t expected = (uint32_t)(uintptr_t)pvTimerGetTimerID(timer);
+    recordLateness(expected);
+    vTimerSetTimerID(timer, (void*)(uintptr_t)(expected + xTimerGetPeriod(timer)));
+}
+
+void nop(TimerHandle_t timer){
+}
+
+//Runs in the daemon after every command sent before it
+void daemonMark(void *param1, uint32_t param2){
+    xSemaphoreGive(daemon_done);
+}
+
+static void waitDaemon(){
+    xTimerPendFunctionCall(daemonMark, NULL, 0, portMAX_DELAY);
+    xSemaphoreTake(daemon_done, portMAX_DELAY);
+}
+
+static void freeTimers(){
+    while(chunk_count > 0)
+        free(chunks[--chunk_count]);
+}
+
+//Up to n timers, as many as the heap has room for. Returns how many.
+static uint32_t allocTimers(uint32_t n){
+    for(chunk_count = 0; chunk_count * CHUNK < n && chunk_count < MAX_CHUNKS; chunk_count++){
+        if(ESP.getFreeHeap() < CHUNK * sizeof(WheelTimer) + heap_reserve)
+            break;
+        chunks[chunk_count] = (WheelTimer*)malloc(CHUNK * sizeof(WheelTimer));
+        if(chunks[chunk_count] == NULL)
+            break;
+    }
+    return chunk_count * CHUNK < n ? chunk_count * CHUNK : n;
+}
+
+static WheelTimer *timerAt(uint32_t i){
+    return &chunks[i / CHUNK][i % CHUNK];
+}
+
+static void printOps(const char *service, uint32_t n, uint32_t start_c, uint32_t reset_c, uint32_t stop_c){
+    Serial.printf("%s,%lu,%lu,%lu,%lu\n", service, (unsigned long)n,
+                    (unsigned long)(start_c / n), (unsigned long)(reset_c / n), (unsigned long)(stop_c / n));
+}
+
+//False when n didn't fit: the row ran with what did, bigger n would too
+bool opsWheel(uint32_t n){
+
+    uint32_t t0, start_c, reset_c, stop_c;
+    uint32_t wanted = n;
+
+    n = allocTimers(n);
+    if(n == 0){
+        freeTimers();
+        Serial.printf("wheel,%lu,skipped (no memory)\n", (unsigned long)wanted);
+        return false;
+    }
+
+    for(uint32_t i = 0; i < n; i++)
+        wheel.init(timerAt(i), "t", random(1000, 60000), pdTRUE, NULL, nop);
+
+    t0 = ESP.getCycleCount();
+    for(uint32_t i = 0; i < n; i++)
+        wheel.start(timerAt(i));
+    start_c = ESP.getCycleCount() - t0;
+
+    t0 = ESP.getCycleCount();
+    for(uint32_t i = 0; i < n; i++)
+        wheel.reset(timerAt(random(n)));
+    reset_c = ESP.getCycleCount() - t0;
+
+    t0 = ESP.getCycleCount();
+    for(uint32_t i = 0; i < n; i++)
+        wheel.stop(timerAt(i));
+    stop_c = ESP.getCycleCount() - t0;
+
+    printOps("wheel", n, start_c, reset_c, stop_c);
+    freeTimers();
+    return n == wanted;
+}
+
+void opsDaemon(uint32_t n){
+
+    TimerHandle_t *timers = (TimerHandle_t*)malloc(n * sizeof(TimerHandle_t));
+    uint32_t t0, start_c, reset_c, stop_c, created = 0;
+
+    if(timers != NULL)
+        for(; created < n; created++)
+            if((timers[created] = xTimerCreate("t", random(1000, 60000), pdTRUE, NULL, nop)) == NULL)
+                break;
+
+    if(created == n){
+        t0 = ESP.getCycleCount();
+        for(uint32_t i = 0; i < n; i++)
+            xTimerStart(timers[i], portMAX_DELAY);
+        waitDaemon();
+        start_c = ESP.getCycleCount() - t0;
+
+        t0 = ESP.getCycleCount();
+        for(uint32_t i = 0; i < n; i++)
+            xTimerReset(timers[random(n)], portMAX_DELAY);
+        waitDaemon();
+        reset_c = ESP.getCycleCount() - t0;
+
+        t0 = ESP.getCycleCount();
+        for(uint32_t i = 0; i < n; i++)
+            xTimerStop(timers[i], portMAX_DELAY);
+        waitDaemon();
+        stop_c = ESP.getCycleCount() - t0;
+
+        printOps("daemon", n, start_c, reset_c, stop_c);
+    }
+    else
+        Serial.printf("daemon,%lu,skipped (no memory)\n", (unsigned long)n);
+
+    for(uint32_t i = 0; i < created; i++)
+        xTimerDelete(timers[i], portMAX_DELAY);
+    waitDaemon();
+    free(timers);
+}
+
+static void resetLateness(){
+    memset(late_hist, 0, sizeof(late_hist));
+    late_min = late_max = 0;
+    fired = early = 0;
+}
+
+static void printLateness(const char *service, uint32_t n, uint32_t real){
+    Serial.printf("%s,%lu,%lu,%lu,%lu,%ld,%ld", service, (unsigned long)n, (unsigned long)real,
+                    (unsigned long)fired, (unsigned long)early, (long)late_min, (long)late_max);
+}
+
+static void printHist(){
+    for(uint8_t b = 0; b < BUCKETS; b++)
+        Serial.printf(",%lu", (unsigned long)late_hist[b]);
+    Serial.println();
+}
+
+//n timers, or as many as fit, with the busy time extrapolated to n
+void latenessWheel(uint32_t n){
+
+    uint32_t real = allocTimers(n);
+    if(real == 0){
+        freeTimers();
+        Serial.printf("wheel,%lu,skipped (no memory)\n", (unsigned long)n);
+        return;
+    }
+
+    resetLateness();
+    uint32_t wakes = wheel.wakeups(), busy = wheel.busyCycles();
+    uint32_t moved = wheel.cascaded(), cascade_c = wheel.cascadeCycles();
+    for(uint32_t i = 0; i < real; i++){
+        WheelTimer *t = timerAt(i);
+        wheel.init(t, "t", random(10, 2000), pdTRUE, NULL, wheelCallback);
+        wheel.start(t);
+        wheel.setID(t, (void*)(uintptr_t)wheel.getExpiryTime(t));
+    }
+    vTaskDelay(late_run);
+    for(uint32_t i = 0; i < real; i++)
+        wheel.stop(timerAt(i));
+
+    wakes = wheel.wakeups() - wakes;
+    busy = wheel.busyCycles() - busy;
+    moved = wheel.cascaded() - moved;
+    cascade_c = wheel.cascadeCycles() - cascade_c;
+    float busy_pct = 100.0f * busy / ((float)late_run * portTICK_PERIOD_MS * 1000 * getCpuFrequencyMhz());
+
+    printLateness("wheel", n, real);
+    Serial.printf(",%lu,%lu,%lu,%.2f,%.2f", (unsigned long)wakes, (unsigned long)moved,
+                    (unsigned long)(moved ? cascade_c / moved : 0), busy_pct, busy_pct * n / real);
+    printHist();
+    freeTimers();
+}
+
+void latenessDaemon(uint32_t n){
+
+    TimerHandle_t *timers = (TimerHandle_t*)malloc(n * sizeof(TimerHandle_t));
+    uint32_t created = 0;
+    if(timers == NULL)
+        return;
+
+    resetLateness();
+    for(; created < n; created++){
+        TickType_t period = random(10, 2000);
+        timers[created] = xTimerCreate("t", period, pdTRUE, NULL, daemonCallback);
+        if(timers[created] == NULL)
+            break;
+        //The ID is set right before the start command is sent
+        vTimerSetTimerID(timers[created], (void*)(uintptr_t)(xTaskGetTickCount() + period));
+        xTimerStart(timers[created], portMAX_DELAY);
+    }
+    vTaskDelay(late_run);
+    for(uint32_t i = 0; i < created; i++)
+        xTimerDelete(timers[i], portMAX_DELAY);
+    waitDaemon();
+
+    //The daemon doesn't tell how often it woke up, or how busy it was
+    printLateness("daemon", created, created);
+    Serial.print(",-,-,-,-,-");
+    printHist();
+    free(timers);
+}
+
+//************************************************************
+//FreeRTOS TASKS
+
+void benchTask(void *parameters){
+
+    Serial.println("service,timers,start_cycles,reset_cycles,stop_cycles");
+    for(uint8_t i = 0; i < sizeof(op_counts) / sizeof(op_counts[0]); i++){
+        if(op_counts[i] <= daemon_max)
+            opsDaemon(op_counts[i]);
+        if(!opsWheel(op_counts[i]))
+            break;
+    }
+
+    Serial.print("service,timers,real_timers,fired,early,late_min_ticks,late_max_ticks,"
+                 "wakeups,cascaded,cycles_per_cascaded,busy_pct,est_busy_pct");
+    for(uint8_t b = 0; b < BUCKETS; b++)
+        Serial.printf(",late_lt_%u", 1 << b);
+    Serial.println();
+    for(uint8_t i = 0; i < sizeof(late_counts) / sizeof(late_counts[0]); i++){
+        latenessWheel(late_counts[i]);
+        if(late_counts[i] <= daemon_max)
+            latenessDaemon(late_counts[i]);
+    }
+
+    Serial.println("done.");
+    vTaskDelete(NULL);
+}
+
+void setup(){
+
+    Serial.begin(115200);
+
+    vTaskDelay(1000 / portTICK_PERIOD_MS);
+    Serial.println();
+    Serial.println("---FreeRTOS Timing wheel---");
+
+    daemon_done = xSemaphoreCreateBinary();
+
+    //Same priority as the timer daemon, for a fair comparison
+    if(daemon_done == NULL || !wheel.begin(configTIMER_TASK_PRIORITY, 4096, 0)){
+        Serial.println("ERROR: COULD NOT CREATE TIMER SERVICE");
+        ESP.restart();
+    }
+
+    xTaskCreatePinnedToCore(benchTask, "Bench", 4096, NULL, 1, NULL, app_cpu);
+
+    vTaskDelete(NULL);
+}
+
+void loop(){
+    //Never reached
+}
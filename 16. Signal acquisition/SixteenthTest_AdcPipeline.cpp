@@ -0,0 +1,185 @@
+/*
+    Block acquisition at 100 kHz and beyond
+
+    EigthTest_HWInterrupts_Challenge.cpp samples at 10 Hz: one interrupt and
+    one analogRead() per sample, a task woken every 10 samples. Here the
+    samples come in blocks through Includes/adcPipeline.h: the source fills
+    one buffer while this task processes the other, and there's one
+    interrupt and one wake-up per block.
+
+    For every scenario (source, sample rate, block length, and some fake
+    work per sample to load the processing task) we print:
+        - blocks processed and blocks dropped (processing too slow)
+        - missing: with the synthetic source, the blocks whose numbers
+          never showed up. Must be the same as dropped, "result" says BAD
+          when it isn't.
+        - the sample rate really achieved, and the processing time per block
+          (avg, max, and % of the block period)
+
+    The i2s_adc runs read A0 (GPIO36), like the lesson. Leave it floating or
+    connect a signal generator, the mean is printed too.
+*/
+
+#include <Arduino.h>
+#include <stdlib.h>
+#include <adcPipeline.h>
+
+// Use only core 1 for demo purposes
+#if CONFIG_FREERTOS_UNICORE
+  static const BaseType_t app_cpu = 0;
+#else
+  static const BaseType_t app_cpu = 1;
+#endif
+
+//Settings
+static const TickType_t run_time = 3000 / portTICK_PERIOD_MS;
+
+struct Scenario{
+    bool i2s;                   //false: synthetic source
+    uint32_t rate_hz;
+    uint16_t block_len;
+    uint32_t work_cycles;       //per sample, on top of the min/max/mean
+};
+
+static const Scenario scenarios[] = {
+    {false, 100000,  256, 0},
+    {false, 250000,  256, 0},
+    {false, 1000000, 256, 0},
+    {false, 1000000, 64,  0},
+    {false, 100000,  256, 1500},    //~60% of a core at 240 MHz
+    {false, 1000000, 256, 300},     //more than a core: drops
+    {true,  100000,  256, 0},
+    {true,  200000,  512, 0},
+};
+
+//Globals
+static AdcPipeline pipe;
+
+//************************************************************
+//Functions
+
+//The synthetic source writes the block number in the first samples
+static uint32_t blockNum(const uint16_t *block){
+    return block[0] | ((uint32_t)block[1] << 16);
+}
+
+static void burn(uint32_t cycles){
+    uint32_t t0 = ESP.getCycleCount();
+    while(ESP.getCycleCount() - t0 < cycles);
+}
+
+void runScenario(const Scenario &sc){
+
+    BlockSource *source;
+    uint32_t missing = 0, expected = 0, proc_max = 0, t_start, elapsed;
+    uint64_t proc_sum = 0, sample_sum = 0, processed = 0;
+    uint16_t from = sc.i2s ? 0 : SYNTH_HEADER;     //first sample of signal
+
+#if CONFIG_IDF_TARGET_ESP32
+    source = sc.i2s ? &i2sAdcSource() : &syntheticSource();
+#else
+    if(sc.i2s)
+        return;
+    source = &syntheticSource();
+#endif
+
+    if(!pipe.begin(sc.block_len) || !source->start(pipe, sc.rate_hz)){
+        Serial.printf("ERROR: could not start %s at %lu Hz\n", source->name(), (unsigned long)sc.rate_hz);
+        return;
+    }
+
+    t_start = micros();
+    TickType_t end = xTaskGetTickCount() + run_time;
+    while((int32_t)(end - xTaskGetTickCount()) > 0){
+
+        const uint16_t *block = pipe.take(10 / portTICK_PERIOD_MS);
+        if(block == NULL)
+            continue;
+
+        uint32_t t0 = ESP.getCycleCount();
+        uint16_t lo = 0xFFFF, hi = 0;
+        uint32_t sum = 0;
+
+        //Numbers start at 0, every one skipped is a block we never got
+        if(!sc.i2s){
+            missing += blockNum(block) - expected;
+            expected = blockNum(block) + 1;
+        }
+
+        for(uint16_t i = from; i < sc.block_len; i++){
+            uint16_t v = block[i];
+            sum += v;
+            if(v < lo)
+                lo = v;
+            if(v > hi)
+                hi = v;
+        }
+        if(sc.work_cycles)
+            burn(sc.work_cycles * sc.block_len);
+
+        pipe.release();
+
+        uint32_t proc = ESP.getCycleCount() - t0;
+        proc_sum += proc;
+        if(proc > proc_max)
+            proc_max = proc;
+        sample_sum += sum;
+        processed++;
+    }
+
+    source->stop();
+    elapsed = micros() - t_start;
+
+    //A block that came in after the last take: not processed, but not lost
+    const uint16_t *last = pipe.take(0);
+    if(last != NULL){
+        if(!sc.i2s)
+            missing += blockNum(last) - expected;
+        pipe.release();
+    }
+
+    //The block period in cycles: how much of it the processing takes
+    float period_cycles = (float)sc.block_len * getCpuFrequencyMhz() * 1e6f / sc.rate_hz;
+    float proc_avg = processed ? (float)proc_sum / processed : 0;
+
+    Serial.printf("%s,%lu,%u,%lu,%lu,%lu,%lu,%s,%.0f,%.1f,%.1f,%.1f,%.1f\n", source->name(),
+                    (unsigned long)sc.rate_hz, sc.block_len, (unsigned long)sc.work_cycles,
+                    (unsigned long)processed, (unsigned long)pipe.dropped(), (unsigned long)missing,
+                    sc.i2s ? "-" : missing == pipe.dropped() ? "ok" : "BAD",
+                    (float)(processed + pipe.dropped()) * sc.block_len * 1e6f / elapsed,
+                    proc_avg / getCpuFrequencyMhz(), (float)proc_max / getCpuFrequencyMhz(),
+                    100.0f * proc_avg / period_cycles,
+                    processed ? (float)sample_sum / (processed * (sc.block_len - from)) : 0.0f);
+}
+
+//************************************************************
+//FreeRTOS TASKS
+
+//The processing task: it takes the blocks
+void benchTask(void *parameters){
+
+    Serial.println("source,rate_hz,block,work_cycles,blocks,dropped,missing,result,achieved_hz,proc_avg_us,proc_max_us,proc_pct,mean");
+
+    for(uint8_t s = 0; s < sizeof(scenarios) / sizeof(scenarios[0]); s++)
+        runScenario(scenarios[s]);
+
+    Serial.println("done.");
+    vTaskDelete(NULL);
+}
+
+void setup(){
+
+    Serial.begin(115200);
+
+    vTaskDelay(1000 / portTICK_PERIOD_MS);
+    Serial.println();
+    Serial.println("---FreeRTOS Block acquisition pipeline---");
+
+    xTaskCreatePinnedToCore(benchTask, "Process", 4096, NULL, configMAX_PRIORITIES - 2, NULL, app_cpu);
+
+    vTaskDelete(NULL);
+}
+
+void loop(){
+    //Never reached
+}
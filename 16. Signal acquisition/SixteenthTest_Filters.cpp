@@ -0,0 +1,242 @@
+/*
+    Fixed-point filter stages: correctness and MAC/s
+
+    Part 1: every stage of Includes/filterStage.h filters a fake ADC signal
+    (slow sine + fast sine + noise, 12 bits) cut into blocks of random
+    lengths, and the output is compared with the same filter in double
+    precision, with the same (quantized) coefficients, over the whole
+    signal at once. Error in LSBs:
+        - fir, cic: only the final rounding, max 0.5
+        - biquad: the sections feed each other int16 samples, so a bit more,
+          tolerated up to biquad_max_rms rms
+
+    Part 2: each stage runs over the signal in blocks of 64 and 256 samples
+    and we print input samples per second and multiply-accumulates per
+    second (for the CIC, adds: it has no multiplies). lesson_mean10 is the
+    challenges' mean of 10, as a reference.
+*/
+
+#include <Arduino.h>
+#include <stdlib.h>
+#include <filterStage.h>
+
+// Use only core 1 for demo purposes
+#if CONFIG_FREERTOS_UNICORE
+  static const BaseType_t app_cpu = 0;
+#else
+  static const BaseType_t app_cpu = 1;
+#endif
+
+//Settings
+enum {SIG_LEN = 4096, FIR_TAPS = 31, CIC_STAGES = 3, CIC_RATIO = 16, BQ_SECTIONS = 2};
+static const float fir_cutoff = 0.1f;           //of the sample rate
+static const float bq_cutoff = 0.01f;
+static const float bq_q[BQ_SECTIONS] = {0.5412f, 1.3066f};      //4th order Butterworth
+static const float biquad_max_rms = 4.0f;
+static const uint16_t bench_blocks[] = {64, 256};
+static const uint8_t bench_repeats = 20;
+
+//Globals
+static int16_t signal_in[SIG_LEN];
+static int16_t signal_out[SIG_LEN];
+static int16_t fir_coeffs[FIR_TAPS];
+static BiquadCoeffs bq_coeffs[BQ_SECTIONS];
+
+static FirFilter fir;
+static CicDecimator<CIC_STAGES> cic;
+static BiquadCascade biquad;
+
+//************************************************************
+//Functions
+
+//The stage over the whole signal, in blocks of 1 to 150 samples
+static uint32_t runRandomBlocks(FilterStage &stage){
+
+    uint32_t in = 0, out = 0;
+
+    stage.reset();
+    while(in < SIG_LEN){
+        uint32_t n = random(1, 151);
+        if(n > SIG_LEN - in)
+            n = SIG_LEN - in;
+        out += stage.process(signal_in + in, signal_out + out, n);
+        in += n;
+    }
+    return out;
+}
+
+static void printCheck(const char *test, uint32_t outputs, uint32_t expected, double max_err, double sq_err, double limit_rms){
+
+    double rms = expected ? sqrt(sq_err / expected) : 0;
+    bool ok = outputs == expected && (limit_rms > 0 ? rms <= limit_rms : max_err <= 0.5 + 1e-9);
+
+    Serial.printf("%s,%lu,%lu,%.3f,%.3f,%s\n", test, (unsigned long)outputs, (unsigned long)expected,
+                    max_err, rms, ok ? "ok" : "FAIL");
+}
+
+static void checkFir(uint16_t decim){
+
+    char name[16];
+    double max_err = 0, sq_err = 0;
+    uint32_t j = 0;
+
+    fir.begin(fir_coeffs, FIR_TAPS, 64, decim);
+    uint32_t outputs = runRandomBlocks(fir);
+
+    for(uint32_t n = 0; n < SIG_LEN; n += decim, j++){
+        double ref = 0;
+        for(uint16_t k = 0; k < FIR_TAPS && k <= n; k++)
+            ref += fir_coeffs[k] / 32768.0 * signal_in[n - k];
+        double e = fabs(ref - signal_out[j]);
+        max_err = e > max_err ? e : max_err;
+        sq_err += e * e;
+    }
+
+    snprintf(name, sizeof(name), "fir_decim%u", decim);
+    printCheck(name, outputs, j, max_err, sq_err, 0);
+}
+
+static void checkCic(){
+
+    int64_t integ[CIC_STAGES] = {0}, comb[CIC_STAGES] = {0};
+    double gain = pow((double)CIC_RATIO, (double)CIC_STAGES), max_err = 0, sq_err = 0;
+    uint32_t j = 0;
+
+    cic.begin(CIC_RATIO);
+    uint32_t outputs = runRandomBlocks(cic);
+
+    //No wrap-around here: 64 bits
+    for(uint32_t n = 0; n < SIG_LEN; n++){
+        integ[0] += signal_in[n];
+        for(uint8_t s = 1; s < CIC_STAGES; s++)
+            integ[s] += integ[s - 1];
+        if((n + 1) % CIC_RATIO)
+            continue;
+        int64_t v = integ[CIC_STAGES - 1];
+        for(uint8_t s = 0; s < CIC_STAGES; s++){
+            int64_t prev = comb[s];
+            comb[s] = v;
+            v -= prev;
+        }
+        double e = fabs(v / gain - signal_out[j++]);
+        max_err = e > max_err ? e : max_err;
+        sq_err += e * e;
+    }
+
+    printCheck("cic", outputs, j, max_err, sq_err, 0);
+}
+
+static void checkBiquad(){
+
+    double x1[BQ_SECTIONS] = {0}, x2[BQ_SECTIONS] = {0}, y1[BQ_SECTIONS] = {0}, y2[BQ_SECTIONS] = {0};
+    double max_err = 0, sq_err = 0;
+
+    biquad.begin(bq_coeffs, BQ_SECTIONS);
+    uint32_t outputs = runRandomBlocks(biquad);
+
+    for(uint32_t n = 0; n < SIG_LEN; n++){
+        double v = signal_in[n];
+        for(uint8_t s = 0; s < BQ_SECTIONS; s++){
+            const BiquadCoeffs &c = bq_coeffs[s];
+            double y = (c.b0 * v + c.b1 * x1[s] + c.b2 * x2[s] - c.a1 * y1[s] - c.a2 * y2[s]) / (1 << BIQUAD_Q);
+            x2[s] = x1[s];
+            x1[s] = v;
+            y2[s] = y1[s];
+            y1[s] = y;
+            v = y;
+        }
+        double e = fabs(v - signal_out[n]);
+        max_err = e > max_err ? e : max_err;
+        sq_err += e * e;
+    }
+
+    printCheck("biquad", outputs, SIG_LEN, max_err, sq_err, biquad_max_rms);
+}
+
+static void printBench(const char *stage, uint16_t block, uint32_t cycles, float macs_per_sample){
+
+    float n = (float)bench_repeats * SIG_LEN;
+    float per_s = n * getCpuFrequencyMhz() * 1e6f / cycles;
+    Serial.printf("%s,%u,%.0f,%.0f,%.2f\n", stage, block, per_s, per_s * macs_per_sample, cycles / n);
+}
+
+static uint32_t timeStage(FilterStage &stage, uint16_t block){
+
+    stage.reset();
+    uint32_t t0 = ESP.getCycleCount();
+    for(uint8_t r = 0; r < bench_repeats; r++)
+        for(uint32_t i = 0; i < SIG_LEN; i += block)
+            stage.process(signal_in + i, signal_out, block);
+    return ESP.getCycleCount() - t0;
+}
+
+static uint32_t timeLesson(){
+
+    uint32_t t0 = ESP.getCycleCount();
+    for(uint8_t r = 0; r < bench_repeats; r++)
+        for(uint32_t i = 0; i + 10 <= SIG_LEN; i += 10){
+            float avg = 0;
+            for(uint8_t k = 0; k < 10; k++)
+                avg += signal_in[i + k];
+            signal_out[i / 10] = avg / 10;
+        }
+    return ESP.getCycleCount() - t0;
+}
+
+//************************************************************
+//FreeRTOS TASKS
+
+void benchTask(void *parameters){
+
+    for(uint32_t i = 0; i < SIG_LEN; i++)
+        signal_in[i] = 2048 + 1200 * sinf(i * 0.003f) + 600 * sinf(i * 0.9f) + random(-50, 50);
+
+    firLowpass(fir_coeffs, FIR_TAPS, fir_cutoff);
+    for(uint8_t s = 0; s < BQ_SECTIONS; s++)
+        bq_coeffs[s] = biquadLowpass(bq_cutoff, bq_q[s]);
+
+    Serial.println("test,outputs,expected,max_err_lsb,rms_err_lsb,result");
+    checkFir(1);
+    checkFir(4);
+    checkCic();
+    checkBiquad();
+
+    Serial.println("stage,block,samples_per_s,macs_per_s,cycles_per_sample");
+    printBench("lesson_mean10", 10, timeLesson(), 1);
+    for(uint8_t b = 0; b < sizeof(bench_blocks) / sizeof(bench_blocks[0]); b++){
+        uint16_t block = bench_blocks[b];
+
+        fir.begin(fir_coeffs, FIR_TAPS, block);
+        printBench("fir", block, timeStage(fir, block), FIR_TAPS);
+
+        fir.begin(fir_coeffs, FIR_TAPS, block, 4);
+        printBench("fir_decim4", block, timeStage(fir, block), FIR_TAPS / 4.0f);
+
+        //Integrators on every input, combs on every output
+        cic.begin(CIC_RATIO);
+        printBench("cic", block, timeStage(cic, block), CIC_STAGES + (float)CIC_STAGES / CIC_RATIO);
+
+        biquad.begin(bq_coeffs, BQ_SECTIONS);
+        printBench("biquad", block, timeStage(biquad, block), 5 * BQ_SECTIONS);
+    }
+
+    Serial.println("done.");
+    vTaskDelete(NULL);
+}
+
+void setup(){
+
+    Serial.begin(115200);
+
+    vTaskDelay(1000 / portTICK_PERIOD_MS);
+    Serial.println();
+    Serial.println("---FreeRTOS Filter stages---");
+
+    xTaskCreatePinnedToCore(benchTask, "Bench", 4096, NULL, 1, NULL, app_cpu);
+
+    vTaskDelete(NULL);
+}
+
+void loop(){
+    //Never reached
+}
@@ -0,0 +1,168 @@
+/*
+    Streaming statistics: samples per second for each kernel
+
+    Every kernel of Includes/streamStats.h goes through the same buffer of
+    fake ADC samples (a sine plus noise, 12 bits) a number of times, and we
+    print how many samples per second it keeps up with, with:
+        - add:      one call per sample, like averageCalc in the challenges
+        - block:    addBlock() over the whole buffer, like a block of
+                    Includes/adcPipeline.h
+    lesson_avg is the challenges' float sum and divide (groups of 8 here,
+    so they fit the buffer), as a reference.
+
+    After that, the results are checked against a double precision pass
+    over the same samples (mean, std dev, p50/p99 and the last window).
+*/
+
+#include <Arduino.h>
+#include <stdlib.h>
+#include <streamStats.h>
+
+// Use only core 1 for demo purposes
+#if CONFIG_FREERTOS_UNICORE
+  static const BaseType_t app_cpu = 0;
+#else
+  static const BaseType_t app_cpu = 1;
+#endif
+
+//Settings
+enum {BUF_LEN = 1024, WIN = 64};
+static const uint16_t repeats = 200;            //200k samples per run
+
+//Globals
+static uint16_t samples[BUF_LEN];
+
+static MovingAvg<WIN> window;
+static Ema<3> ema;
+static Welford welford;
+static MinMax<WIN> minmax;
+static PercentileSketch<12, 4> pct;
+static StreamStats<WIN> all;
+
+//************************************************************
+//Functions
+
+template <typename S>
+static uint32_t timeKernel(S &stat, bool block){
+
+    stat.reset();
+    uint32_t t0 = ESP.getCycleCount();
+    for(uint16_t r = 0; r < repeats; r++){
+        if(block)
+            stat.addBlock(samples, BUF_LEN);
+        else
+            for(uint16_t i = 0; i < BUF_LEN; i++)
+                stat.add(samples[i]);
+    }
+    return ESP.getCycleCount() - t0;
+}
+
+static uint32_t timeLesson(){
+
+    volatile float avg = 0;
+    uint32_t t0 = ESP.getCycleCount();
+    for(uint16_t r = 0; r < repeats; r++)
+        for(uint16_t i = 0; i < BUF_LEN; i += 8){
+            float sum = 0;
+            for(uint8_t k = 0; k < 8; k++)
+                sum += samples[i + k];
+            avg = sum / 8;
+        }
+    (void)avg;
+    return ESP.getCycleCount() - t0;
+}
+
+static void printRow(const char *name, const char *mode, uint32_t cycles){
+
+    float n = (float)repeats * BUF_LEN;
+    Serial.printf("%s,%s,%.0f,%.2f\n", name, mode, n * getCpuFrequencyMhz() * 1e6f / cycles, cycles / n);
+}
+
+template <typename S>
+static void benchKernel(const char *name, S &stat){
+    printRow(name, "add", timeKernel(stat, false));
+    printRow(name, "block", timeKernel(stat, true));
+}
+
+static int cmpSample(const void *a, const void *b){
+    return *(const uint16_t*)a - *(const uint16_t*)b;
+}
+
+//One pass of the buffer through all, against doubles
+static void check(){
+
+    static uint16_t sorted[BUF_LEN];
+    double mean = 0, var = 0, win_mean = 0;
+    int32_t lo = 0xFFFF, hi = -1;
+
+    all.reset();
+    all.addBlock(samples, BUF_LEN);
+    StatsSnapshot s = all.snapshot();
+
+    for(uint16_t i = 0; i < BUF_LEN; i++)
+        mean += samples[i];
+    mean /= BUF_LEN;
+    for(uint16_t i = 0; i < BUF_LEN; i++)
+        var += (samples[i] - mean) * (samples[i] - mean);
+    var /= BUF_LEN - 1;
+    for(uint16_t i = BUF_LEN - WIN; i < BUF_LEN; i++){
+        win_mean += samples[i];
+        if(samples[i] < lo)
+            lo = samples[i];
+        if(samples[i] > hi)
+            hi = samples[i];
+    }
+    win_mean /= WIN;
+
+    memcpy(sorted, samples, sizeof(sorted));
+    qsort(sorted, BUF_LEN, sizeof(uint16_t), cmpSample);
+
+    Serial.println("value,fixed_point,reference");
+    Serial.printf("mean,%.4f,%.4f\n", s.total_mean, mean);
+    Serial.printf("stddev,%.4f,%.4f\n", s.stddev, sqrt(var));
+    Serial.printf("window_mean,%.4f,%.4f\n", s.mean, win_mean);
+    Serial.printf("window_min,%ld,%ld\n", (long)s.min, (long)lo);
+    Serial.printf("window_max,%ld,%ld\n", (long)s.max, (long)hi);
+    Serial.printf("p50,%ld,%u\n", (long)s.p50, sorted[(BUF_LEN - 1) / 2]);
+    Serial.printf("p99,%ld,%u\n", (long)s.p99, sorted[BUF_LEN * 99 / 100 - 1]);
+}
+
+//************************************************************
+//FreeRTOS TASKS
+
+void benchTask(void *parameters){
+
+    for(uint16_t i = 0; i < BUF_LEN; i++)
+        samples[i] = 2048 + 1500 * sinf(i * 2 * PI / 256) + random(-200, 200);
+
+    Serial.println("stat,mode,samples_per_s,cycles_per_sample");
+    printRow("lesson_avg", "add", timeLesson());
+    benchKernel("moving_avg", window);
+    benchKernel("ema", ema);
+    benchKernel("welford", welford);
+    benchKernel("minmax", minmax);
+    benchKernel("percentile", pct);
+    benchKernel("all", all);
+
+    check();
+
+    Serial.println("done.");
+    vTaskDelete(NULL);
+}
+
+void setup(){
+
+    Serial.begin(115200);
+
+    vTaskDelay(1000 / portTICK_PERIOD_MS);
+    Serial.println();
+    Serial.println("---FreeRTOS Streaming statistics---");
+
+    xTaskCreatePinnedToCore(benchTask, "Bench", 4096, NULL, 1, NULL, app_cpu);
+
+    vTaskDelete(NULL);
+}
+
+void loop(){
+    //Never reached
+}
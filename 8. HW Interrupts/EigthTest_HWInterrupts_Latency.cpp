@@ -0,0 +1,224 @@
+/*
+    How long does a deferred interrupt take to reach its task?
+
+    Same idea as EigthTest_HWInterrupts_3.cpp, measured with
+    Includes/isrLatency.h. Build with the profiler on (platformio.ini):
+        build_flags = -DISRLAT_ENABLE=1
+
+    Two ISR sources, both hardware timers attached from setup() (core 1):
+        - "sem":    timer 0 @ 1 kHz, reads the ADC and gives a binary
+                    semaphore to its task, like the lesson
+        - "notify": timer 1 @ 700 Hz, reads the ADC and gives a direct task
+                    notification (the note at the end of the lesson)
+
+    For every scenario both tasks are created with the same priority and
+    core, next to a "task A" that runs for a while and idles (busy_ms, then
+    idle_ms), and after run_time we print the isr/wake/total latency of both
+    sources. The wake latency is the one to watch:
+        - woken task above task A, on the ISR's core: the yield switches
+          right away
+        - same, on the other core: the wake-up crosses cores
+        - same priority as task A: the yield doesn't preempt a task of equal
+          priority, so the woken task waits for its time slice
+        - below task A: it waits until task A idles (overruns show up)
+*/
+
+#include <Arduino.h>
+#include <stdlib.h>
+#include <isrLatency.h>
+
+static const BaseType_t pro_cpu = 0;
+static const BaseType_t app_cpu = 1;
+
+//Settings
+static const uint16_t timer_divider = 80;                       //1 MHz
+static const uint64_t sem_period_us = 1000;
+static const uint64_t notify_period_us = 1429;                  //~700 Hz
+static const TickType_t run_time = 3000 / portTICK_PERIOD_MS;
+static const uint32_t busy_ms = 5;
+static const TickType_t idle_ms = 5;
+
+enum {SRC_SEM, SRC_NOTIFY};
+
+typedef struct{
+    const char *name;
+    UBaseType_t task_prio;              //the two woken tasks
+    BaseType_t task_core;
+    UBaseType_t load_prio;              //task A
+}Scenario;
+
+static const Scenario scenarios[] = {
+    {"above_load_same_core",  3, app_cpu, 2},
+    {"above_load_other_core", 3, pro_cpu, 2},
+    {"equal_to_load",         2, app_cpu, 2},
+    {"below_load",            1, app_cpu, 2},
+};
+
+//We will use an ADC, which is GPIO36 or A0 (physically VP)
+static const uint8_t adc_pin = A0;
+
+//Globals
+static hw_timer_t *sem_timer = NULL;
+static hw_timer_t *notify_timer = NULL;
+static SemaphoreHandle_t bin_sem = NULL;
+static SemaphoreHandle_t stopped = NULL;
+static volatile TaskHandle_t notify_task = NULL;
+static volatile bool running = false;
+static volatile uint16_t sem_val, notify_val;
+
+//************************************************************
+//Interrupt Service Routines - ISRs
+
+void IRAM_ATTR onSemTimer(){
+
+    BaseType_t task_woken = pdFALSE;
+
+    ISRLAT_ENTRY(SRC_SEM);
+    sem_val = analogRead(adc_pin);
+
+    ISRLAT_GIVE(SRC_SEM);
+    xSemaphoreGiveFromISR(bin_sem, &task_woken);
+
+    if(task_woken){
+        portYIELD_FROM_ISR();
+    }
+}
+
+void IRAM_ATTR onNotifyTimer(){
+
+    BaseType_t task_woken = pdFALSE;
+
+    ISRLAT_ENTRY(SRC_NOTIFY);
+    notify_val = analogRead(adc_pin);
+
+    if(notify_task != NULL){
+        ISRLAT_GIVE(SRC_NOTIFY);
+        vTaskNotifyGiveFromISR(notify_task, &task_woken);
+    }
+
+    if(task_woken){
+        portYIELD_FROM_ISR();
+    }
+}
+
+//************************************************************
+//FreeRTOS TASKS
+
+//The lesson's printValues, without the print: it would be most of the latency
+void semTask(void *parameters){
+
+    uint32_t sum = 0;
+
+    while(running){
+        if(xSemaphoreTake(bin_sem, 10 / portTICK_PERIOD_MS) == pdTRUE){
+            ISRLAT_RESUME(SRC_SEM);
+            sum += sem_val;
+        }
+    }
+    (void)sum;
+    xSemaphoreGive(stopped);
+    vTaskDelete(NULL);
+}
+
+void notifyTask(void *parameters){
+
+    uint32_t sum = 0;
+
+    notify_task = xTaskGetCurrentTaskHandle();
+    while(running){
+        if(ulTaskNotifyTake(pdTRUE, 10 / portTICK_PERIOD_MS) > 0){
+            ISRLAT_RESUME(SRC_NOTIFY);
+            sum += notify_val;
+        }
+    }
+    notify_task = NULL;
+    (void)sum;
+    xSemaphoreGive(stopped);
+    vTaskDelete(NULL);
+}
+
+//Task A: runs for a while and idles
+void loadTask(void *parameters){
+
+    while(running){
+        uint32_t t0 = millis();
+        while(millis() - t0 < busy_ms);
+        vTaskDelay(idle_ms / portTICK_PERIOD_MS);
+    }
+    xSemaphoreGive(stopped);
+    vTaskDelete(NULL);
+}
+
+void benchTask(void *parameters){
+
+    for(uint8_t i = 0; i < sizeof(scenarios) / sizeof(scenarios[0]); i++){
+        const Scenario &sc = scenarios[i];
+
+        running = true;
+        xTaskCreatePinnedToCore(loadTask, "Task A", 2048, NULL, sc.load_prio, NULL, app_cpu);
+        xTaskCreatePinnedToCore(semTask, "Sem task", 2048, NULL, sc.task_prio, NULL, sc.task_core);
+        xTaskCreatePinnedToCore(notifyTask, "Notify task", 2048, NULL, sc.task_prio, NULL, sc.task_core);
+
+        //Let them start before counting
+        vTaskDelay(100 / portTICK_PERIOD_MS);
+        ISRLAT_RESET();
+        vTaskDelay(run_time);
+
+        running = false;
+        for(uint8_t t = 0; t < 3; t++)
+            xSemaphoreTake(stopped, portMAX_DELAY);
+
+        Serial.printf("scenario,%s,task_prio,%u,task_core,%d,load_prio,%u\n", sc.name,
+                        (unsigned)sc.task_prio, (int)sc.task_core, (unsigned)sc.load_prio);
+        ISRLAT_REPORT();
+    }
+
+    Serial.println("done.");
+    vTaskDelete(NULL);
+}
+
+void setup(){
+
+    Serial.begin(115200);
+
+    vTaskDelay(1000 / portTICK_PERIOD_MS);
+    Serial.println();
+    Serial.println("---FreeRTOS HW Interrupts latency---");
+
+#if !ISRLAT_ENABLE
+    Serial.println("Profiler is compiled out, add -DISRLAT_ENABLE=1 to build_flags");
+#endif
+
+    bin_sem = xSemaphoreCreateBinary();
+    stopped = xSemaphoreCreateCounting(3, 0);
+
+    if(bin_sem == NULL || stopped == NULL){
+        Serial.println("ERROR: COULD NOT CREATE SEMAPHORE");
+        ESP.restart();
+    }
+
+    //Line up the cycle counters of both cores
+    ISRLAT_BEGIN();
+    ISRLAT_NAME(SRC_SEM, "sem");
+    ISRLAT_NAME(SRC_NOTIFY, "notify");
+
+    //Both interrupts on this core (1)
+    sem_timer = timerBegin(0, timer_divider, true);
+    timerAttachInterrupt(sem_timer, &onSemTimer, true);
+    timerAlarmWrite(sem_timer, sem_period_us, true);
+    timerAlarmEnable(sem_timer);
+
+    notify_timer = timerBegin(1, timer_divider, true);
+    timerAttachInterrupt(notify_timer, &onNotifyTimer, true);
+    timerAlarmWrite(notify_timer, notify_period_us, true);
+    timerAlarmEnable(notify_timer);
+
+    //Above the woken tasks, so it isn't in the way while it waits
+    xTaskCreatePinnedToCore(benchTask, "Bench", 4096, NULL, configMAX_PRIORITIES - 1, NULL, pro_cpu);
+
+    vTaskDelete(NULL);
+}
+
+void loop(){
+    //Never reached
+}
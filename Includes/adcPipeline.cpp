@@ -0,0 +1,235 @@
+#include <Arduino.h>
+#include <adcPipeline.h>
+#if CONFIG_IDF_TARGET_ESP32
+#include <driver/i2s.h>
+#endif
+
+AdcPipeline::AdcPipeline(){
+    buf[0] = buf[1] = NULL;
+    len = 0;
+    fill = 0;
+    busy = false;
+    consumer = NULL;
+    done = 0;
+    drops = 0;
+}
+
+AdcPipeline::~AdcPipeline(){
+    vPortFree(buf[0]);
+    vPortFree(buf[1]);
+}
+
+bool AdcPipeline::begin(uint16_t block_len){
+
+    //Both in internal RAM: DMA can't reach PSRAM
+    if(len != block_len){
+        vPortFree(buf[0]);
+        vPortFree(buf[1]);
+        buf[0] = (uint16_t*)pvPortMalloc(block_len * sizeof(uint16_t));
+        buf[1] = (uint16_t*)pvPortMalloc(block_len * sizeof(uint16_t));
+        len = block_len;
+    }
+    consumer = xTaskGetCurrentTaskHandle();
+    //A block from the last run that was never taken
+    ulTaskNotifyTake(pdTRUE, 0);
+    fill = 0;
+    busy = false;
+    resetStats();
+    return buf[0] != NULL && buf[1] != NULL;
+}
+
+//True if the full buffer was handed over, false if it has to be reused
+bool IRAM_ATTR AdcPipeline::swap(){
+
+    if(busy.load(std::memory_order_acquire)){
+        drops.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    fill ^= 1;
+    busy.store(true, std::memory_order_release);
+    done.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+void AdcPipeline::blockDone(){
+    if(swap())
+        xTaskNotifyGive(consumer);
+}
+
+void IRAM_ATTR AdcPipeline::blockDoneFromISR(BaseType_t *task_woken){
+    if(swap())
+        vTaskNotifyGiveFromISR(consumer, task_woken);
+}
+
+const uint16_t *AdcPipeline::take(TickType_t ticks){
+    if(ulTaskNotifyTake(pdTRUE, ticks) == 0)
+        return NULL;
+    //The producer doesn't swap while busy, so fill can't change under us
+    return buf[fill ^ 1];
+}
+
+void AdcPipeline::release(){
+    busy.store(false, std::memory_order_release);
+}
+
+//************************************************************
+//Synthetic source: a hardware timer interrupt per block
+
+static const uint8_t synth_hw_timer = 1;
+static const uint16_t synth_divider = 8;            //10 MHz
+
+class SyntheticSource : public BlockSource{
+
+public:
+    const char *name(){ return "synthetic"; }
+
+    bool start(AdcPipeline &pipe, uint32_t rate_hz){
+
+        if(pipe.blockLen() < SYNTH_HEADER)
+            return false;
+        this->pipe = &pipe;
+        block_num = 0;
+        seq = 0;
+        if(timer == NULL){
+            timer = timerBegin(synth_hw_timer, synth_divider, true);
+            if(timer == NULL)
+                return false;
+            timerAttachInterrupt(timer, &onBlock, true);
+        }
+        //One interrupt per block: 10 MHz * samples per block / rate
+        timerAlarmWrite(timer, (uint64_t)10000000 * pipe.blockLen() / rate_hz, true);
+        timerWrite(timer, 0);
+        timerAlarmEnable(timer);
+        return true;
+    }
+
+    void stop(){
+        if(timer != NULL)
+            timerAlarmDisable(timer);
+    }
+
+private:
+    //Stands in for the DMA: writing the ramp is the only per-sample work.
+    //A dropped block still gets its number, so the numbers the task sees
+    //skip one for every block it lost.
+    static void IRAM_ATTR onBlock(){
+
+        BaseType_t task_woken = pdFALSE;
+        uint16_t *dst = pipe->fillBuffer();
+        uint16_t n = pipe->blockLen();
+
+        dst[0] = block_num & 0xFFFF;
+        dst[1] = block_num >> 16;
+        block_num++;
+        for(uint16_t i = SYNTH_HEADER; i < n; i++)
+            dst[i] = (seq + i) & 0xFFF;
+        seq += n;
+
+        pipe->blockDoneFromISR(&task_woken);
+        if(task_woken)
+            portYIELD_FROM_ISR();
+    }
+
+    static hw_timer_t *timer;
+    static AdcPipeline *pipe;
+    static uint32_t block_num;
+    static uint32_t seq;
+};
+
+hw_timer_t *SyntheticSource::timer = NULL;
+AdcPipeline *SyntheticSource::pipe = NULL;
+uint32_t SyntheticSource::block_num = 0;
+uint32_t SyntheticSource::seq = 0;
+
+BlockSource &syntheticSource(){
+    static SyntheticSource source;
+    return source;
+}
+
+//************************************************************
+//I2S ADC source: the I2S peripheral clocks ADC1 and DMA stores the samples
+
+#if CONFIG_IDF_TARGET_ESP32
+
+static const i2s_port_t i2s_port = I2S_NUM_0;
+
+class I2sAdcSource : public BlockSource{
+
+public:
+    const char *name(){ return "i2s_adc"; }
+
+    bool start(AdcPipeline &pipe, uint32_t rate_hz){
+
+        i2s_config_t cfg = {};
+        cfg.mode = (i2s_mode_t)(I2S_MODE_MASTER | I2S_MODE_RX | I2S_MODE_ADC_BUILT_IN);
+        cfg.sample_rate = rate_hz;
+        cfg.bits_per_sample = I2S_BITS_PER_SAMPLE_16BIT;
+        cfg.channel_format = I2S_CHANNEL_FMT_ONLY_LEFT;
+        cfg.communication_format = I2S_COMM_FORMAT_STAND_I2S;
+        cfg.intr_alloc_flags = ESP_INTR_FLAG_LEVEL1;
+        cfg.dma_buf_count = 4;
+        cfg.dma_buf_len = pipe.blockLen();          //samples, 1024 max
+        cfg.use_apll = false;
+
+        if(i2s_driver_install(i2s_port, &cfg, 0, NULL) != ESP_OK)
+            return false;
+        i2s_set_adc_mode(ADC_UNIT_1, ADC1_CHANNEL_0);       //A0, GPIO36
+        i2s_adc_enable(i2s_port);
+
+        this->pipe = &pipe;
+        running = true;
+        if(pump_done == NULL)
+            pump_done = xSemaphoreCreateBinary();
+        if(pump_done == NULL ||
+           xTaskCreatePinnedToCore(pumpTask, "I2S pump", 2048, this, configMAX_PRIORITIES - 1, NULL, tskNO_AFFINITY) != pdPASS){
+            i2s_adc_disable(i2s_port);
+            i2s_driver_uninstall(i2s_port);
+            return false;
+        }
+        return true;
+    }
+
+    void stop(){
+        running = false;
+        xSemaphoreTake(pump_done, portMAX_DELAY);
+        i2s_adc_disable(i2s_port);
+        i2s_driver_uninstall(i2s_port);
+    }
+
+private:
+    /*
+        The DMA interrupt belongs to the I2S driver, so the swap is done by
+        this task instead: i2s_read() blocks until the driver has a block
+        and copies it to the buffer being filled.
+    */
+    static void pumpTask(void *parameters){
+
+        I2sAdcSource *src = (I2sAdcSource*)parameters;
+        AdcPipeline *pipe = src->pipe;
+        size_t bytes = pipe->blockLen() * sizeof(uint16_t), got;
+
+        while(src->running){
+            uint16_t *dst = pipe->fillBuffer();
+            if(i2s_read(i2s_port, dst, bytes, &got, portMAX_DELAY) != ESP_OK || got != bytes)
+                continue;
+            //The top 4 bits hold the channel number
+            for(uint16_t i = 0; i < pipe->blockLen(); i++)
+                dst[i] &= 0xFFF;
+            pipe->blockDone();
+        }
+
+        xSemaphoreGive(src->pump_done);
+        vTaskDelete(NULL);
+    }
+
+    AdcPipeline *pipe = NULL;
+    volatile bool running = false;
+    SemaphoreHandle_t pump_done = NULL;
+};
+
+BlockSource &i2sAdcSource(){
+    static I2sAdcSource source;
+    return source;
+}
+
+#endif
@@ -0,0 +1,95 @@
+#ifndef ADCPIPELINE_H_
+#define ADCPIPELINE_H_
+
+#include <Arduino.h>
+#include <atomic>
+
+/*
+    Block acquisition with two buffers (ping-pong)
+
+    EigthTest_HWInterrupts_Challenge.cpp does one analogRead() per timer
+    interrupt, and wakes the task every 10 samples. At 10 Hz that's fine; at
+    100 kHz the interrupts alone would eat the CPU, and analogRead() can't
+    go that fast anyway.
+
+    Here samples arrive in blocks. Something that doesn't need the CPU per
+    sample (DMA) fills one buffer while the processing task works on the
+    other one. When a block is full, the ISR (or the task that gets it from
+    the driver) only swaps the two buffers and notifies the processing task:
+    one interrupt and one wake-up per block, not per sample.
+
+        //Producer side (source ISR or driver task)
+        uint16_t *dst = pipe.fillBuffer();      //fill len samples here
+        pipe.blockDoneFromISR(&task_woken);
+
+        //Processing task (the one that called begin())
+        const uint16_t *block = pipe.take(portMAX_DELAY);
+        ...process pipe.blockLen() samples...
+        pipe.release();
+
+    If the processing task still has the last block when a new one is
+    ready, there's nowhere to put it: the buffer being filled is reused and
+    the block counts as dropped. dropped() should stay at 0; if it doesn't,
+    processing is too slow for the rate.
+
+    Two block sources come with it (like the pcBench backends):
+        syntheticSource()  a hardware timer interrupt once per block. The
+                           first two samples are the block number (low and
+                           high 16 bits), so the processing task can count
+                           the blocks that never reached it; the rest is a
+                           12-bit ramp.
+        i2sAdcSource()     the ESP32's ADC1 sampled by the I2S peripheral
+                           with DMA, up to a few hundred kHz (A0 / GPIO36).
+*/
+
+class AdcPipeline{
+
+public:
+    AdcPipeline();
+    ~AdcPipeline();
+
+    //Call from the processing task: it's the one that gets notified.
+    //With the source stopped.
+    bool begin(uint16_t block_len);
+
+    //Producer
+    uint16_t *fillBuffer(){ return buf[fill]; }
+    void blockDone();
+    void blockDoneFromISR(BaseType_t *task_woken);
+
+    //Processing task: NULL on timeout
+    const uint16_t *take(TickType_t ticks);
+    void release();
+
+    uint16_t blockLen() const { return len; }
+    uint32_t blocks() const { return done; }        //handed to the processing task
+    uint32_t dropped() const { return drops; }
+    void resetStats(){ done = 0; drops = 0; }
+
+private:
+    bool swap();
+
+    uint16_t *buf[2];
+    uint16_t len;
+    volatile uint8_t fill;                  //buffer being filled, the other one is processed
+    std::atomic<bool> busy;                 //processing task has the other buffer
+    TaskHandle_t consumer;
+    std::atomic<uint32_t> done, drops;
+};
+
+class BlockSource{
+
+public:
+    virtual ~BlockSource(){}
+    virtual const char *name() = 0;
+    virtual bool start(AdcPipeline &pipe, uint32_t rate_hz) = 0;
+    virtual void stop() = 0;
+};
+
+enum {SYNTH_HEADER = 2};                //samples of block number in a synthetic block
+BlockSource &syntheticSource();
+#if CONFIG_IDF_TARGET_ESP32
+BlockSource &i2sAdcSource();
+#endif
+
+#endif
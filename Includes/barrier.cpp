@@ -0,0 +1,81 @@
+#include <Arduino.h>
+#include <barrier.h>
+
+static const EventBits_t OPEN = 1;
+static const EventBits_t ROUND_BITS[2] = {1, 2};    //even and odd rounds
+
+//************************************************************
+//CountdownLatch
+
+bool CountdownLatch::begin(uint32_t n){
+    if(group == NULL)
+        group = xEventGroupCreateStatic(&group_buf);
+    reset(n);
+    return group != NULL;
+}
+
+void CountdownLatch::reset(uint32_t n){
+    xEventGroupClearBits(group, OPEN);
+    count.store(n, std::memory_order_release);
+    if(n == 0)
+        xEventGroupSetBits(group, OPEN);
+}
+
+void CountdownLatch::countDown(){
+    //fetch_sub returns the old value: 1 means we were the last one
+    if(count.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        xEventGroupSetBits(group, OPEN);
+}
+
+//Setting bits from an ISR is deferred to the timer daemon task
+void CountdownLatch::countDownFromISR(BaseType_t *task_woken){
+    if(count.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        xEventGroupSetBitsFromISR(group, OPEN, task_woken);
+}
+
+BaseType_t CountdownLatch::wait(TickType_t ticks){
+    if(count.load(std::memory_order_acquire) == 0)
+        return pdTRUE;
+    return (xEventGroupWaitBits(group, OPEN, pdFALSE, pdTRUE, ticks) & OPEN) ? pdTRUE : pdFALSE;
+}
+
+//************************************************************
+//CyclicBarrier
+
+bool CyclicBarrier::begin(uint32_t n){
+    if(group == NULL)
+        group = xEventGroupCreateStatic(&group_buf);
+    parties = n;
+    arrived.store(0, std::memory_order_relaxed);
+    generation.store(0, std::memory_order_release);
+    if(group != NULL)
+        xEventGroupClearBits(group, ROUND_BITS[0] | ROUND_BITS[1]);
+    return group != NULL && n > 0;
+}
+
+/*
+    Rounds alternate between two bits (sense reversal). Waiters of round k
+    wait on bit k%2 without clearing it, so the last one can release them all
+    with one set. That bit is cleared when round k+1 ends: by then everybody
+    left round k, because round k+1 can't end until they all arrived to it.
+
+    generation can't change between our load and our fetch_add: the round
+    doesn't end until we have arrived.
+*/
+bool CyclicBarrier::arriveAndWait(){
+
+    uint32_t gen = generation.load(std::memory_order_acquire);
+    EventBits_t bit = ROUND_BITS[gen & 1];
+
+    if(arrived.fetch_add(1, std::memory_order_acq_rel) + 1 == parties){
+        //Nobody else can arrive until we open the barrier
+        arrived.store(0, std::memory_order_relaxed);
+        generation.store(gen + 1, std::memory_order_release);
+        xEventGroupClearBits(group, ROUND_BITS[(gen + 1) & 1]);
+        xEventGroupSetBits(group, bit);
+        return true;
+    }
+
+    xEventGroupWaitBits(group, bit, pdFALSE, pdTRUE, portMAX_DELAY);
+    return false;
+}
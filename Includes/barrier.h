@@ -0,0 +1,74 @@
+#ifndef BARRIER_H_
+#define BARRIER_H_
+
+#include <Arduino.h>
+#include <atomic>
+
+/*
+    Join-style waits: CountdownLatch and CyclicBarrier
+
+    DiningPhilosophers.cpp waits for the philosophers by taking done_sem
+    NUM_TASKS times, and Sixth_semaphore_2.cpp takes sem_params five times.
+    The waiting task can be woken once per give, just to go back to sleep.
+
+    CountdownLatch: created with a count, every worker calls countDown() once
+    when it's done, and wait() returns when the count gets to 0. Waiters are
+    woken ONCE, by the last countDown(). The other countDown() calls are a
+    single atomic operation, no kernel.
+
+        static CountdownLatch done;
+        done.begin(NUM_TASKS);
+        ...workers: done.countDown();
+        done.wait(portMAX_DELAY);           //main
+
+    CyclicBarrier: parties tasks call arriveAndWait() in a loop, and nobody
+    leaves round k until all of them arrived to round k. The last one to
+    arrive releases the rest, who are woken once each. It can be used again
+    for the next round right away.
+
+    Both work for tasks on either core. They sleep on a static event group,
+    which wakes every waiter of one bit with a single call.
+*/
+
+class CountdownLatch{
+
+public:
+    CountdownLatch() : count(0), group(NULL) {}
+
+    bool begin(uint32_t count);
+
+    void countDown();
+    void countDownFromISR(BaseType_t *task_woken);
+    BaseType_t wait(TickType_t ticks);      //pdTRUE when the count got to 0
+
+    //Only when nobody is waiting or counting down
+    void reset(uint32_t count);
+
+    uint32_t getCount() const { return count.load(std::memory_order_acquire); }
+
+private:
+    std::atomic<uint32_t> count;
+    EventGroupHandle_t group;
+    StaticEventGroup_t group_buf;
+};
+
+class CyclicBarrier{
+
+public:
+    CyclicBarrier() : parties(0), arrived(0), generation(0), group(NULL) {}
+
+    bool begin(uint32_t parties);
+
+    //Returns true in exactly one task per round: the last one to arrive.
+    //No timeout: a task giving up would leave the others stuck.
+    bool arriveAndWait();
+
+private:
+    uint32_t parties;
+    std::atomic<uint32_t> arrived;
+    std::atomic<uint32_t> generation;       //rounds completed
+    EventGroupHandle_t group;
+    StaticEventGroup_t group_buf;
+};
+
+#endif
@@ -0,0 +1,248 @@
+#ifndef EVENTBUS_H_
+#define EVENTBUS_H_
+
+#include <Arduino.h>
+#include <atomic>
+
+/*
+    Publish/subscribe event bus: EventBus<EVT_SIZE, POOL_LEN, MAX_SUBS, INBOX_LEN>
+
+    Today "Message received", new ADC averages or timer expirations go to ONE
+    task through ONE queue. Sending them to more tasks would need a queue and
+    a copy per subscriber.
+
+    Here the publisher puts the event in a buffer taken from a pool, and every
+    subscriber of that topic gets a pointer to the same buffer in its own
+    inbox. A reference count tracks how many subscribers still hold it, and
+    the last one to release it gives it back to the pool. So publishing to N
+    subscribers costs N pointer pushes and no payload copies.
+
+        typedef EventBus<32, 16, 4, 16> StatusBus;
+        static StatusBus bus;
+
+        publisher:   StatusBus::Event *ev = bus.alloc();
+                     ev->len = sprintf((char*)ev->data, "blinked");
+                     bus.publish(TOPIC_BLINK, ev);
+
+        subscriber:  int8_t me = bus.subscribe(1 << TOPIC_BLINK);   //from its own task
+                     StatusBus::Event *ev = bus.receive(me, portMAX_DELAY);
+                     ...read ev->data...
+                     bus.release(ev);
+
+    Topics are numbers from 0 to 31, a subscriber gives a mask of the topics it
+    wants. An event published to any other topic is dropped. The pool and the inboxes are lock-free (compare-and-swap), so
+    publish can be called from any core and from ISRs (publishFromISR).
+    Subscribers are woken with a task notification, only when they sleep, so
+    a subscriber task shouldn't use its notification value for anything else.
+*/
+
+template <uint16_t EVT_SIZE>
+struct BusEventT{
+    uint8_t topic;
+    uint16_t len;
+    std::atomic<uint8_t> refs;
+    uint8_t data[EVT_SIZE];
+};
+
+template <uint16_t EVT_SIZE, uint16_t POOL_LEN, uint8_t MAX_SUBS, uint16_t INBOX_LEN>
+class EventBus{
+
+    static_assert((INBOX_LEN & (INBOX_LEN - 1)) == 0, "INBOX_LEN must be a power of 2");
+    //Subscriber ids are int8_t, and refs (uint8_t) counts the publisher too
+    static_assert(MAX_SUBS > 0 && MAX_SUBS <= 127, "MAX_SUBS must be 1 to 127");
+
+public:
+
+    typedef BusEventT<EVT_SIZE> Event;
+
+    EventBus(){
+        for(uint16_t w = 0; w < WORDS; w++)
+            free_mask[w] = 0;
+        for(uint16_t i = 0; i < POOL_LEN; i++)
+            free_mask[i / 32] |= 1UL << (i % 32);
+        num_subs = 0;
+        drops = 0;
+    }
+
+    //Must be called from the subscribing task: it's the one that gets woken
+    int8_t subscribe(uint32_t topics){
+
+        int8_t id = -1;
+
+        portENTER_CRITICAL(&lock);
+        if(num_subs < MAX_SUBS){
+            id = num_subs;
+            subs[id].task = xTaskGetCurrentTaskHandle();
+            subs[id].topics = topics;
+            subs[id].head = subs[id].tail = 0;
+            subs[id].waiting = false;
+            for(uint16_t i = 0; i < INBOX_LEN; i++)
+                subs[id].inbox[i] = NULL;
+            //publishers only look at subscribers below num_subs
+            num_subs.store(id + 1, std::memory_order_release);
+        }
+        portEXIT_CRITICAL(&lock);
+
+        return id;
+    }
+
+    //Takes a free event from the pool, NULL if they're all in use
+    Event *alloc(){
+        for(uint16_t w = 0; w < WORDS; w++){
+            uint32_t m = free_mask[w].load(std::memory_order_relaxed);
+            while(m != 0){
+                uint32_t bit = m & (~m + 1);    //lowest free bit
+                if(free_mask[w].compare_exchange_weak(m, m & ~bit, std::memory_order_acquire)){
+                    Event *ev = &pool[w * 32 + __builtin_ctz(bit)];
+                    ev->refs.store(1, std::memory_order_relaxed);
+                    ev->len = 0;
+                    return ev;
+                }
+            }
+        }
+        return NULL;
+    }
+
+    //Gives up one reference, the last one returns the event to the pool
+    void release(Event *ev){
+        if(ev->refs.fetch_sub(1, std::memory_order_acq_rel) == 1){
+            uint16_t i = ev - pool;
+            free_mask[i / 32].fetch_or(1UL << (i % 32), std::memory_order_release);
+        }
+    }
+
+    //Returns how many subscribers got the event
+    uint8_t publish(uint8_t topic, Event *ev){
+        return fanOut(topic, ev, NULL);
+    }
+
+    //Copies data into a pooled event and publishes it
+    uint8_t publish(uint8_t topic, const void *data, uint16_t len){
+        Event *ev = alloc();
+        if(ev == NULL || len > EVT_SIZE){
+            if(ev != NULL)
+                release(ev);
+            drops++;
+            return 0;
+        }
+        memcpy(ev->data, data, len);
+        ev->len = len;
+        return fanOut(topic, ev, NULL);
+    }
+
+    uint8_t publishFromISR(uint8_t topic, Event *ev, BaseType_t *task_woken){
+        return fanOut(topic, ev, task_woken);
+    }
+
+    //Next event for subscriber id, NULL after ticks
+    Event *receive(int8_t id, TickType_t ticks){
+
+        sub_t &s = subs[id];
+        Event *ev;
+
+        while((ev = pop(s)) == NULL){
+            s.waiting = true;
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if((ev = pop(s)) != NULL){
+                s.waiting = false;
+                break;
+            }
+            uint32_t got = ulTaskNotifyTake(pdTRUE, ticks);
+            s.waiting = false;
+            if(got == 0)
+                return NULL;
+        }
+        return ev;
+    }
+
+    //Events lost because the pool or an inbox was full
+    uint32_t dropped() const { return drops; }
+
+private:
+
+    static const uint16_t WORDS = (POOL_LEN + 31) / 32;
+
+    typedef struct{
+        TaskHandle_t task;
+        uint32_t topics;
+        std::atomic<uint32_t> head, tail;       //free running counters
+        std::atomic<bool> waiting;
+        std::atomic<Event*> inbox[INBOX_LEN];
+    }sub_t;
+
+    //Multi-producer push: claim a position with CAS, then fill it
+    bool push(sub_t &s, Event *ev){
+        uint32_t h = s.head.load(std::memory_order_relaxed);
+        do{
+            if(h - s.tail.load(std::memory_order_acquire) >= INBOX_LEN)
+                return false;
+        }while(!s.head.compare_exchange_weak(h, h + 1, std::memory_order_relaxed));
+
+        s.inbox[h & (INBOX_LEN - 1)].store(ev, std::memory_order_release);
+        return true;
+    }
+
+    //Single consumer: an empty slot means nothing published there yet
+    Event *pop(sub_t &s){
+        uint32_t t = s.tail.load(std::memory_order_relaxed);
+        std::atomic<Event*> &slot = s.inbox[t & (INBOX_LEN - 1)];
+        Event *ev = slot.load(std::memory_order_acquire);
+        if(ev == NULL)
+            return NULL;
+        slot.store(NULL, std::memory_order_relaxed);
+        s.tail.store(t + 1, std::memory_order_release);
+        return ev;
+    }
+
+    uint8_t fanOut(uint8_t topic, Event *ev, BaseType_t *task_woken){
+
+        uint8_t n = num_subs.load(std::memory_order_acquire);
+        uint8_t delivered = 0;
+
+        //No bit for it in the subscribers' masks
+        if(topic >= 32){
+            release(ev);
+            drops++;
+            return 0;
+        }
+        ev->topic = topic;
+
+        for(uint8_t i = 0; i < n; i++){
+            sub_t &s = subs[i];
+            if(!(s.topics & (1UL << topic)))
+                continue;
+
+            //Take the subscriber's reference before it can see the event
+            ev->refs.fetch_add(1, std::memory_order_relaxed);
+            if(!push(s, ev)){
+                ev->refs.fetch_sub(1, std::memory_order_relaxed);
+                drops++;
+                continue;
+            }
+            delivered++;
+
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if(s.waiting){
+                if(task_woken != NULL)
+                    vTaskNotifyGiveFromISR(s.task, task_woken);
+                else
+                    xTaskNotifyGive(s.task);
+            }
+        }
+
+        //Drop the publisher's reference from alloc()
+        release(ev);
+        return delivered;
+    }
+
+    Event pool[POOL_LEN];
+    std::atomic<uint32_t> free_mask[WORDS];     //1 = free
+
+    sub_t subs[MAX_SUBS];
+    std::atomic<uint8_t> num_subs;
+    std::atomic<uint32_t> drops;
+
+    portMUX_TYPE lock = portMUX_INITIALIZER_UNLOCKED;    //only for subscribe
+};
+
+#endif
@@ -0,0 +1,241 @@
+#include <Arduino.h>
+#include <filterStage.h>
+
+//************************************************************
+//FIR
+
+FirFilter::FirFilter(){
+    coef = NULL;
+    hist = NULL;
+    taps = 0;
+    max_block = 0;
+    decim = 1;
+    phase = 0;
+}
+
+FirFilter::~FirFilter(){
+    vPortFree(coef);
+    vPortFree(hist);
+}
+
+bool FirFilter::begin(const int16_t *coeffs_q15, uint16_t taps, uint16_t max_block, uint16_t decim){
+
+    if(taps == 0 || max_block == 0 || decim == 0)
+        return false;
+
+    vPortFree(coef);
+    vPortFree(hist);
+    coef = (int16_t*)pvPortMalloc(taps * sizeof(int16_t));
+    hist = (int16_t*)pvPortMalloc((taps - 1 + max_block) * sizeof(int16_t));
+    if(coef == NULL || hist == NULL)
+        return false;
+
+    for(uint16_t k = 0; k < taps; k++)
+        coef[k] = coeffs_q15[taps - 1 - k];
+    this->taps = taps;
+    this->max_block = max_block;
+    this->decim = decim;
+    reset();
+    return true;
+}
+
+void FirFilter::reset(){
+    if(hist != NULL)
+        memset(hist, 0, (taps - 1) * sizeof(int16_t));
+    phase = 0;
+}
+
+/*
+    count outputs, the j-th one starting at x[j * stride]. Four at a time:
+    each coefficient is loaded once for four products, and the four
+    accumulators don't wait for each other.
+*/
+static void firKernel(const int16_t *x, const int16_t *c, uint16_t taps, uint32_t stride, uint32_t count, int16_t *out){
+
+    uint32_t j = 0;
+
+    for(; j + 4 <= count; j += 4){
+        const int16_t *x0 = x + j * stride;
+        const int16_t *x1 = x0 + stride;
+        const int16_t *x2 = x1 + stride;
+        const int16_t *x3 = x2 + stride;
+        int32_t a0 = 0, a1 = 0, a2 = 0, a3 = 0;
+        for(uint16_t k = 0; k < taps; k++){
+            int32_t ck = c[k];
+            a0 += ck * x0[k];
+            a1 += ck * x1[k];
+            a2 += ck * x2[k];
+            a3 += ck * x3[k];
+        }
+        out[j] = filterSat(a0, 15);
+        out[j + 1] = filterSat(a1, 15);
+        out[j + 2] = filterSat(a2, 15);
+        out[j + 3] = filterSat(a3, 15);
+    }
+
+    for(; j < count; j++){
+        const int16_t *x0 = x + j * stride;
+        int32_t a0 = 0;
+        for(uint16_t k = 0; k < taps; k++)
+            a0 += (int32_t)c[k] * x0[k];
+        out[j] = filterSat(a0, 15);
+    }
+}
+
+uint32_t FirFilter::process(const int16_t *in, int16_t *out, uint32_t n){
+
+    uint32_t produced = 0;
+
+    while(n > 0){
+        uint32_t chunk = n < max_block ? n : max_block;
+
+        //Copied before any output is written, so out can be in
+        memcpy(hist + taps - 1, in, chunk * sizeof(int16_t));
+
+        //Outputs at the inputs phase, phase + decim... of this chunk
+        uint32_t count = phase < chunk ? (chunk - phase + decim - 1) / decim : 0;
+        firKernel(hist + phase, coef, taps, decim, count, out + produced);
+        produced += count;
+        phase = phase + count * decim - chunk;
+
+        memmove(hist, hist + chunk, (taps - 1) * sizeof(int16_t));
+        in += chunk;
+        n -= chunk;
+    }
+    return produced;
+}
+
+//************************************************************
+//Biquad cascade
+
+BiquadCascade::BiquadCascade(){
+    count = 0;
+    reset();
+}
+
+bool BiquadCascade::begin(const BiquadCoeffs *sections, uint8_t count){
+
+    if(count == 0 || count > BIQUAD_MAX_SECTIONS)
+        return false;
+    memcpy(coef, sections, count * sizeof(BiquadCoeffs));
+    this->count = count;
+    reset();
+    return true;
+}
+
+void BiquadCascade::reset(){
+    memset(state, 0, sizeof(state));
+}
+
+//A section at a time over the whole block, so its state stays in registers
+uint32_t BiquadCascade::process(const int16_t *in, int16_t *out, uint32_t n){
+
+    const int16_t *src = in;
+
+    for(uint8_t s = 0; s < count; s++){
+        const int32_t b0 = coef[s].b0, b1 = coef[s].b1, b2 = coef[s].b2;
+        const int32_t a1 = coef[s].a1, a2 = coef[s].a2;
+        int32_t x1 = state[s].x1, x2 = state[s].x2, y1 = state[s].y1, y2 = state[s].y2;
+        int32_t err = state[s].err;
+
+        for(uint32_t i = 0; i < n; i++){
+            int32_t x = src[i];
+            int64_t acc = (int64_t)b0 * x + (int64_t)b1 * x1 + (int64_t)b2 * x2
+                        - (int64_t)a1 * y1 - (int64_t)a2 * y2 + err;
+            int64_t y = acc >> BIQUAD_Q;
+            err = acc - (y << BIQUAD_Q);
+            if(y > 32767)
+                y = 32767;
+            else if(y < -32768)
+                y = -32768;
+            x2 = x1;
+            x1 = x;
+            y2 = y1;
+            y1 = y;
+            out[i] = y;
+        }
+
+        state[s].x1 = x1;
+        state[s].x2 = x2;
+        state[s].y1 = y1;
+        state[s].y2 = y2;
+        state[s].err = err;
+        src = out;
+    }
+    if(count == 0 && in != out)
+        memmove(out, in, n * sizeof(int16_t));
+    return n;
+}
+
+//************************************************************
+//Chain
+
+bool FilterChain::add(FilterStage &stage){
+    if(count == FILTER_MAX_STAGES)
+        return false;
+    stages[count++] = &stage;
+    return true;
+}
+
+uint32_t FilterChain::run(int16_t *buf, uint32_t n){
+    for(uint8_t s = 0; s < count && n > 0; s++)
+        n = stages[s]->process(buf, buf, n);
+    return n;
+}
+
+void FilterChain::reset(){
+    for(uint8_t s = 0; s < count; s++)
+        stages[s]->reset();
+}
+
+uint16_t FilterChain::decimation() const {
+    uint16_t d = 1;
+    for(uint8_t s = 0; s < count; s++)
+        d *= stages[s]->decimation();
+    return d;
+}
+
+//************************************************************
+//Design helpers
+
+static float firLowpassTap(uint16_t k, uint16_t taps, float cutoff){
+    float t = k - (taps - 1) / 2.0f;
+    float sinc = t == 0 ? 2 * cutoff : sinf(2 * PI * cutoff * t) / (PI * t);
+    float window = taps > 1 ? 0.54f - 0.46f * cosf(2 * PI * k / (taps - 1)) : 1.0f;
+    return sinc * window;
+}
+
+void firLowpass(int16_t *coeffs_q15, uint16_t taps, float cutoff){
+
+    //Twice through the taps instead of a float array on the stack
+    float sum = 0;
+    for(uint16_t k = 0; k < taps; k++)
+        sum += firLowpassTap(k, taps, cutoff);
+    for(uint16_t k = 0; k < taps; k++)
+        coeffs_q15[k] = lroundf(firLowpassTap(k, taps, cutoff) / sum * 32767.0f);
+}
+
+static int16_t toQ14(float v){
+    long q = lroundf(v * (1 << BIQUAD_Q));
+    if(q > 32767)
+        q = 32767;
+    else if(q < -32768)
+        q = -32768;
+    return q;
+}
+
+BiquadCoeffs biquadLowpass(float cutoff, float q){
+
+    float w0 = 2 * PI * cutoff;
+    float alpha = sinf(w0) / (2 * q);
+    float cw = cosf(w0);
+    float a0 = 1 + alpha;
+    BiquadCoeffs c;
+
+    c.b0 = toQ14((1 - cw) / 2 / a0);
+    c.b1 = toQ14((1 - cw) / a0);
+    c.b2 = c.b0;
+    c.a1 = toQ14(-2 * cw / a0);
+    c.a2 = toQ14((1 - alpha) / a0);
+    return c;
+}
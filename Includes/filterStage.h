@@ -0,0 +1,235 @@
+#ifndef FILTERSTAGE_H_
+#define FILTERSTAGE_H_
+
+#include <Arduino.h>
+
+/*
+    Fixed-point filter stages for sampled signals: FIR, CIC and biquad
+
+    The ADC challenges low-pass their samples with a plain mean of 10: the
+    frequency response has big side lobes, and it's one more pass over every
+    window. Here a filter is a stage that takes a block of samples and gives
+    a block back, so stages can be chained after the sampling buffer (the
+    blocks of Includes/adcPipeline.h, or the challenges' circular buffer):
+
+        FirFilter      FIR with Q15 coefficients, optional decimation
+        CicDecimator<N> N integrators, decimate by R, N combs: no multiplies,
+                       for big rate reductions before a FIR
+        BiquadCascade  up to BIQUAD_MAX_SECTIONS 2nd-order IIR sections,
+                       Q14 coefficients
+
+        static FirFilter lp;
+        static CicDecimator<3> cic;
+        static FilterChain chain;
+        firLowpass(coeffs, 31, 0.1f);                  //cutoff / sample rate
+        lp.begin(coeffs, 31, 256);
+        cic.begin(16);
+        chain.add(cic);
+        chain.add(lp);
+        uint32_t n = chain.run(buf, 256);              //in place, n = 16 out
+
+    Samples are int16_t. ADC counts (12 bits) fit, so a uint16_t block can be
+    passed as is. Every stage keeps its history between blocks, so cutting
+    the stream into blocks doesn't change the output, and every stage can
+    filter in place (in == out).
+
+    The kernels are written for both compilers: the FIR inner loop is a plain
+    dot product over contiguous arrays (the host compiler vectorizes it) and
+    computes 4 outputs at a time so every coefficient load is used 4 times
+    (unrolled for the ESP32). The CIC stage count is a template argument,
+    so its stage loops unroll completely.
+*/
+
+class FilterStage{
+
+public:
+    virtual ~FilterStage(){}
+    virtual const char *name() = 0;
+    //Returns how many samples were written to out (fewer when decimating)
+    virtual uint32_t process(const int16_t *in, int16_t *out, uint32_t n) = 0;
+    virtual void reset() = 0;
+    virtual uint16_t decimation() const { return 1; }
+};
+
+//Q15 -> int16 with rounding, saturated
+static inline int16_t filterSat(int32_t acc, uint8_t q){
+    acc = (acc + (1 << (q - 1))) >> q;
+    if(acc > 32767)
+        return 32767;
+    if(acc < -32768)
+        return -32768;
+    return acc;
+}
+
+/*
+    The accumulator is 32 bits: sum(|coeffs|) * max|x| must stay under 2^31,
+    that's a sum of |coeffs| up to 16.0 with 12-bit samples. Low-pass
+    filters are close to 1.0.
+
+    The last taps - 1 samples are kept in front of the block, so
+    max_block is only how much is filtered per kernel call: longer blocks
+    are done in pieces.
+*/
+class FirFilter : public FilterStage{
+
+public:
+    FirFilter();
+    ~FirFilter();
+
+    //decim: keep 1 output of every decim
+    bool begin(const int16_t *coeffs_q15, uint16_t taps, uint16_t max_block, uint16_t decim = 1);
+    const char *name(){ return "fir"; }
+    uint32_t process(const int16_t *in, int16_t *out, uint32_t n);
+    void reset();
+    uint16_t decimation() const { return decim; }
+    uint16_t numTaps() const { return taps; }
+
+private:
+    int16_t *coef;                      //reversed, so each output is a dot product
+    int16_t *hist;                      //taps - 1 old samples, then the block
+    uint16_t taps, max_block, decim;
+    uint16_t phase;                     //input samples to skip before the next output
+};
+
+enum {BIQUAD_MAX_SECTIONS = 4, BIQUAD_Q = 14};
+
+/*
+    y = b0*x + b1*x1 + b2*x2 - a1*y1 - a2*y2, coefficients in Q14 (-2.0 to
+    2.0). Direct form I with a 64-bit accumulator, and the bits dropped when
+    rounding y go into the next sample (error feedback), so low cutoff
+    frequencies don't turn into noise.
+*/
+typedef struct{
+    int16_t b0, b1, b2, a1, a2;
+}BiquadCoeffs;
+
+class BiquadCascade : public FilterStage{
+
+public:
+    BiquadCascade();
+
+    bool begin(const BiquadCoeffs *sections, uint8_t count);
+    const char *name(){ return "biquad"; }
+    uint32_t process(const int16_t *in, int16_t *out, uint32_t n);
+    void reset();
+    uint8_t numSections() const { return count; }
+
+private:
+    //x(n-1), x(n-2), y(n-1), y(n-2) and the rounding error, per section
+    struct State{
+        int16_t x1, x2, y1, y2;
+        int32_t err;
+    };
+    BiquadCoeffs coef[BIQUAD_MAX_SECTIONS];
+    State state[BIQUAD_MAX_SECTIONS];
+    uint8_t count;
+};
+
+/*
+    CIC: gain R^N, undone at the output with one multiply per output sample.
+    The integrators wrap around on purpose: the combs undo it as long as
+    the output fits in 32 bits, that's N * log2(R) <= 16 for int16_t input.
+    The response droops towards the new Nyquist frequency, a short FIR
+    afterwards usually flattens it.
+*/
+template <uint8_t N>
+class CicDecimator : public FilterStage{
+
+    static_assert(N >= 1 && N <= 6, "CicDecimator: 1 to 6 stages");
+
+public:
+    CicDecimator() : r(1), norm(1u << 31) { reset(); }
+
+    bool begin(uint16_t ratio){
+        uint64_t gain = 1;
+        uint8_t bits = 0;
+        if(ratio < 2)
+            return false;
+        while((1u << bits) < ratio)
+            bits++;
+        if(N * bits > 16)
+            return false;
+        for(uint8_t s = 0; s < N; s++)
+            gain *= ratio;
+        r = ratio;
+        norm = ((1ull << 31) + gain / 2) / gain;
+        reset();
+        return true;
+    }
+
+    const char *name(){ return "cic"; }
+
+    uint32_t process(const int16_t *in, int16_t *out, uint32_t n){
+
+        uint32_t integ[N], produced = 0;
+        uint16_t c = cnt;
+
+        for(uint8_t s = 0; s < N; s++)
+            integ[s] = acc[s];
+
+        for(uint32_t i = 0; i < n; i++){
+            integ[0] += (uint32_t)(int32_t)in[i];
+            for(uint8_t s = 1; s < N; s++)
+                integ[s] += integ[s - 1];
+
+            if(++c == r){
+                c = 0;
+                uint32_t v = integ[N - 1];
+                for(uint8_t s = 0; s < N; s++){
+                    uint32_t prev = comb[s];
+                    comb[s] = v;
+                    v -= prev;
+                }
+                //v * 2^31 / R^N, then >> 31 with rounding (in two steps)
+                out[produced++] = filterSat((int32_t)(((int64_t)(int32_t)v * norm) >> 16), 15);
+            }
+        }
+
+        for(uint8_t s = 0; s < N; s++)
+            acc[s] = integ[s];
+        cnt = c;
+        return produced;
+    }
+
+    void reset(){
+        for(uint8_t s = 0; s < N; s++){
+            acc[s] = 0;
+            comb[s] = 0;
+        }
+        cnt = 0;
+    }
+
+    uint16_t decimation() const { return r; }
+
+private:
+    uint32_t acc[N];                    //integrators
+    uint32_t comb[N];                   //comb delays
+    uint16_t r, cnt;
+    uint32_t norm;                      //2^31 / R^N
+};
+
+//Stages run one after the other on the same buffer
+enum {FILTER_MAX_STAGES = 4};
+
+class FilterChain{
+
+public:
+    FilterChain() : count(0) {}
+
+    bool add(FilterStage &stage);
+    uint32_t run(int16_t *buf, uint32_t n);
+    void reset();
+    uint16_t decimation() const;
+
+private:
+    FilterStage *stages[FILTER_MAX_STAGES];
+    uint8_t count;
+};
+
+//Windowed-sinc (Hamming) low-pass in Q15, cutoff as a fraction of the
+//sample rate (0 to 0.5). DC gain 1.
+void firLowpass(int16_t *coeffs_q15, uint16_t taps, float cutoff);
+//RBJ cookbook low-pass section, q = 0.707 for Butterworth
+BiquadCoeffs biquadLowpass(float cutoff, float q);
+
+#endif
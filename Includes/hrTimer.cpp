@@ -0,0 +1,262 @@
+#include <Arduino.h>
+#include <hrTimer.h>
+
+//80 MHz / 80: the counter counts microseconds
+static const uint16_t timer_divider = 80;
+
+HrTimerService *HrTimerService::instance = NULL;
+
+HrTimerService::HrTimerService(){
+    hw = NULL;
+    head = NULL;
+    pend_head = pend_tail = NULL;
+    task = NULL;
+    irqs = 0;
+}
+
+//The interrupt is allocated on the core that calls begin()
+bool HrTimerService::begin(uint8_t hw_timer, UBaseType_t task_prio, BaseType_t core){
+
+    if(instance != NULL)
+        return instance == this;
+
+    hw = timerBegin(hw_timer, timer_divider, true);
+    if(hw == NULL)
+        return false;
+
+    if(xTaskCreatePinnedToCore(dispatchTask, "HrTimer", 4096, this, task_prio, &task, core) != pdPASS){
+        timerEnd(hw);
+        hw = NULL;
+        return false;
+    }
+
+    instance = this;
+    timerAttachInterrupt(hw, &onAlarm, true);
+    return true;
+}
+
+void HrTimerService::init(HrTimer *t, HrTimerCallback callback, void *arg, HrDispatch dispatch){
+    t->next = t->pend_next = NULL;
+    t->expires = t->due = 0;
+    t->period = 0;
+    t->callback = callback;
+    t->arg = arg;
+    t->dispatch = dispatch;
+    t->active = false;
+    t->pending = false;
+    resetStats(t);
+}
+
+void HrTimerService::resetStats(HrTimer *t){
+    t->fired = 0;
+    t->overruns = 0;
+    t->late_max = 0;
+    t->late_sum = 0;
+}
+
+uint64_t HrTimerService::now(){
+    return timerRead(hw);
+}
+
+//************************************************************
+//Lists (call with the lock taken)
+
+void HrTimerService::insert(HrTimer *t){
+    //After the ones with the same expiry, so they fire in start order
+    HrTimer **p = &head;
+    while(*p != NULL && (*p)->expires <= t->expires)
+        p = &(*p)->next;
+    t->next = *p;
+    *p = t;
+}
+
+void HrTimerService::unlink(HrTimer *t){
+    for(HrTimer **p = &head; *p != NULL; p = &(*p)->next)
+        if(*p == t){
+            *p = t->next;
+            return;
+        }
+}
+
+void HrTimerService::unpend(HrTimer *t){
+
+    if(!t->pending)
+        return;
+
+    HrTimer *prev = NULL;
+    for(HrTimer *p = pend_head; p != NULL; prev = p, p = p->pend_next)
+        if(p == t){
+            if(prev == NULL)
+                pend_head = t->pend_next;
+            else
+                prev->pend_next = t->pend_next;
+            if(pend_tail == t)
+                pend_tail = prev;
+            break;
+        }
+    t->pending = false;
+}
+
+//Alarm for the first timer. Never in the past: the ESP32 alarm only
+//triggers when the counter reaches it.
+void IRAM_ATTR HrTimerService::program(){
+
+    if(head == NULL){
+        timerAlarmDisable(hw);
+        return;
+    }
+
+    uint64_t at = head->expires;
+    uint64_t soon = timerRead(hw) + MIN_DELTA_US;
+    if(at < soon)
+        at = soon;
+    timerAlarmWrite(hw, at, false);
+    timerAlarmEnable(hw);
+}
+
+void IRAM_ATTR HrTimerService::record(HrTimer *t, uint64_t due, uint64_t now){
+    uint32_t late = now > due ? now - due : 0;
+    t->fired++;
+    t->late_sum += late;
+    if(late > t->late_max)
+        t->late_max = late;
+}
+
+//************************************************************
+//Timers
+
+void HrTimerService::start(HrTimer *t, uint64_t expires, uint32_t period){
+
+    portENTER_CRITICAL_SAFE(&lock);
+    if(t->active)
+        unlink(t);
+    //An expiry the task didn't handle yet belongs to the old start
+    unpend(t);
+    t->expires = expires;
+    t->period = period;
+    t->active = true;
+    insert(t);
+    if(head == t)
+        program();
+    portEXIT_CRITICAL_SAFE(&lock);
+}
+
+void HrTimerService::startOnce(HrTimer *t, uint32_t delay_us){
+    start(t, now() + delay_us, 0);
+}
+
+void HrTimerService::startPeriodic(HrTimer *t, uint32_t period_us){
+    if(period_us < MIN_PERIOD_US)
+        period_us = MIN_PERIOD_US;
+    start(t, now() + period_us, period_us);
+}
+
+//The alarm is left as is: at worst it triggers with nothing to do
+void HrTimerService::stop(HrTimer *t){
+    portENTER_CRITICAL_SAFE(&lock);
+    if(t->active){
+        unlink(t);
+        t->active = false;
+    }
+    unpend(t);
+    portEXIT_CRITICAL_SAFE(&lock);
+}
+
+//************************************************************
+//Interrupt and dispatch task
+
+void IRAM_ATTR HrTimerService::onAlarm(){
+    instance->expire();
+}
+
+void IRAM_ATTR HrTimerService::expire(){
+
+    bool wake = false;
+
+    irqs++;
+    portENTER_CRITICAL_ISR(&lock);
+
+    uint64_t now = timerRead(hw);
+    while(head != NULL && head->expires <= now + MIN_DELTA_US){
+
+        HrTimer *t = head;
+        //Due in a few us: cheaper to wait here than to take another interrupt
+        while(now < t->expires)
+            now = timerRead(hw);
+
+        head = t->next;
+        uint64_t due = t->expires;
+        if(t->period){
+            //From the expected time, so it doesn't drift. Periods already
+            //gone (slow callbacks) are skipped.
+            t->expires += t->period;
+            while(t->expires <= now){
+                t->expires += t->period;
+                t->overruns++;
+            }
+            insert(t);
+        }
+        else
+            t->active = false;
+
+        if(t->dispatch == HR_IN_ISR){
+            t->due = due;
+            record(t, due, now);
+            portEXIT_CRITICAL_ISR(&lock);
+            t->callback(t);
+            portENTER_CRITICAL_ISR(&lock);
+            now = timerRead(hw);
+        }
+        else if(t->pending)
+            t->overruns++;          //the task is still behind with the last one
+        else{
+            t->due = due;
+            t->pending = true;
+            t->pend_next = NULL;
+            if(pend_tail != NULL)
+                pend_tail->pend_next = t;
+            else
+                pend_head = t;
+            pend_tail = t;
+            wake = true;
+        }
+    }
+
+    program();
+    portEXIT_CRITICAL_ISR(&lock);
+
+    if(wake){
+        BaseType_t task_woken = pdFALSE;
+        vTaskNotifyGiveFromISR(task, &task_woken);
+        if(task_woken)
+            portYIELD_FROM_ISR();
+    }
+}
+
+void HrTimerService::dispatchTask(void *parameters){
+    ((HrTimerService*)parameters)->runTask();
+}
+
+void HrTimerService::runTask(){
+
+    while(1){
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        while(1){
+            portENTER_CRITICAL(&lock);
+            HrTimer *t = pend_head;
+            if(t == NULL){
+                portEXIT_CRITICAL(&lock);
+                break;
+            }
+            pend_head = t->pend_next;
+            if(pend_head == NULL)
+                pend_tail = NULL;
+            t->pending = false;
+            record(t, t->due, timerRead(hw));
+            portEXIT_CRITICAL(&lock);
+
+            t->callback(t);
+        }
+    }
+}
@@ -0,0 +1,112 @@
+#ifndef HRTIMER_H_
+#define HRTIMER_H_
+
+#include <Arduino.h>
+
+/*
+    Microsecond timers multiplexed on one hardware timer
+
+    Software timers (SeventhTest_SWTimers.cpp) count in ticks, so nothing
+    finer than 1 ms. The HW interrupt lessons use a hardware timer instead,
+    but there are only 4 of them, and each one gives a single fixed period.
+
+    HrTimerService takes one hardware timer, lets its counter run at 1 MHz
+    (divider 80, like EigthTest_HWInterrupts_3.cpp) and never resets it, so
+    it's also the clock. The active timers are kept sorted by expiry time
+    and the alarm is always set to the first one: one interrupt per expiry,
+    none while nothing is due.
+
+    Each timer says where its callback runs:
+        HR_IN_ISR   in the timer interrupt itself. Best accuracy, but the
+                    callback has the ISR rules: short, FromISR calls only.
+        HR_IN_TASK  in the service's dispatch task (high priority), woken by
+                    a notification. A few us later, but it can do anything a
+                    task can.
+
+        void blink(HrTimer *timer){ ... }
+        static HrTimerService hr;
+        static HrTimer t;
+        hr.begin();
+        hr.init(&t, blink, NULL, HR_IN_TASK);
+        hr.startPeriodic(&t, 250);              //every 250 us
+
+    Every timer also records how late its callbacks ran (fired, late_max,
+    late_sum), to measure accuracy.
+
+    Only one service can exist (the HAL interrupt has no argument). Keep the
+    number of active timers small: starting one walks the sorted list.
+*/
+
+struct HrTimer;
+typedef void (*HrTimerCallback)(HrTimer *timer);
+
+enum HrDispatch{
+    HR_IN_ISR,
+    HR_IN_TASK
+};
+
+//Use HrTimerService::init() to fill it
+struct HrTimer{
+    HrTimer *next;                      //active list, sorted by expiry
+    HrTimer *pend_next;                 //waiting for the dispatch task
+    uint64_t expires;                   //us, on the service clock
+    uint64_t due;                       //expiry being dispatched, for the callback
+    uint32_t period;                    //us, 0 for one-shot
+    HrTimerCallback callback;
+    void *arg;
+    HrDispatch dispatch;
+    bool active;
+    bool pending;
+
+    //Accuracy, in us
+    uint32_t fired;
+    uint32_t overruns;                  //expiries skipped because the last one was still running
+    uint32_t late_max;
+    uint64_t late_sum;
+};
+
+class HrTimerService{
+
+public:
+    enum {MIN_DELTA_US = 5,             //an alarm closer than this is handled right away
+          MIN_PERIOD_US = 20};          //so a periodic timer can't keep the ISR busy
+
+    HrTimerService();
+
+    bool begin(uint8_t hw_timer = 0, UBaseType_t task_prio = configMAX_PRIORITIES - 1,
+               BaseType_t core = tskNO_AFFINITY);
+
+    void init(HrTimer *timer, HrTimerCallback callback, void *arg, HrDispatch dispatch);
+
+    //From tasks, ISRs or callbacks. Starting an active timer restarts it.
+    void startOnce(HrTimer *timer, uint32_t delay_us);
+    void startPeriodic(HrTimer *timer, uint32_t period_us);
+    void stop(HrTimer *timer);
+
+    uint64_t now();                     //us since begin()
+    static void resetStats(HrTimer *timer);
+    uint32_t interrupts() const { return irqs; }
+
+private:
+    static void IRAM_ATTR onAlarm();
+    static void dispatchTask(void *parameters);
+    void IRAM_ATTR expire();
+    void runTask();
+    void start(HrTimer *t, uint64_t expires, uint32_t period);
+    void insert(HrTimer *t);
+    void unlink(HrTimer *t);
+    void unpend(HrTimer *t);
+    void IRAM_ATTR record(HrTimer *t, uint64_t due, uint64_t now);
+    void IRAM_ATTR program();
+
+    static HrTimerService *instance;
+
+    hw_timer_t *hw;
+    HrTimer *head;                      //next to expire
+    HrTimer *pend_head, *pend_tail;     //for the dispatch task, in expiry order
+    TaskHandle_t task;
+    volatile uint32_t irqs;
+    portMUX_TYPE lock = portMUX_INITIALIZER_UNLOCKED;
+};
+
+#endif
@@ -0,0 +1,141 @@
+#include <Arduino.h>
+#include <hybridMutex.h>
+
+//Max waiters that can be woken ahead of time, only limits the semaphore count
+static const UBaseType_t max_wakeups = 32;
+
+HybridMutex::HybridMutex(){
+    state = 0;
+    owner = NULL;
+    owner_core = -1;
+    owner_base = 0;
+    spin_limit = 0;
+    wake = NULL;
+    boosted = false;
+    boost_prio = 0;
+    boosting = 0;
+    fast = spun = blocked = 0;
+}
+
+HybridMutex::~HybridMutex(){
+    if(wake != NULL)
+        vSemaphoreDelete(wake);
+}
+
+bool HybridMutex::begin(uint32_t spin_limit){
+    this->spin_limit = spin_limit;
+    wake = xSemaphoreCreateCounting(max_wakeups, 0);
+    return wake != NULL;
+}
+
+void HybridMutex::acquired(TaskHandle_t me){
+    owner_base = uxTaskPriorityGet(NULL);
+    owner_core = xPortGetCoreID();
+    owner = me;
+}
+
+bool HybridMutex::tryLock(){
+
+    uint32_t c = 0;
+
+    if(!state.compare_exchange_strong(c, 1, std::memory_order_acquire))
+        return false;
+
+    acquired(xTaskGetCurrentTaskHandle());
+    fast++;
+    return true;
+}
+
+void HybridMutex::lock(){
+
+    TaskHandle_t me = xTaskGetCurrentTaskHandle();
+    uint32_t c = 0;
+
+    //1. Fast path
+    if(state.compare_exchange_strong(c, 1, std::memory_order_acquire)){
+        acquired(me);
+        fast++;
+        return;
+    }
+
+    //2. Spin only while the holder runs on the other core
+    for(uint32_t i = 0; i < spin_limit; i++){
+        int8_t core = owner_core.load(std::memory_order_relaxed);
+        if(core == xPortGetCoreID())
+            break;
+        c = 0;
+        if(state.load(std::memory_order_relaxed) == 0 &&
+           state.compare_exchange_weak(c, 1, std::memory_order_acquire)){
+            acquired(me);
+            spun++;
+            return;
+        }
+    }
+
+    //3. Block. Setting the word to 2 tells unlock() that it must wake someone
+    c = state.exchange(2, std::memory_order_acquire);
+    while(c != 0){
+        boostOwner(me);
+        xSemaphoreTake(wake, portMAX_DELAY);
+        c = state.exchange(2, std::memory_order_acquire);
+    }
+    acquired(me);
+    blocked++;
+}
+
+//Raise the owner to our priority. Only done while the word is 2, because
+//then the owner is sure to go through the slow unlock and undo it.
+void HybridMutex::boostOwner(TaskHandle_t me){
+
+    UBaseType_t my_prio = uxTaskPriorityGet(NULL);
+    TaskHandle_t o = owner.load(std::memory_order_acquire);
+    bool apply = false;
+
+    if(o == NULL || o == me)
+        return;
+
+    portENTER_CRITICAL(&pi_lock);
+    if(owner.load(std::memory_order_relaxed) == o && state.load(std::memory_order_relaxed) == 2 &&
+       my_prio > owner_base && my_prio > boost_prio){
+        boosted = true;
+        boost_prio = my_prio;
+        boosting++;
+        apply = true;
+    }
+    portEXIT_CRITICAL(&pi_lock);
+
+    //vTaskPrioritySet can yield, so it can't go inside the critical section.
+    //"boosting" makes the owner wait for us before it restores its priority.
+    if(apply){
+        vTaskPrioritySet(o, my_prio);
+        boosting--;
+    }
+}
+
+void HybridMutex::unlock(){
+
+    UBaseType_t base = owner_base;
+    bool was_boosted;
+
+    owner = NULL;
+    owner_core = -1;
+
+    //Word was 1: nobody is waiting, that's all
+    if(state.fetch_sub(1, std::memory_order_release) == 1)
+        return;
+
+    portENTER_CRITICAL(&pi_lock);
+    was_boosted = boosted;
+    boosted = false;
+    boost_prio = 0;
+    portEXIT_CRITICAL(&pi_lock);
+
+    if(was_boosted){
+        while(boosting.load(std::memory_order_acquire) != 0)
+            taskYIELD();
+        vTaskPrioritySet(NULL, base);
+    }
+
+    state.store(0, std::memory_order_release);
+    xSemaphoreGive(wake);
+}
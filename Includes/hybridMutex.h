@@ -0,0 +1,72 @@
+#ifndef HYBRIDMUTEX_H_
+#define HYBRIDMUTEX_H_
+
+#include <Arduino.h>
+#include <atomic>
+
+/*
+    Hybrid mutex: atomic fast path, bounded spin, then block
+
+    A FreeRTOS mutex always costs a kernel call, even when nobody else wants
+    it. A portMUX spinlock is cheap, but it disables interrupts and makes the
+    other core spin for as long as the lock is held (200 ms in
+    EleventhTest_Multicore_criticalSection.cpp!).
+
+    HybridMutex tries, in order:
+        1. One compare-and-swap. If the lock is free, that's it: no kernel.
+        2. If the holder is running on the OTHER core, spin a little: it will
+           probably release the lock soon. Spinning for a holder on our own
+           core is pointless, it can't run while we spin.
+        3. Block on a semaphore, like a normal mutex. Before blocking, the
+           holder's priority is raised to ours (priority inheritance), and it
+           goes back to its own priority when it unlocks.
+
+    The lock word follows Drepper's "futexes are tricky" mutex:
+        0 = free, 1 = locked, 2 = locked and someone may be waiting
+    so unlock only needs the kernel when the word was 2.
+
+    Only for tasks (not ISRs). Not recursive. Inheritance is best effort when
+    several waiters of different priorities arrive at the same time, and a
+    task should not hold two boosted HybridMutex at once.
+*/
+
+class HybridMutex{
+
+public:
+    HybridMutex();
+    ~HybridMutex();
+
+    bool begin(uint32_t spin_limit = 1000);
+
+    void lock();
+    bool tryLock();
+    void unlock();
+
+    //Statistics: how each lock() was finally obtained
+    uint32_t fastCount() const { return fast; }
+    uint32_t spinCount() const { return spun; }
+    uint32_t blockCount() const { return blocked; }
+    void resetStats(){ fast = spun = blocked = 0; }
+
+private:
+    void acquired(TaskHandle_t me);
+    void boostOwner(TaskHandle_t me);
+
+    std::atomic<uint32_t> state;
+    std::atomic<TaskHandle_t> owner;
+    std::atomic<int8_t> owner_core;         //-1 when free
+    UBaseType_t owner_base;                 //owner's priority before any boost
+
+    uint32_t spin_limit;
+    SemaphoreHandle_t wake;                 //waiters block here
+
+    //Protects the boost bookkeeping between waiters and the owner
+    portMUX_TYPE pi_lock = portMUX_INITIALIZER_UNLOCKED;
+    bool boosted;
+    UBaseType_t boost_prio;
+    std::atomic<uint8_t> boosting;          //waiters between deciding and applying a boost
+
+    std::atomic<uint32_t> fast, spun, blocked;
+};
+
+#endif
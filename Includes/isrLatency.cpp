@@ -0,0 +1,179 @@
+#include <Arduino.h>
+#include <isrLatency.h>
+
+#if ISRLAT_ENABLE
+
+#include <esp_ipc.h>
+#include <esp_timer.h>
+
+typedef struct{
+    const char *name;
+    uint32_t events;                //resumes measured
+    uint32_t cross_core;            //of those, ISR and task on different cores
+    uint64_t total[ISRLAT_PHASES];  //cycles
+    uint32_t max[ISRLAT_PHASES];
+    uint32_t hist[ISRLAT_PHASES][ISRLAT_BUCKETS];
+}isrLatStats;
+
+isrLatStamps isrlat_stamps[ISRLAT_MAX_SOURCES];
+uint32_t isrlat_offset[portNUM_PROCESSORS];
+
+static isrLatStats stats[ISRLAT_MAX_SOURCES];
+static portMUX_TYPE lat_lock = portMUX_INITIALIZER_UNLOCKED;
+static const char *phase_names[ISRLAT_PHASES] = {"isr", "wake", "total"};
+
+//************************************************************
+//Functions
+
+//Bucket i holds times in [2^(i-1), 2^i) cycles, bucket 0 is 0
+static uint8_t bucket(uint32_t cycles){
+    uint8_t b = cycles ? 32 - __builtin_clz(cycles) : 0;
+    return b < ISRLAT_BUCKETS ? b : ISRLAT_BUCKETS - 1;
+}
+
+//Runs on each core through esp_ipc: the cycle count at the moment
+//esp_timer ticks to a new microsecond gives that core's offset
+static void calibrate(void *arg){
+
+    uint32_t mhz = *(uint32_t*)arg;
+    int64_t t0, t;
+    uint32_t c;
+
+    portDISABLE_INTERRUPTS();
+    t0 = esp_timer_get_time();
+    while((t = esp_timer_get_time()) == t0);
+    c = ESP.getCycleCount();
+    portENABLE_INTERRUPTS();
+
+    isrlat_offset[xPortGetCoreID()] = c - (uint32_t)(t * mhz);
+}
+
+//Upper bound of the bucket where p% of the samples is reached, in cycles
+static uint32_t percentile(const uint32_t *hist, uint32_t events, uint8_t p){
+
+    uint32_t target = ((uint64_t)events * p + 99) / 100, seen = 0;
+
+    for(uint8_t b = 0; b < ISRLAT_BUCKETS; b++){
+        seen += hist[b];
+        if(seen >= target && seen > 0)
+            return b ? 1u << b : 0;
+    }
+    return 0;
+}
+
+//************************************************************
+//API
+
+void isrLatBegin(){
+
+    uint32_t mhz = getCpuFrequencyMhz();
+
+    for(uint8_t core = 0; core < portNUM_PROCESSORS; core++)
+        esp_ipc_call_blocking(core, calibrate, &mhz);
+    isrLatReset();
+}
+
+void isrLatResume(uint8_t src){
+
+    uint32_t now = isrLatNow();
+    uint8_t core = xPortGetCoreID();
+    uint32_t seq, entry, give, t[ISRLAT_PHASES];
+    uint8_t isr_core;
+
+    if(src >= ISRLAT_MAX_SOURCES)
+        return;
+    isrLatStamps *s = &isrlat_stamps[src];
+
+    //Again if the ISR (on the other core, or preempting us) stamped a
+    //give while we were reading
+    do{
+        seq = s->seq;
+        entry = s->given_entry;
+        give = s->give;
+        isr_core = s->core;
+    }while((seq & 1) || seq != s->seq);
+
+    //Nothing given since the last resume
+    if(seq == s->resumed)
+        return;
+    s->resumed = seq;
+
+    t[ISRLAT_ISR] = give - entry;
+    t[ISRLAT_WAKE] = now - give;
+    t[ISRLAT_TOTAL] = now - entry;
+
+    portENTER_CRITICAL(&lat_lock);
+    isrLatStats *st = &stats[src];
+    st->events++;
+    if(isr_core != core)
+        st->cross_core++;
+    for(uint8_t p = 0; p < ISRLAT_PHASES; p++){
+        st->total[p] += t[p];
+        if(t[p] > st->max[p])
+            st->max[p] = t[p];
+        st->hist[p][bucket(t[p])]++;
+    }
+    portEXIT_CRITICAL(&lat_lock);
+}
+
+void isrLatName(uint8_t src, const char *name){
+    if(src < ISRLAT_MAX_SOURCES)
+        stats[src].name = name;
+}
+
+//The names stay
+void isrLatReset(){
+
+    portENTER_CRITICAL(&lat_lock);
+    for(uint8_t i = 0; i < ISRLAT_MAX_SOURCES; i++){
+        const char *name = stats[i].name;
+        memset(&stats[i], 0, sizeof(stats[i]));
+        stats[i].name = name;
+        isrlat_stamps[i].overruns = 0;
+        isrlat_stamps[i].resumed = isrlat_stamps[i].seq & ~1u;
+    }
+    portEXIT_CRITICAL(&lat_lock);
+}
+
+//One line per source and phase, in us, then the histograms in cycles.
+//Works on a copy so that printing doesn't hold the lock.
+void isrLatReport(){
+
+    static isrLatStats st[ISRLAT_MAX_SOURCES];
+    float mhz = getCpuFrequencyMhz();
+
+    portENTER_CRITICAL(&lat_lock);
+    memcpy(st, stats, sizeof(stats));
+    portEXIT_CRITICAL(&lat_lock);
+
+    Serial.println("source,phase,events,overruns,cross_core,avg_us,p50_us,p99_us,max_us");
+
+    for(uint8_t i = 0; i < ISRLAT_MAX_SOURCES; i++){
+        isrLatStats &s = st[i];
+        if(s.events == 0)
+            continue;
+
+        for(uint8_t p = 0; p < ISRLAT_PHASES; p++){
+            if(s.name != NULL)
+                Serial.print(s.name);
+            else
+                Serial.printf("src%u", i);
+            Serial.printf(",%s,%lu,%lu,%lu,%.2f,%.2f,%.2f,%.2f\n", phase_names[p], (unsigned long)s.events,
+                            (unsigned long)isrlat_stamps[i].overruns, (unsigned long)s.cross_core,
+                            s.total[p] / mhz / s.events,
+                            percentile(s.hist[p], s.events, 50) / mhz,
+                            percentile(s.hist[p], s.events, 99) / mhz,
+                            s.max[p] / mhz);
+        }
+
+        //Histograms: count per bucket, bucket i is < 2^i cycles
+        for(uint8_t p = 0; p < ISRLAT_PHASES; p++){
+            Serial.printf("  %s_hist", phase_names[p]);
+            for(uint8_t b = 0; b < ISRLAT_BUCKETS; b++)
+                Serial.printf(",%lu", (unsigned long)s.hist[p][b]);
+            Serial.println();
+        }
+    }
+}
+
+#endif
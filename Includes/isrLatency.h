@@ -0,0 +1,122 @@
+#ifndef ISRLATENCY_H_
+#define ISRLATENCY_H_
+
+#include <Arduino.h>
+
+/*
+    Interrupt -> task latency profiler
+
+    EigthTest_HWInterrupts_3.cpp defers the ISR's work to printValues with
+    xSemaphoreGiveFromISR + portYIELD_FROM_ISR, but nothing tells how long
+    that hand-off takes. This stamps three points with the CPU cycle counter:
+
+        void IRAM_ATTR ontimer(){
+            ISRLAT_ENTRY(0);                        //first thing in the ISR
+            ...
+            ISRLAT_GIVE(0);                         //right before the give
+            xSemaphoreGiveFromISR(bin_sem, &task_woken);
+            ...
+        }
+
+        xSemaphoreTake(bin_sem, portMAX_DELAY);
+        ISRLAT_RESUME(0);                           //right after the take
+
+    and for each ISR source (0 to ISRLAT_MAX_SOURCES - 1) keeps, in fixed
+    memory, the count, average, max and a histogram (power of 2 buckets in
+    cycles) of:
+        isr     entry -> give: the ISR's own work
+        wake    give -> resume: scheduler, context switch, higher priority
+                tasks in the way. This is the one priorities and affinity move.
+        total   entry -> resume
+    plus overruns: gives the task hadn't resumed from yet when the next one
+    came (the task only sees the last one, like a binary semaphore).
+
+    An ISR that doesn't give every time (the challenges give every 10
+    samples) calls ISRLAT_ENTRY anyway: only the entry before a give counts.
+
+    The cycle counter belongs to each core and they don't start together.
+    ISRLAT_BEGIN() lines them up against esp_timer (well under 1 us), so the
+    ISR and the task can run on different cores. Call it once, in setup().
+
+    It is OFF by default, like Includes/lockProf.h. Turn it on in
+    platformio.ini:
+        build_flags = -DISRLAT_ENABLE=1
+    When it's off the macros are empty.
+*/
+
+#ifndef ISRLAT_ENABLE
+#define ISRLAT_ENABLE 0
+#endif
+
+enum {ISRLAT_MAX_SOURCES = 8, ISRLAT_BUCKETS = 24};
+enum {ISRLAT_ISR, ISRLAT_WAKE, ISRLAT_TOTAL, ISRLAT_PHASES};
+
+#if ISRLAT_ENABLE
+
+//Written by the ISR. seq is odd while a give is being stamped.
+typedef struct{
+    volatile uint32_t entry;            //last entry, given or not
+    volatile uint32_t seq;
+    volatile uint32_t given_entry, give;
+    volatile uint8_t core;              //core that ran the ISR
+    volatile uint32_t resumed;          //seq of the last give the task resumed from
+    volatile uint32_t overruns;
+}isrLatStamps;
+
+extern isrLatStamps isrlat_stamps[ISRLAT_MAX_SOURCES];
+extern uint32_t isrlat_offset[portNUM_PROCESSORS];
+
+//Cycle count on a time base shared by both cores
+static inline uint32_t IRAM_ATTR isrLatNow(){
+    return ESP.getCycleCount() - isrlat_offset[xPortGetCoreID()];
+}
+
+static inline void IRAM_ATTR isrLatEntry(uint8_t src){
+    if(src >= ISRLAT_MAX_SOURCES)
+        return;
+    isrlat_stamps[src].entry = isrLatNow();
+}
+
+static inline void IRAM_ATTR isrLatGive(uint8_t src){
+
+    if(src >= ISRLAT_MAX_SOURCES)
+        return;
+    uint32_t now = isrLatNow();
+    isrLatStamps *s = &isrlat_stamps[src];
+
+    if(s->seq != s->resumed)
+        s->overruns++;
+    s->seq++;
+    s->given_entry = s->entry;
+    s->give = now;
+    s->core = xPortGetCoreID();
+    s->seq++;
+}
+
+void isrLatBegin();
+void isrLatResume(uint8_t src);
+void isrLatName(uint8_t src, const char *name);
+void isrLatReport();
+void isrLatReset();
+
+#define ISRLAT_BEGIN()          isrLatBegin()
+#define ISRLAT_ENTRY(src)       isrLatEntry(src)
+#define ISRLAT_GIVE(src)        isrLatGive(src)
+#define ISRLAT_RESUME(src)      isrLatResume(src)
+#define ISRLAT_NAME(src, name)  isrLatName((src), (name))
+#define ISRLAT_REPORT()         isrLatReport()
+#define ISRLAT_RESET()          isrLatReset()
+
+#else
+
+#define ISRLAT_BEGIN()          ((void)0)
+#define ISRLAT_ENTRY(src)       ((void)0)
+#define ISRLAT_GIVE(src)        ((void)0)
+#define ISRLAT_RESUME(src)      ((void)0)
+#define ISRLAT_NAME(src, name)  ((void)0)
+#define ISRLAT_REPORT()         ((void)0)
+#define ISRLAT_RESET()          ((void)0)
+
+#endif
+
+#endif
@@ -0,0 +1,83 @@
+#include <Arduino.h>
+#include <lazyTimer.h>
+
+LazyTimer::LazyTimer(){
+    timer = NULL;
+    timeout = 0;
+    callback = NULL;
+    id = NULL;
+    deadline = 0;
+    armed = false;
+    cancelled = false;
+    sent = 0;
+    failed = 0;
+}
+
+LazyTimer::~LazyTimer(){
+    if(timer != NULL)
+        xTimerDelete(timer, portMAX_DELAY);
+}
+
+bool LazyTimer::begin(const char *name, TickType_t timeout, LazyTimerCallback callback, void *id){
+    this->timeout = timeout ? timeout : 1;
+    this->callback = callback;
+    this->id = id;
+    //Auto-reload and always running: if a re-arm is lost, it still comes back
+    if(timer == NULL){
+        timer = xTimerCreate(name, this->timeout, pdTRUE, this, expired);
+        if(timer != NULL && xTimerStart(timer, portMAX_DELAY) != pdPASS){
+            xTimerDelete(timer, portMAX_DELAY);
+            timer = NULL;
+        }
+    }
+    return timer != NULL;
+}
+
+//The timer expires within a timeout (its longest period), sees the new
+//deadline and re-arms for it
+void LazyTimer::kick(){
+    cancelled = false;
+    deadline = xTaskGetTickCount() + timeout;
+    armed = true;
+}
+
+void LazyTimer::kickFromISR(){
+    cancelled = false;
+    deadline = xTaskGetTickCountFromISR() + timeout;
+    armed = true;
+}
+
+void LazyTimer::expired(TimerHandle_t timer){
+    ((LazyTimer*)pvTimerGetTimerID(timer))->check();
+}
+
+//Runs in the daemon when the FreeRTOS timer expires
+void LazyTimer::check(){
+
+    TickType_t now = xTaskGetTickCount();
+    int32_t left = (int32_t)(deadline - now);
+
+    if(armed && left <= 0){
+        armed = false;
+        //A kick between the load and the store above wrote its deadline
+        //first: look at it again
+        left = (int32_t)(deadline - now);
+        if(left <= 0){
+            if(!cancelled)
+                callback(this);
+        }
+        else
+            armed = true;
+    }
+
+    //Next look: at the deadline, or in a timeout if nothing is pending
+    TickType_t period = armed && left > 0 ? left : timeout;
+    if(period == xTimerGetPeriod(timer))
+        return;
+
+    //Never block in the daemon. If its queue is full the timer reloads
+    //with the period it has, and we come back here to try again.
+    sent++;
+    if(xTimerChangePeriod(timer, period, 0) != pdPASS)
+        failed++;
+}
@@ -0,0 +1,78 @@
+#ifndef LAZYTIMER_H_
+#define LAZYTIMER_H_
+
+#include <Arduino.h>
+#include <atomic>
+
+/*
+    Inactivity timer with a command-free reset
+
+    SeventhTest_SWTimer_Challenge.cpp turns the LED off after 5 s without
+    input, calling xTimerReset() for every character. Every reset is a
+    command in the timer daemon's queue, and when the queue is full (10
+    commands on the ESP32) the echo task blocks until the daemon catches up.
+
+    LazyTimer keeps a real FreeRTOS timer, but kick() only writes the new
+    deadline (now + timeout) in an atomic variable and never sends a
+    command. When the timer expires, its callback looks at the deadline: if
+    it has moved, the timer is re-armed for the time left, otherwise the
+    inactivity really happened and the user callback runs. So a stream of
+    kicks costs one daemon command per timeout, not one per kick.
+
+    The timer is auto-reload and keeps running from begin() on, with the
+    timeout as period while nothing is pending (one daemon wake-up per
+    timeout). That is also the backstop: the callback never blocks, and if
+    the daemon's queue is full when it re-arms, the timer comes back with
+    the period it had and tries again, instead of losing the deadline.
+
+        void ledOff(LazyTimer *timer){ digitalWrite(pin, LOW); }
+        static LazyTimer inactivity;
+        inactivity.begin("Inactivity", 5000 / portTICK_PERIOD_MS, ledOff);
+        inactivity.kick();                      //for every character
+
+    The user callback runs in the timer daemon, like any timer callback.
+*/
+
+class LazyTimer;
+typedef void (*LazyTimerCallback)(LazyTimer *timer);
+
+class LazyTimer{
+
+public:
+    LazyTimer();
+    ~LazyTimer();
+
+    bool begin(const char *name, TickType_t timeout, LazyTimerCallback callback, void *id = NULL);
+
+    //Restarts the countdown. No command, so it never blocks.
+    void kick();
+    void kickFromISR();
+
+    //No command either: the callback is skipped when the timer expires
+    void stop(){ cancelled = true; }
+
+    bool isActive() const { return armed && !cancelled; }
+    void *getID() const { return id; }
+    TickType_t getTimeout() const { return timeout; }
+
+    //Daemon commands sent (re-arms), to compare with a kick count, and how
+    //many of them didn't fit in the daemon's queue and were tried again
+    uint32_t commands() const { return sent; }
+    uint32_t retries() const { return failed; }
+
+private:
+    static void expired(TimerHandle_t timer);
+    void check();
+
+    TimerHandle_t timer;
+    TickType_t timeout;
+    LazyTimerCallback callback;
+    void *id;
+
+    std::atomic<TickType_t> deadline;
+    std::atomic<bool> armed;                //a deadline is pending
+    std::atomic<bool> cancelled;
+    std::atomic<uint32_t> sent, failed;
+};
+
+#endif
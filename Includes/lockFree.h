@@ -0,0 +1,131 @@
+#ifndef LOCKFREE_H_
+#define LOCKFREE_H_
+
+#include <Arduino.h>
+#include <atomic>
+#include <type_traits>
+
+/*
+    Small lock-free primitives for shared state
+
+    FifthTest_Mutex.cpp takes a whole mutex to do shared_var++, and the HW
+    interrupt challenges take avgMutex to read one float. For state this small
+    the ESP32 can do it without the kernel: the Xtensa cores have an atomic
+    compare-and-swap instruction (S32C1I) that works across both cores and
+    inside ISRs, and std::atomic uses it for 8, 16 and 32 bit values.
+
+        - AtomicCounter: increment/add/read a 32 bit counter
+        - fetchAdd / compareAndSwap: the raw operations for any std::atomic
+        - SeqLock<T>: a consistent snapshot of a struct that is bigger than
+          one word, like (avg, sample count, timestamp)
+
+    NOTE: 64 bit values are NOT lock-free on the ESP32 (the compiler falls back
+    to a lock), use SeqLock for them.
+*/
+
+//Atomic building blocks, usable from tasks on any core and from ISRs
+
+template <typename T>
+inline T fetchAdd(std::atomic<T> &var, T delta){
+    return var.fetch_add(delta, std::memory_order_acq_rel);
+}
+
+//If var still holds expected, store desired and return true.
+//Otherwise return false and leave the current value in expected.
+template <typename T>
+inline bool compareAndSwap(std::atomic<T> &var, T &expected, T desired){
+    return var.compare_exchange_strong(expected, desired, std::memory_order_acq_rel, std::memory_order_acquire);
+}
+
+//Applies fn to the value with a CAS loop, for updates fetch_add can't do (max, saturate...)
+template <typename T, typename Fn>
+inline T atomicUpdate(std::atomic<T> &var, Fn fn){
+    T old = var.load(std::memory_order_relaxed);
+    while(!var.compare_exchange_weak(old, fn(old), std::memory_order_acq_rel, std::memory_order_relaxed));
+    return old;
+}
+
+class AtomicCounter{
+
+public:
+    AtomicCounter(uint32_t start = 0) : value(start) {}
+
+    uint32_t increment(){ return value.fetch_add(1, std::memory_order_relaxed) + 1; }
+    uint32_t add(uint32_t n){ return value.fetch_add(n, std::memory_order_relaxed) + n; }
+    uint32_t get() const { return value.load(std::memory_order_relaxed); }
+    void set(uint32_t n){ value.store(n, std::memory_order_relaxed); }
+
+private:
+    std::atomic<uint32_t> value;
+};
+
+/*
+    SeqLock<T>: the writer bumps a sequence number to odd, writes, and bumps it
+    back to even. Readers never block: they copy the data and check that the
+    sequence didn't change (and wasn't odd) while they were copying, and
+    retry if it did.
+
+    The writer holds a spinlock while writing. That keeps several writers from
+    mixing their data, and also stops a higher priority reader on the same
+    core from spinning forever on a writer it preempted. Writes must be short.
+*/
+
+template <typename T>
+class SeqLock{
+
+    static_assert(std::is_trivially_copyable<T>::value, "SeqLock needs a plain struct");
+
+public:
+
+    SeqLock() : seq(0) {
+        T zero = T();
+        store(zero);
+    }
+
+    void write(const T &val){
+        portENTER_CRITICAL_SAFE(&lock);
+        seq.store(seq.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        store(val);
+        seq.store(seq.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+        portEXIT_CRITICAL_SAFE(&lock);
+    }
+
+    T read() const{
+        T val;
+        uint32_t s1, s2;
+        do{
+            while((s1 = seq.load(std::memory_order_acquire)) & 1);
+            load(val);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            s2 = seq.load(std::memory_order_relaxed);
+        }while(s1 != s2);
+        return val;
+    }
+
+private:
+
+    static const size_t WORDS = (sizeof(T) + 3) / 4;
+
+    //The data is kept as atomic words so that a reader racing with the
+    //writer reads garbage (and retries) instead of undefined behaviour
+    void store(const T &val){
+        uint32_t tmp[WORDS] = {0};
+        memcpy(tmp, &val, sizeof(T));
+        for(size_t i = 0; i < WORDS; i++)
+            data[i].store(tmp[i], std::memory_order_relaxed);
+    }
+
+    void load(T &val) const{
+        uint32_t tmp[WORDS];
+        for(size_t i = 0; i < WORDS; i++)
+            tmp[i] = data[i].load(std::memory_order_relaxed);
+        memcpy(&val, tmp, sizeof(T));
+    }
+
+    std::atomic<uint32_t> seq;
+    std::atomic<uint32_t> data[WORDS];
+    portMUX_TYPE lock = portMUX_INITIALIZER_UNLOCKED;
+};
+
+#endif
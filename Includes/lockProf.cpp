@@ -0,0 +1,222 @@
+#include <Arduino.h>
+#include <lockProf.h>
+
+#if LOCKPROF_ENABLE
+
+typedef struct{
+    SemaphoreHandle_t sem;
+    const char *name;
+    uint32_t takes;
+    uint32_t contended;             //takes that had to wait
+    uint64_t wait_total, hold_total;
+    uint32_t wait_max, hold_max;
+    bool mutex;                     //only mutexes get hold times
+    uint32_t taken_at;              //micros() of the holder's take
+    uint32_t wait_hist[LOCKPROF_BUCKETS];
+    uint32_t hold_hist[LOCKPROF_BUCKETS];
+}lockStats;
+
+typedef struct{
+    TaskHandle_t task;
+    char name[16];                  //copied, the task may be gone when we print
+    uint32_t takes;
+    uint64_t wait_total, hold_total;
+}taskStats;
+
+static lockStats locks[LOCKPROF_MAX_LOCKS];
+static taskStats tasks[LOCKPROF_MAX_TASKS];
+static uint32_t overflows = 0;      //locks or tasks that didn't fit in the tables
+static portMUX_TYPE prof_lock = portMUX_INITIALIZER_UNLOCKED;
+
+//************************************************************
+//Functions (call with prof_lock taken)
+
+//Bucket i holds times in [2^(i-1), 2^i) us, bucket 0 is 0 us
+static uint8_t bucket(uint32_t us){
+    uint8_t b = us ? 32 - __builtin_clz(us) : 0;
+    return b < LOCKPROF_BUCKETS ? b : LOCKPROF_BUCKETS - 1;
+}
+
+static lockStats *findLock(SemaphoreHandle_t sem){
+    for(uint8_t i = 0; i < LOCKPROF_MAX_LOCKS; i++){
+        if(locks[i].sem == sem)
+            return &locks[i];
+        if(locks[i].sem == NULL){
+            locks[i].sem = sem;
+            return &locks[i];
+        }
+    }
+    overflows++;
+    return NULL;
+}
+
+//Always called for the running task
+static taskStats *findTask(TaskHandle_t task){
+    for(uint8_t i = 0; i < LOCKPROF_MAX_TASKS; i++){
+        if(tasks[i].task == task)
+            return &tasks[i];
+        if(tasks[i].task == NULL){
+            tasks[i].task = task;
+            strncpy(tasks[i].name, pcTaskGetTaskName(NULL), sizeof(tasks[i].name) - 1);
+            return &tasks[i];
+        }
+    }
+    overflows++;
+    return NULL;
+}
+
+//************************************************************
+//API
+
+BaseType_t lockProfTake(SemaphoreHandle_t sem, TickType_t ticks){
+
+    uint32_t start = micros(), wait;
+    bool contended = false;
+    BaseType_t ret;
+
+    //Try first without waiting, so we know for sure if it was contended
+    ret = xSemaphoreTake(sem, 0);
+    if(ret != pdTRUE && ticks > 0){
+        contended = true;
+        ret = xSemaphoreTake(sem, ticks);
+    }
+    wait = micros() - start;
+
+    if(ret != pdTRUE)
+        return ret;
+
+    //A mutex has one holder, so one take time per lock is enough. A
+    //semaphore can be taken by several tasks at once (counting) or given
+    //by another task (signalling): there's no hold time to measure.
+    TaskHandle_t me = xTaskGetCurrentTaskHandle();
+    bool mutex = xSemaphoreGetMutexHolder(sem) == me;
+
+    portENTER_CRITICAL(&prof_lock);
+    lockStats *l = findLock(sem);
+    taskStats *t = findTask(me);
+    if(l != NULL){
+        l->takes++;
+        if(contended)
+            l->contended++;
+        l->wait_total += wait;
+        if(wait > l->wait_max)
+            l->wait_max = wait;
+        l->wait_hist[bucket(wait)]++;
+        l->mutex = mutex;
+        if(mutex)
+            l->taken_at = micros();
+    }
+    if(t != NULL){
+        t->takes++;
+        t->wait_total += wait;
+    }
+    portEXIT_CRITICAL(&prof_lock);
+
+    return ret;
+}
+
+BaseType_t lockProfGive(SemaphoreHandle_t sem){
+
+    uint32_t now = micros(), hold;
+    TaskHandle_t me = xTaskGetCurrentTaskHandle();
+    bool holder = xSemaphoreGetMutexHolder(sem) == me;
+
+    portENTER_CRITICAL(&prof_lock);
+    lockStats *l = findLock(sem);
+    taskStats *t = findTask(me);
+    //Only the holder giving a mutex taken through LOCK_TAKE has a hold time
+    if(l != NULL && l->mutex && holder && l->takes > 0){
+        hold = now - l->taken_at;
+        l->hold_total += hold;
+        if(hold > l->hold_max)
+            l->hold_max = hold;
+        l->hold_hist[bucket(hold)]++;
+        if(t != NULL)
+            t->hold_total += hold;
+    }
+    portEXIT_CRITICAL(&prof_lock);
+
+    return xSemaphoreGive(sem);
+}
+
+void lockProfName(SemaphoreHandle_t sem, const char *name){
+
+    portENTER_CRITICAL(&prof_lock);
+    lockStats *l = findLock(sem);
+    if(l != NULL)
+        l->name = name;
+    portEXIT_CRITICAL(&prof_lock);
+}
+
+void lockProfReset(){
+
+    portENTER_CRITICAL(&prof_lock);
+    memset(locks, 0, sizeof(locks));
+    memset(tasks, 0, sizeof(tasks));
+    overflows = 0;
+    portEXIT_CRITICAL(&prof_lock);
+}
+
+//Prints the top most contended locks (by total wait time) and all the tasks.
+//Works on a copy so that printing doesn't hold the profiler lock.
+void lockProfReport(uint8_t top){
+
+    static lockStats l[LOCKPROF_MAX_LOCKS];
+    static taskStats t[LOCKPROF_MAX_TASKS];
+    uint32_t ovf;
+    bool used[LOCKPROF_MAX_LOCKS] = {false};
+
+    portENTER_CRITICAL(&prof_lock);
+    memcpy(l, locks, sizeof(locks));
+    memcpy(t, tasks, sizeof(tasks));
+    ovf = overflows;
+    portEXIT_CRITICAL(&prof_lock);
+
+    Serial.println("lock,takes,contended,wait_total_us,wait_max_us,hold_total_us,hold_max_us");
+
+    for(uint8_t n = 0; n < top; n++){
+        int8_t best = -1;
+        for(uint8_t i = 0; i < LOCKPROF_MAX_LOCKS; i++){
+            if(l[i].sem == NULL || used[i])
+                continue;
+            if(best < 0 || l[i].wait_total > l[best].wait_total)
+                best = i;
+        }
+        if(best < 0)
+            break;
+        used[best] = true;
+
+        lockStats &s = l[best];
+        if(s.name != NULL)
+            Serial.print(s.name);
+        else
+            Serial.printf("%p", s.sem);
+        Serial.printf(",%lu,%lu,%llu,%lu", (unsigned long)s.takes, (unsigned long)s.contended,
+                        (unsigned long long)s.wait_total, (unsigned long)s.wait_max);
+        if(s.mutex)
+            Serial.printf(",%llu,%lu\n", (unsigned long long)s.hold_total, (unsigned long)s.hold_max);
+        else
+            Serial.println(",-,-");
+
+        //Histograms: count per bucket, bucket i is < 2^i us
+        Serial.print("  wait_hist");
+        for(uint8_t b = 0; b < LOCKPROF_BUCKETS; b++)
+            Serial.printf(",%lu", (unsigned long)s.wait_hist[b]);
+        if(s.mutex){
+            Serial.print("\n  hold_hist");
+            for(uint8_t b = 0; b < LOCKPROF_BUCKETS; b++)
+                Serial.printf(",%lu", (unsigned long)s.hold_hist[b]);
+        }
+        Serial.println();
+    }
+
+    Serial.println("task,takes,wait_total_us,hold_total_us");
+    for(uint8_t i = 0; i < LOCKPROF_MAX_TASKS && t[i].task != NULL; i++)
+        Serial.printf("%s,%lu,%llu,%llu\n", t[i].name, (unsigned long)t[i].takes,
+                        (unsigned long long)t[i].wait_total, (unsigned long long)t[i].hold_total);
+
+    if(ovf > 0)
+        Serial.printf("WARNING: %lu locks/tasks didn't fit in the profiler tables\n", (unsigned long)ovf);
+}
+
+#endif
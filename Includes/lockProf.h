@@ -0,0 +1,65 @@
+#ifndef LOCKPROF_H_
+#define LOCKPROF_H_
+
+#include <Arduino.h>
+
+/*
+    Lock contention profiler
+
+    TenthTest_PriorityHierarchy.cpp measures how long a task waited for the
+    lock by reading xTaskGetTickCount() before and after xSemaphoreTake, in
+    ms. This does it for every mutex/semaphore taken through LOCK_TAKE and
+    LOCK_GIVE, in microseconds:
+
+        LOCK_NAME(avgMutex, "avgMutex");           //optional, once
+        LOCK_TAKE(avgMutex, portMAX_DELAY);        //instead of xSemaphoreTake
+        ...
+        LOCK_GIVE(avgMutex);                       //instead of xSemaphoreGive
+        LOCK_REPORT(5);                            //prints the 5 most contended locks
+
+    For each lock it keeps: how many takes, how many had to wait, total and
+    max wait and hold time, and a histogram of both (power of 2 buckets in us,
+    fixed memory). For each task it keeps its total wait and hold time.
+    Hold times are only for mutexes (from the holder's take to its give): a
+    counting semaphore has several holders at once and a signalling one is
+    given by another task, so for those the report prints "-".
+
+    It is OFF by default. Turn it on for the whole project in platformio.ini:
+        build_flags = -DLOCKPROF_ENABLE=1
+    When it's off the macros are plain xSemaphoreTake/xSemaphoreGive, so it
+    costs nothing.
+
+    Only for tasks: ISRs can't wait on a lock anyway.
+*/
+
+#ifndef LOCKPROF_ENABLE
+#define LOCKPROF_ENABLE 0
+#endif
+
+enum {LOCKPROF_MAX_LOCKS = 16, LOCKPROF_MAX_TASKS = 16, LOCKPROF_BUCKETS = 16};
+
+#if LOCKPROF_ENABLE
+
+BaseType_t lockProfTake(SemaphoreHandle_t sem, TickType_t ticks);
+BaseType_t lockProfGive(SemaphoreHandle_t sem);
+void lockProfName(SemaphoreHandle_t sem, const char *name);
+void lockProfReport(uint8_t top);
+void lockProfReset();
+
+#define LOCK_TAKE(sem, ticks)   lockProfTake((sem), (ticks))
+#define LOCK_GIVE(sem)          lockProfGive(sem)
+#define LOCK_NAME(sem, name)    lockProfName((sem), (name))
+#define LOCK_REPORT(top)        lockProfReport(top)
+#define LOCK_RESET()            lockProfReset()
+
+#else
+
+#define LOCK_TAKE(sem, ticks)   xSemaphoreTake((sem), (ticks))
+#define LOCK_GIVE(sem)          xSemaphoreGive(sem)
+#define LOCK_NAME(sem, name)    ((void)0)
+#define LOCK_REPORT(top)        ((void)0)
+#define LOCK_RESET()            ((void)0)
+
+#endif
+
+#endif
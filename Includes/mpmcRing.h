@@ -0,0 +1,254 @@
+#ifndef MPMCRING_H_
+#define MPMCRING_H_
+
+#include <Arduino.h>
+#include <atomic>
+
+/*
+    Bounded lock-free ring for many producers and many consumers: MpmcRing<T, N>
+
+    Sixth_Semaphore_Challenge.cpp protects its circular buffer with two
+    counting semaphores and two mutexes, so every item costs five kernel
+    calls on each side. Here the producers and the consumers claim slots with
+    an atomic ticket (compare-and-swap on head/tail), and every slot has a
+    sequence number that says whose turn it is:
+
+        seq == pos          free, the producer holding ticket pos may write it
+        seq == pos + 1      full, the consumer holding ticket pos may read it
+        seq == pos + N      free again, for the producer one lap later
+
+    (This is the well-known bounded queue by Dmitry Vyukov.)
+
+    send()/receive() block like the semaphore version: a producer waits while
+    the ring is full and a consumer while it's empty. The kernel is only
+    called when someone is really waiting, which only happens on the full and
+    empty transitions: a waiting task registers in a counter and sleeps on a
+    semaphore, and whoever frees a slot (or fills one) wakes one of them.
+
+        static MpmcRing<uint8_t, 16> ring;
+        ring.begin();
+        ring.send(num, portMAX_DELAY);          //producers
+        ring.receive(&val, portMAX_DELAY);      //consumers
+
+    N must be a power of 2. Any task on any core can send/receive; ISRs use
+    the FromISR versions, which never block.
+*/
+
+/*
+    WaitList: tasks sleeping until a lock-free structure changes (room in a
+    full ring, an item in an empty one). Used by MpmcRing and WorkPool:
+
+        while(!tryIt()){
+            list.enter();                       //register
+            if(tryIt()){ list.leave(); break; } //check again, so no wake is missed
+            list.sleep(ticks);
+        }
+        ...and whoever makes tryIt() possible calls list.wake()
+
+    count is how many registered and weren't woken yet. A waker only gives
+    the semaphore if it could take one off count, so there's exactly one
+    give per registration it claims. A task that stops waiting by itself
+    (it got a slot, or timed out) takes itself off count, and if a waker
+    was faster, eats the give that's on its way.
+*/
+class WaitList{
+
+public:
+
+    WaitList() : count(0), sem(NULL) {}
+
+    //Can be called again, it only creates the semaphore once
+    bool begin(){
+        if(sem == NULL)
+            sem = xSemaphoreCreateCountingStatic(0xFFFF, 0, &sem_buf);
+        return sem != NULL;
+    }
+
+    //count and the slots are a Dekker pair: each side writes one and
+    //reads the other, so a full barrier is needed in between
+    void enter(){
+        count.fetch_add(1, std::memory_order_seq_cst);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+    }
+
+    bool claim(){
+        uint32_t c = count.load(std::memory_order_relaxed);
+        while(c > 0 && !count.compare_exchange_weak(c, c - 1, std::memory_order_relaxed));
+        return c > 0;
+    }
+
+    void leave(){
+        if(!claim())
+            xSemaphoreTake(sem, portMAX_DELAY);
+    }
+
+    void sleep(TickType_t ticks){
+        if(xSemaphoreTake(sem, ticks) != pdTRUE)
+            leave();
+    }
+
+    void wake(){
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if(count.load(std::memory_order_relaxed) > 0 && claim())
+            xSemaphoreGive(sem);
+    }
+
+    void wakeFromISR(BaseType_t *task_woken){
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if(count.load(std::memory_order_relaxed) > 0 && claim())
+            xSemaphoreGiveFromISR(sem, task_woken);
+    }
+
+private:
+    std::atomic<uint32_t> count;
+    SemaphoreHandle_t sem;
+    StaticSemaphore_t sem_buf;
+};
+
+template <typename T, uint16_t N>
+class MpmcRing{
+
+    static_assert(N >= 2 && (N & (N - 1)) == 0, "N must be a power of 2");
+
+public:
+
+    MpmcRing(){
+        for(uint16_t i = 0; i < N; i++)
+            cells[i].seq.store(i, std::memory_order_relaxed);
+        head.store(0, std::memory_order_relaxed);
+        tail.store(0, std::memory_order_relaxed);
+    }
+
+    bool begin(){
+        return producers.begin() && consumers.begin();
+    }
+
+    //********** Non-blocking, usable anywhere
+
+    bool trySend(const T &item){
+
+        Cell *c;
+        uint32_t pos = head.load(std::memory_order_relaxed);
+
+        while(1){
+            c = &cells[pos & (N - 1)];
+            int32_t dif = (int32_t)(c->seq.load(std::memory_order_acquire) - pos);
+            if(dif == 0){
+                //Our turn, try to take the ticket
+                if(head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            }
+            else if(dif < 0)
+                return false;       //full: the slot still holds last lap's item
+            else
+                pos = head.load(std::memory_order_relaxed);
+        }
+
+        c->data = item;
+        c->seq.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool tryReceive(T *item){
+
+        Cell *c;
+        uint32_t pos = tail.load(std::memory_order_relaxed);
+
+        while(1){
+            c = &cells[pos & (N - 1)];
+            int32_t dif = (int32_t)(c->seq.load(std::memory_order_acquire) - (pos + 1));
+            if(dif == 0){
+                if(tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            }
+            else if(dif < 0)
+                return false;       //empty (or the producer is still writing it)
+            else
+                pos = tail.load(std::memory_order_relaxed);
+        }
+
+        *item = c->data;
+        c->seq.store(pos + N, std::memory_order_release);
+        return true;
+    }
+
+    //********** Blocking, for tasks
+
+    BaseType_t send(const T &item, TickType_t ticks){
+
+        TickType_t start = xTaskGetTickCount();
+
+        while(!trySend(item)){
+            //Register, and check again before sleeping so a wake can't be missed
+            producers.enter();
+            if(trySend(item)){
+                producers.leave();
+                break;
+            }
+            TickType_t spent = xTaskGetTickCount() - start;
+            if(ticks != portMAX_DELAY && spent >= ticks){
+                producers.leave();
+                return pdFALSE;
+            }
+            producers.sleep(ticks == portMAX_DELAY ? portMAX_DELAY : ticks - spent);
+        }
+        consumers.wake();
+        return pdTRUE;
+    }
+
+    BaseType_t receive(T *item, TickType_t ticks){
+
+        TickType_t start = xTaskGetTickCount();
+
+        while(!tryReceive(item)){
+            consumers.enter();
+            if(tryReceive(item)){
+                consumers.leave();
+                break;
+            }
+            TickType_t spent = xTaskGetTickCount() - start;
+            if(ticks != portMAX_DELAY && spent >= ticks){
+                consumers.leave();
+                return pdFALSE;
+            }
+            consumers.sleep(ticks == portMAX_DELAY ? portMAX_DELAY : ticks - spent);
+        }
+        producers.wake();
+        return pdTRUE;
+    }
+
+    //********** ISR side, never blocks
+
+    BaseType_t sendFromISR(const T &item, BaseType_t *task_woken){
+        if(!trySend(item))
+            return pdFALSE;
+        consumers.wakeFromISR(task_woken);
+        return pdTRUE;
+    }
+
+    BaseType_t receiveFromISR(T *item, BaseType_t *task_woken){
+        if(!tryReceive(item))
+            return pdFALSE;
+        producers.wakeFromISR(task_woken);
+        return pdTRUE;
+    }
+
+    //Approximate, it may change while we look
+    uint16_t waiting() const {
+        int32_t n = (int32_t)(head.load(std::memory_order_relaxed) - tail.load(std::memory_order_relaxed));
+        return n < 0 ? 0 : (n > N ? N : n);
+    }
+
+private:
+
+    struct Cell{
+        std::atomic<uint32_t> seq;
+        T data;
+    };
+
+    Cell cells[N];
+    std::atomic<uint32_t> head, tail;       //next ticket for producers / consumers
+    WaitList producers, consumers;
+};
+
+#endif
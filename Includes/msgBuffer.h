@@ -0,0 +1,253 @@
+#ifndef MSGBUFFER_H_
+#define MSGBUFFER_H_
+
+#include <Arduino.h>
+#include <atomic>
+
+/*
+    Variable-length message buffer: MsgBuffer<SIZE>
+
+    Commands like "delay 100" travel in fixed char msg[20] structs: short
+    commands waste most of the slot and long ones are cut. Here every message
+    only takes what it needs. The buffer is a ring of SIZE bytes where each
+    record is a 4-byte length header followed by the data (padded to 4 bytes).
+
+    Records are always contiguous in memory. If one doesn't fit at the end of
+    the ring, a WRAP marker is written there and the record starts at 0. That
+    way both sides can work in place (zero copy):
+
+        writer:  uint8_t *p = buf.reserve(64, ticks);   //room for up to 64 bytes
+                 int n = sprintf((char*)p, "delay %u", num);
+                 buf.commit(n + 1);                     //publish what was used
+
+        reader:  uint16_t len;
+                 const uint8_t *p = buf.read(&len, ticks);
+                 ...use p[0..len-1]...
+                 buf.release();                         //give the room back
+
+    send()/receive() copy like a queue does, for when that's simpler.
+
+    Like the FreeRTOS message buffers there must be ONE writer (a task or an
+    ISR) and ONE reader, which may run on different cores. If more tasks need
+    to write, protect the writer side with a mutex.
+*/
+
+template <uint16_t SIZE>
+class MsgBuffer{
+
+    static_assert(SIZE % 4 == 0 && SIZE >= 16, "SIZE must be a multiple of 4");
+
+public:
+
+    MsgBuffer(){
+        head = 0;
+        tail = 0;
+        reserved = 0;
+        writer_waiting = false;
+        reader_waiting = false;
+        data_sem = space_sem = NULL;
+    }
+
+    bool begin(){
+        data_sem = xSemaphoreCreateBinaryStatic(&data_buf);
+        space_sem = xSemaphoreCreateBinaryStatic(&space_buf);
+        return data_sem != NULL && space_sem != NULL;
+    }
+
+    //Biggest message that can ever fit: its footprint() must fit before or
+    //after the head of an empty ring, wherever the head is (a multiple of 4)
+    static uint16_t maxMessage(){
+        return ((SIZE / 2) & ~3) - HDR;
+    }
+
+    //********** Writer side
+
+    //Returns a pointer with room for len bytes, or NULL after ticks
+    uint8_t *reserve(uint16_t len, TickType_t ticks){
+
+        TickType_t start = xTaskGetTickCount();
+        uint8_t *p;
+
+        if(len > maxMessage())
+            return NULL;
+
+        while((p = tryReserve(len)) == NULL){
+            //Announce that we're waiting, and check again before sleeping
+            writer_waiting = true;
+            fence();
+            if((p = tryReserve(len)) != NULL){
+                writer_waiting = false;
+                break;
+            }
+            TickType_t spent = xTaskGetTickCount() - start;
+            if(ticks != portMAX_DELAY && spent >= ticks){
+                writer_waiting = false;
+                return NULL;
+            }
+            xSemaphoreTake(space_sem, ticks == portMAX_DELAY ? portMAX_DELAY : ticks - spent);
+            writer_waiting = false;
+        }
+        return p;
+    }
+
+    //Publishes len bytes (len <= what was reserved)
+    void commit(uint16_t len){
+        publish(len);
+        fence();
+        if(reader_waiting)
+            xSemaphoreGive(data_sem);
+    }
+
+    BaseType_t send(const void *data, uint16_t len, TickType_t ticks){
+        uint8_t *p = reserve(len, ticks);
+        if(p == NULL)
+            return pdFALSE;
+        memcpy(p, data, len);
+        commit(len);
+        return pdTRUE;
+    }
+
+    //Never blocks
+    BaseType_t sendFromISR(const void *data, uint16_t len, BaseType_t *task_woken){
+        uint8_t *p = (len <= maxMessage()) ? tryReserve(len) : NULL;
+        if(p == NULL)
+            return pdFALSE;
+        memcpy(p, data, len);
+        publish(len);
+        fence();
+        if(reader_waiting)
+            xSemaphoreGiveFromISR(data_sem, task_woken);
+        return pdTRUE;
+    }
+
+    //********** Reader side
+
+    //Returns a pointer to the oldest message (and its length), or NULL after ticks
+    const uint8_t *read(uint16_t *len, TickType_t ticks){
+
+        TickType_t start = xTaskGetTickCount();
+        const uint8_t *p;
+
+        while((p = tryRead(len)) == NULL){
+            reader_waiting = true;
+            fence();
+            if((p = tryRead(len)) != NULL){
+                reader_waiting = false;
+                break;
+            }
+            TickType_t spent = xTaskGetTickCount() - start;
+            if(ticks != portMAX_DELAY && spent >= ticks){
+                reader_waiting = false;
+                return NULL;
+            }
+            xSemaphoreTake(data_sem, ticks == portMAX_DELAY ? portMAX_DELAY : ticks - spent);
+            reader_waiting = false;
+        }
+        return p;
+    }
+
+    //Frees the message returned by the last read()
+    void release(){
+        uint32_t t = tail.load(std::memory_order_relaxed);
+        t += HDR + align(header(t));
+        tail.store(t == SIZE ? 0 : t, std::memory_order_release);
+        fence();
+        if(writer_waiting)
+            xSemaphoreGive(space_sem);
+    }
+
+    //Copies the message into data (up to max bytes), returns its length or -1
+    int32_t receive(void *data, uint16_t max, TickType_t ticks){
+        uint16_t len;
+        const uint8_t *p = read(&len, ticks);
+        if(p == NULL)
+            return -1;
+        memcpy(data, p, len < max ? len : max);
+        release();
+        return len;
+    }
+
+    //Bytes a message of len bytes really takes in the ring
+    static uint16_t footprint(uint16_t len){
+        return HDR + align(len);
+    }
+
+private:
+
+    static const uint16_t HDR = 4;
+    static const uint32_t WRAP = 0xFFFFFFFF;
+
+    //The waiting flags and head/tail are a Dekker pair: each side writes one
+    //and reads the other, so a full barrier is needed between the two
+    static void fence(){
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+    }
+
+    static uint16_t align(uint16_t len){
+        return (len + 3) & ~3;
+    }
+
+    uint32_t &header(uint32_t at){
+        return *reinterpret_cast<uint32_t*>(storage + at);
+    }
+
+    //Finds contiguous room for a record, writing the WRAP marker if needed.
+    //head must never catch up with tail, or the ring would look empty.
+    uint8_t *tryReserve(uint16_t len){
+
+        uint32_t need = footprint(len);
+        uint32_t h = head.load(std::memory_order_relaxed);
+        uint32_t t = tail.load(std::memory_order_acquire);
+
+        if(h >= t){
+            if(need < SIZE - h || (need == SIZE - h && t != 0)){
+                reserved = h;
+                return storage + h + HDR;
+            }
+            //Not enough room at the end, try at the start
+            if(need < t){
+                header(h) = WRAP;
+                reserved = 0;
+                return storage + HDR;
+            }
+        }
+        else if(need < t - h){
+            reserved = h;
+            return storage + h + HDR;
+        }
+        return NULL;
+    }
+
+    void publish(uint16_t len){
+        uint32_t h = reserved;
+        header(h) = len;
+        h += HDR + align(len);
+        //release: the reader sees the data (and any WRAP marker) before the new head
+        head.store(h == SIZE ? 0 : h, std::memory_order_release);
+    }
+
+    const uint8_t *tryRead(uint16_t *len){
+
+        uint32_t t = tail.load(std::memory_order_relaxed);
+
+        if(t == head.load(std::memory_order_acquire))
+            return NULL;
+
+        if(header(t) == WRAP){
+            t = 0;
+            tail.store(0, std::memory_order_release);
+        }
+        *len = header(t);
+        return storage + t + HDR;
+    }
+
+    alignas(4) uint8_t storage[SIZE];
+    std::atomic<uint32_t> head, tail;       //head: next write, tail: next read
+    uint32_t reserved;                      //where the reserved record starts
+    std::atomic<bool> writer_waiting, reader_waiting;
+
+    SemaphoreHandle_t data_sem, space_sem;
+    StaticSemaphore_t data_buf, space_buf;
+};
+
+#endif
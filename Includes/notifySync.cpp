@@ -0,0 +1,90 @@
+#include <Arduino.h>
+#include <notifySync.h>
+
+//************************************************************
+//NotifyBinary / NotifyCounting
+
+bool NotifyBinary::begin(TaskHandle_t task){
+    waiter = (task != NULL) ? task : xTaskGetCurrentTaskHandle();
+    return waiter != NULL;
+}
+
+BaseType_t NotifyBinary::give(){
+    return xTaskNotifyGive(waiter);
+}
+
+BaseType_t NotifyBinary::giveFromISR(BaseType_t *task_woken){
+    vTaskNotifyGiveFromISR(waiter, task_woken);
+    return pdTRUE;
+}
+
+//Clearing the count on exit is what makes it binary: many gives, one take
+BaseType_t NotifyBinary::take(TickType_t ticks){
+    return ulTaskNotifyTake(pdTRUE, ticks) > 0 ? pdTRUE : pdFALSE;
+}
+
+BaseType_t NotifyCounting::take(TickType_t ticks){
+    return ulTaskNotifyTake(pdFALSE, ticks) > 0 ? pdTRUE : pdFALSE;
+}
+
+//************************************************************
+//NotifyBits
+
+bool NotifyBits::begin(TaskHandle_t task){
+    waiter = (task != NULL) ? task : xTaskGetCurrentTaskHandle();
+    pending = 0;
+    return waiter != NULL;
+}
+
+BaseType_t NotifyBits::setBits(EventBits_t bits){
+    return xTaskNotify(waiter, bits, eSetBits);
+}
+
+BaseType_t NotifyBits::setBitsFromISR(EventBits_t bits, BaseType_t *task_woken){
+    return xTaskNotifyFromISR(waiter, bits, eSetBits, task_woken);
+}
+
+//Moves the notified bits into pending. Only the waiter runs this, so pending
+//needs no lock, and clearing the notification value on exit means no bit set
+//after that can be lost. From any other task xTaskNotifyWait would wait on
+//that task's own notification instead.
+void NotifyBits::collect(TickType_t ticks){
+    uint32_t value;
+    configASSERT(xTaskGetCurrentTaskHandle() == waiter);
+    if(xTaskNotifyWait(0, 0xFFFFFFFF, &value, ticks) == pdTRUE)
+        pending |= value;
+}
+
+EventBits_t NotifyBits::waitBits(EventBits_t bits, BaseType_t clear, BaseType_t wait_all, TickType_t ticks){
+
+    TickType_t start = xTaskGetTickCount();
+    EventBits_t ret;
+
+    collect(0);
+    while(1){
+        bool done = wait_all ? (pending & bits) == bits : (pending & bits) != 0;
+        if(done)
+            break;
+        TickType_t spent = xTaskGetTickCount() - start;
+        if(ticks != portMAX_DELAY && spent >= ticks)
+            return pending;
+        collect(ticks == portMAX_DELAY ? portMAX_DELAY : ticks - spent);
+    }
+
+    ret = pending;
+    if(clear)
+        pending &= ~bits;
+    return ret;
+}
+
+EventBits_t NotifyBits::clearBits(EventBits_t bits){
+    collect(0);
+    EventBits_t ret = pending;
+    pending &= ~bits;
+    return ret;
+}
+
+EventBits_t NotifyBits::getBits(){
+    collect(0);
+    return pending;
+}
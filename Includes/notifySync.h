@@ -0,0 +1,79 @@
+#ifndef NOTIFYSYNC_H_
+#define NOTIFYSYNC_H_
+
+#include <Arduino.h>
+
+/*
+    Semaphore-like signals built on direct task notifications
+
+    EigthTest_HWInterrupts_3.cpp ends with a note: a task notification is
+    faster than a binary semaphore, because there's no kernel object in
+    between, the giver writes straight into the waiting task's TCB.
+    The catch is that a notification goes to ONE task, so these objects are
+    created for the task that will wait on them:
+
+        NotifyBinary   like a binary semaphore     give() / take()
+        NotifyCounting like a counting semaphore   give() / take()
+        NotifyBits     like an event group         setBits() / waitBits()
+
+        static NotifyBinary bin_event;
+        bin_event.begin(waiter_handle);         //or begin() from the waiter itself
+        bin_event.giveFromISR(&task_woken);     //ISR
+        bin_event.take(portMAX_DELAY);          //waiter task
+
+    Anyone (tasks on any core, ISRs) can give. Only the waiter can take.
+
+    NOTE: these use the task's notification value (the ESP32 port has one per
+    task), like ulTaskNotifyTake() does. A task must wait on ONE of these
+    objects at most, and not use its notification for anything else.
+*/
+
+class NotifyBinary{
+
+public:
+    NotifyBinary() : waiter(NULL) {}
+
+    //waiter NULL: the calling task
+    bool begin(TaskHandle_t waiter = NULL);
+
+    BaseType_t give();
+    BaseType_t giveFromISR(BaseType_t *task_woken);
+    BaseType_t take(TickType_t ticks);      //waiter only
+
+protected:
+    TaskHandle_t waiter;
+};
+
+//Every give is counted, take() takes one
+class NotifyCounting : public NotifyBinary{
+
+public:
+    BaseType_t take(TickType_t ticks);
+};
+
+class NotifyBits{
+
+public:
+    NotifyBits() : waiter(NULL), pending(0) {}
+
+    bool begin(TaskHandle_t waiter = NULL);
+
+    BaseType_t setBits(EventBits_t bits);
+    BaseType_t setBitsFromISR(EventBits_t bits, BaseType_t *task_woken);
+
+    //Same as xEventGroupWaitBits: waits for any (or all) of bits, returns
+    //the bits that were set when it returned.
+    //These three are waiter only (configASSERT): the bits are in the
+    //waiter's notification value, and only the waiter can read that.
+    EventBits_t waitBits(EventBits_t bits, BaseType_t clear, BaseType_t wait_all, TickType_t ticks);
+    EventBits_t clearBits(EventBits_t bits);
+    EventBits_t getBits();
+
+private:
+    void collect(TickType_t ticks);
+
+    TaskHandle_t waiter;
+    EventBits_t pending;                    //bits received and not cleared yet
+};
+
+#endif
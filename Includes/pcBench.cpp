@@ -0,0 +1,413 @@
+#include <Arduino.h>
+#include <stdlib.h>
+#include <atomic>
+#include <pcBench.h>
+#include <mpmcRing.h>
+#include <workPool.h>
+#include <barrier.h>
+#include <spawnTask.h>
+
+//************************************************************
+//Backend: counting semaphores + mutexes (Sixth_Semaphore_Challenge.cpp)
+
+class SemMutexBackend : public pcBackend{
+
+public:
+    const char *name(){ return "sem+mutex"; }
+
+    bool begin(const pcConfig &cfg){
+        payload = cfg.payload;
+        len = cfg.buf_len;
+        head = tail = 0;
+        buf = (uint8_t*)malloc(len * payload);
+        prod_sem = xSemaphoreCreateCounting(len, len);
+        cons_sem = xSemaphoreCreateCounting(len, 0);
+        headMutex = xSemaphoreCreateMutex();
+        tailMutex = xSemaphoreCreateMutex();
+        if(buf != NULL && prod_sem != NULL && cons_sem != NULL && headMutex != NULL && tailMutex != NULL)
+            return true;
+        end();
+        return false;
+    }
+
+    //Also after a begin() that only got part of it
+    void end(){
+        free(buf);
+        buf = NULL;
+        deleteSem(&prod_sem);
+        deleteSem(&cons_sem);
+        deleteSem(&headMutex);
+        deleteSem(&tailMutex);
+    }
+
+    void send(const uint8_t *item){
+        xSemaphoreTake(prod_sem, portMAX_DELAY);
+        xSemaphoreTake(headMutex, portMAX_DELAY);
+        memcpy(buf + head * payload, item, payload);
+        head = (head + 1) % len;
+        xSemaphoreGive(headMutex);
+        xSemaphoreGive(cons_sem);
+    }
+
+    void receive(uint8_t *item){
+        xSemaphoreTake(cons_sem, portMAX_DELAY);
+        xSemaphoreTake(tailMutex, portMAX_DELAY);
+        memcpy(item, buf + tail * payload, payload);
+        tail = (tail + 1) % len;
+        xSemaphoreGive(tailMutex);
+        xSemaphoreGive(prod_sem);
+    }
+
+private:
+    static void deleteSem(SemaphoreHandle_t *sem){
+        if(*sem != NULL)
+            vSemaphoreDelete(*sem);
+        *sem = NULL;
+    }
+
+    uint8_t *buf;
+    uint16_t payload, len, head, tail;
+    SemaphoreHandle_t prod_sem, cons_sem, headMutex, tailMutex;
+};
+
+//************************************************************
+//Backend: FreeRTOS queue (Sixth_Challenge_2.cpp)
+
+class KernelQueueBackend : public pcBackend{
+
+public:
+    const char *name(){ return "kernel_queue"; }
+
+    bool begin(const pcConfig &cfg){
+        queue = xQueueCreate(cfg.buf_len, cfg.payload);
+        return queue != NULL;
+    }
+
+    void end(){
+        vQueueDelete(queue);
+    }
+
+    void send(const uint8_t *item){
+        xQueueSend(queue, item, portMAX_DELAY);
+    }
+
+    void receive(uint8_t *item){
+        xQueueReceive(queue, item, portMAX_DELAY);
+    }
+
+private:
+    QueueHandle_t queue;
+};
+
+//************************************************************
+//Backend: lock-free. The payloads live in a slab of buf_len slots, and two
+//MpmcRing move slot numbers around: free_slots -> producer -> full_slots ->
+//consumer -> free_slots. Taking a free slot blocks when the buffer is full.
+
+class LockFreeBackend : public pcBackend{
+
+public:
+    LockFreeBackend() : ready(false), slab(NULL) {}
+
+    const char *name(){ return "lock_free"; }
+
+    bool begin(const pcConfig &cfg){
+        if(!ready)
+            ready = free_slots.begin() && full_slots.begin();
+        if(!ready)
+            return false;
+        payload = cfg.payload;
+        slab = (uint8_t*)malloc(cfg.buf_len * payload);
+        if(slab == NULL)
+            return false;
+        for(uint16_t i = 0; i < cfg.buf_len; i++)
+            free_slots.trySend(i);
+        return true;
+    }
+
+    void end(){
+        uint16_t slot;
+        while(free_slots.tryReceive(&slot));
+        free(slab);
+        slab = NULL;
+    }
+
+    void send(const uint8_t *item){
+        uint16_t slot;
+        free_slots.receive(&slot, portMAX_DELAY);
+        memcpy(slab + slot * payload, item, payload);
+        full_slots.send(slot, portMAX_DELAY);
+    }
+
+    void receive(uint8_t *item){
+        uint16_t slot;
+        full_slots.receive(&slot, portMAX_DELAY);
+        memcpy(item, slab + slot * payload, payload);
+        free_slots.send(slot, portMAX_DELAY);
+    }
+
+private:
+    bool ready;
+    uint8_t *slab;
+    uint16_t payload;
+    MpmcRing<uint16_t, PC_MAX_BUF> free_slots, full_slots;
+};
+
+//************************************************************
+//Backend: work stealing. Same slab and free_slots as above, but the full
+//slots go to a WorkPool: one deque per consumer, and idle consumers steal.
+
+class WorkStealingBackend : public pcBackend{
+
+public:
+    WorkStealingBackend() : ready(false), slab(NULL) {}
+
+    const char *name(){ return "work_stealing"; }
+
+    bool begin(const pcConfig &cfg){
+        if(!ready)
+            ready = free_slots.begin();
+        //Everything that can fail before the slab, so that nothing leaks
+        if(!ready || !pool.begin(cfg.consumers))
+            return false;
+        payload = cfg.payload;
+        slab = (uint8_t*)malloc(cfg.buf_len * payload);
+        if(slab == NULL)
+            return false;
+        for(uint16_t i = 0; i < cfg.buf_len; i++)
+            free_slots.trySend(i);
+        num_workers.store(0);
+        for(uint8_t i = 0; i < PC_MAX_WORKERS; i++)
+            workers[i] = NULL;
+        return true;
+    }
+
+    void end(){
+        uint16_t slot;
+        while(free_slots.tryReceive(&slot));
+        free(slab);
+        slab = NULL;
+    }
+
+    void send(const uint8_t *item){
+        uint16_t slot;
+        free_slots.receive(&slot, portMAX_DELAY);
+        memcpy(slab + slot * payload, item, payload);
+        pool.push(slot, portMAX_DELAY);
+    }
+
+    void receive(uint8_t *item){
+        uint16_t slot;
+        pool.take(workerNum(), &slot, portMAX_DELAY);
+        memcpy(item, slab + slot * payload, payload);
+        free_slots.send(slot, portMAX_DELAY);
+    }
+
+private:
+    enum {PC_MAX_WORKERS = 16};
+
+    //Every consumer task gets a worker number the first time it receives
+    uint8_t workerNum(){
+        TaskHandle_t me = xTaskGetCurrentTaskHandle();
+        uint8_t n = num_workers.load(std::memory_order_acquire);
+        for(uint8_t i = 0; i < n; i++)
+            if(workers[i] == me)
+                return i;
+        n = num_workers.fetch_add(1, std::memory_order_acq_rel);
+        workers[n] = me;
+        return n;
+    }
+
+    bool ready;
+    uint8_t *slab;
+    uint16_t payload;
+    MpmcRing<uint16_t, PC_MAX_BUF> free_slots;
+    WorkPool<uint16_t, PC_MAX_BUF, PC_MAX_WORKERS> pool;
+    TaskHandle_t workers[PC_MAX_WORKERS];
+    std::atomic<uint8_t> num_workers;
+};
+
+pcBackend &pcSemMutex(){
+    static SemMutexBackend backend;
+    return backend;
+}
+
+pcBackend &pcKernelQueue(){
+    static KernelQueueBackend backend;
+    return backend;
+}
+
+pcBackend &pcLockFree(){
+    static LockFreeBackend backend;
+    return backend;
+}
+
+pcBackend &pcWorkStealing(){
+    static WorkStealingBackend backend;
+    return backend;
+}
+
+//************************************************************
+//Runner
+
+static pcBackend *backend;                  //the current run
+static pcConfig cfg;
+
+static EventGroupHandle_t start_group = NULL;
+static const EventBits_t GO = 1;
+static CountdownLatch prod_done, cons_done;
+
+static uint32_t samples[PC_MAX_SAMPLES];
+static std::atomic<uint32_t> num_samples;
+static uint32_t sample_stride;
+static std::atomic<uint32_t> received, checksum;
+
+static void busyCycles(uint32_t cycles){
+    uint32_t start = ESP.getCycleCount();
+    while(ESP.getCycleCount() - start < cycles);
+}
+
+static BaseType_t coreFor(BaseType_t setting, uint8_t num){
+    return setting == PC_SPREAD ? num % 2 : setting;
+}
+
+static void producer(const uint8_t &num){
+
+    uint8_t item[PC_MAX_PAYLOAD];
+    pcItemHeader *hdr = (pcItemHeader*)item;
+
+    memset(item, num, cfg.payload);
+    xEventGroupWaitBits(start_group, GO, pdFALSE, pdTRUE, portMAX_DELAY);
+
+    for(uint32_t i = 0; i < cfg.items_per_prod; i++){
+        hdr->seq = ((uint32_t)num << 24) | i;
+        hdr->sent_us = micros();
+        backend->send(item);
+    }
+    prod_done.countDown();
+}
+
+static void consumer(const uint8_t &num){
+
+    uint8_t item[PC_MAX_PAYLOAD];
+    pcItemHeader *hdr = (pcItemHeader*)item;
+    uint32_t count = 0, sum = 0;
+
+    xEventGroupWaitBits(start_group, GO, pdFALSE, pdTRUE, portMAX_DELAY);
+
+    while(1){
+        backend->receive(item);
+        if(hdr->seq == PC_STOP)
+            break;
+
+        uint32_t latency = micros() - hdr->sent_us;
+        if((hdr->seq & 0xFFFFFF) % sample_stride == 0){
+            uint32_t n = num_samples.fetch_add(1, std::memory_order_relaxed);
+            if(n < PC_MAX_SAMPLES)
+                samples[n] = latency;
+        }
+        count++;
+        sum += hdr->seq;
+        if(cfg.heavy_every && (hdr->seq & 0xFFFFFF) % cfg.heavy_every == cfg.heavy_every - 1U)
+            busyCycles(cfg.heavy_cycles);
+        else
+            busyCycles(cfg.work_cycles);
+    }
+
+    received.fetch_add(count, std::memory_order_relaxed);
+    checksum.fetch_add(sum, std::memory_order_relaxed);
+    cons_done.countDown();
+}
+
+static int cmpU32(const void *a, const void *b){
+    uint32_t x = *(const uint32_t*)a, y = *(const uint32_t*)b;
+    return x < y ? -1 : (x > y ? 1 : 0);
+}
+
+static uint32_t percentile(uint32_t n, uint8_t p){
+    return n ? samples[(uint32_t)((uint64_t)(n - 1) * p / 100)] : 0;
+}
+
+bool pcRun(pcBackend &b, const pcConfig &c, pcResult *res){
+
+    uint8_t stop[PC_MAX_PAYLOAD];
+    uint32_t expected = 0, start, total, n;
+
+    memset(res, 0, sizeof(*res));
+    if(c.buf_len == 0 || c.buf_len > PC_MAX_BUF || c.payload < sizeof(pcItemHeader) ||
+       c.payload > PC_MAX_PAYLOAD || c.producers == 0 || c.consumers == 0)
+        return false;
+
+    //A begin() that fails has freed what it got, there's nothing to end()
+    if(start_group == NULL)
+        start_group = xEventGroupCreate();
+    if(start_group == NULL || !b.begin(c))
+        return false;
+
+    backend = &b;
+    cfg = c;
+    total = c.producers * c.items_per_prod;
+    sample_stride = (total + PC_MAX_SAMPLES - 1) / PC_MAX_SAMPLES;    //about PC_MAX_SAMPLES samples
+    if(sample_stride == 0)
+        sample_stride = 1;
+    num_samples.store(0);
+    received.store(0);
+    checksum.store(0);
+    prod_done.begin(c.producers);
+    cons_done.begin(c.consumers);
+    xEventGroupClearBits(start_group, GO);
+
+    for(uint8_t i = 0; i < c.producers; i++){
+        spawnTask(producer, "pcProd", 2048 + PC_MAX_PAYLOAD, i, c.prod_prio, NULL, coreFor(c.prod_core, i));
+        for(uint32_t k = 0; k < c.items_per_prod; k++)
+            expected += ((uint32_t)i << 24) | k;
+    }
+    for(uint8_t i = 0; i < c.consumers; i++)
+        spawnTask(consumer, "pcCons", 2048 + PC_MAX_PAYLOAD, i, c.cons_prio, NULL, coreFor(c.cons_core, i + 1));
+
+    start = micros();
+    xEventGroupSetBits(start_group, GO);
+
+    //The STOPs go in after the last item, one per consumer
+    prod_done.wait(portMAX_DELAY);
+    memset(stop, 0, c.payload);
+    ((pcItemHeader*)stop)->seq = PC_STOP;
+    for(uint8_t i = 0; i < c.consumers; i++)
+        b.send(stop);
+    cons_done.wait(portMAX_DELAY);
+
+    res->elapsed_us = micros() - start;
+    res->items = received.load();
+    res->items_per_s = res->elapsed_us ? (uint64_t)res->items * 1000000 / res->elapsed_us : 0;
+    res->ok = res->items == total && checksum.load() == expected;
+
+    n = num_samples.load();
+    if(n > PC_MAX_SAMPLES)
+        n = PC_MAX_SAMPLES;
+    qsort(samples, n, sizeof(samples[0]), cmpU32);
+    res->p50_us = percentile(n, 50);
+    res->p90_us = percentile(n, 90);
+    res->p99_us = percentile(n, 99);
+    res->max_us = n ? samples[n - 1] : 0;
+
+    b.end();
+
+    //Let the idle task free the workers before the next run
+    vTaskDelay(50 / portTICK_PERIOD_MS);
+    return true;
+}
+
+void pcPrintHeader(){
+    Serial.println("backend,producers,consumers,buf_len,payload,prod_prio,cons_prio,prod_core,cons_core,"
+                   "items,work_cycles,heavy_every,heavy_cycles,us,items_per_s,p50_us,p90_us,p99_us,max_us,check");
+}
+
+void pcPrintResult(pcBackend &b, const pcConfig &c, const pcResult &res){
+    Serial.printf("%s,%u,%u,%u,%u,%u,%u,%d,%d,%lu,%lu,%u,%lu,%lu,%lu,%lu,%lu,%lu,%lu,%s\n",
+                    b.name(), c.producers, c.consumers, c.buf_len, c.payload,
+                    (unsigned)c.prod_prio, (unsigned)c.cons_prio, (int)c.prod_core, (int)c.cons_core,
+                    (unsigned long)res.items, (unsigned long)c.work_cycles, c.heavy_every, (unsigned long)c.heavy_cycles,
+                    (unsigned long)res.elapsed_us,
+                    (unsigned long)res.items_per_s, (unsigned long)res.p50_us, (unsigned long)res.p90_us,
+                    (unsigned long)res.p99_us, (unsigned long)res.max_us, res.ok ? "ok" : "BAD");
+}
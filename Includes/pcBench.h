@@ -0,0 +1,86 @@
+#ifndef PCBENCH_H_
+#define PCBENCH_H_
+
+#include <Arduino.h>
+
+/*
+    Producer/consumer benchmark harness
+
+    The semaphore lessons hardcode 5 producers, 2 consumers, 3 writes and a
+    10 slot buffer, and print the values. To compare designs we need the same
+    topology with every knob exposed, and numbers instead of values:
+
+        pcConfig cfg = {5, 2, 10, 8, 1, 1, 1, 1, 1000, 0};
+        pcResult res;
+        pcRun(pcSemMutex(), cfg, &res);
+        pcPrintHeader();
+        pcPrintResult(pcSemMutex(), cfg, res);
+
+    Every item carries a sequence number and the micros() when it was sent,
+    so the harness measures throughput (items/s) and the send -> receive
+    latency percentiles, and checks that every item arrived exactly once.
+
+    Backends (anything implementing pcBackend can be plugged in):
+        pcSemMutex()        the lesson: 2 counting semaphores + head/tail mutexes
+        pcKernelQueue()     a FreeRTOS queue, like Sixth_Challenge_2.cpp
+        pcLockFree()        slab of slots moved with two MpmcRing (Includes/mpmcRing.h)
+        pcWorkStealing()    slab of slots handed out through a WorkPool (Includes/workPool.h)
+
+    pcRun() must be called from a task with a higher priority than the
+    workers, and only one run at a time.
+*/
+
+enum {PC_MAX_BUF = 256, PC_MAX_PAYLOAD = 256, PC_MAX_SAMPLES = 4096};
+static const BaseType_t PC_SPREAD = -1;     //core setting: alternate tasks between cores
+
+typedef struct{
+    uint8_t producers;
+    uint8_t consumers;
+    uint16_t buf_len;                       //items the buffer holds, up to PC_MAX_BUF
+    uint16_t payload;                       //bytes per item, 8 to PC_MAX_PAYLOAD
+    UBaseType_t prod_prio, cons_prio;
+    BaseType_t prod_core, cons_core;        //0, 1 or PC_SPREAD
+    uint32_t items_per_prod;
+    uint32_t work_cycles;                   //busy work per item in the consumer
+    uint16_t heavy_every;                   //0, or every heavy_every-th item of a producer...
+    uint32_t heavy_cycles;                  //...costs this much instead (skewed load)
+}pcConfig;
+
+typedef struct{
+    uint32_t items;
+    uint32_t elapsed_us;
+    uint32_t items_per_s;
+    uint32_t p50_us, p90_us, p99_us, max_us;
+    bool ok;                                //every item received exactly once
+}pcResult;
+
+//Every item starts with this header, the rest of the payload is filler
+typedef struct{
+    uint32_t seq;                           //producer << 24 | item number
+    uint32_t sent_us;
+}pcItemHeader;
+
+static const uint32_t PC_STOP = 0xFFFFFFFF; //seq that tells a consumer to finish
+
+class pcBackend{
+
+public:
+    virtual ~pcBackend(){}
+    virtual const char *name() = 0;
+    virtual bool begin(const pcConfig &cfg) = 0;    //get ready for one run, or free it all and fail
+    virtual void end() = 0;                         //the buffer is empty again
+    virtual void send(const uint8_t *item) = 0;     //payload bytes, blocks while full
+    virtual void receive(uint8_t *item) = 0;        //blocks while empty
+};
+
+pcBackend &pcSemMutex();
+pcBackend &pcKernelQueue();
+pcBackend &pcLockFree();
+pcBackend &pcWorkStealing();
+
+bool pcRun(pcBackend &backend, const pcConfig &cfg, pcResult *res);
+
+void pcPrintHeader();
+void pcPrintResult(pcBackend &backend, const pcConfig &cfg, const pcResult &res);
+
+#endif
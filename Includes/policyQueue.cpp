@@ -0,0 +1,166 @@
+#include <Arduino.h>
+#include <string.h>
+#include <policyQueue.h>
+
+/*
+    The ring (storage, head, tail, count) is protected by a spinlock so the
+    queue can be used from both cores and from ISRs.
+
+    The "items" counting semaphore always holds at most the number of items
+    in the ring, so a receiver that takes it is sure to find something to pop.
+    Overwriting or coalescing doesn't change how many items there are, so in
+    those cases the semaphore is left alone.
+*/
+
+PolicyQueue::PolicyQueue(){
+    storage = NULL;
+    len = item_size = 0;
+    head = tail = count = 0;
+    drops = 0;
+    policy = QUEUE_BLOCK;
+    key = NULL;
+    items = spaces = NULL;
+}
+
+PolicyQueue::~PolicyQueue(){
+    if(items != NULL)
+        vSemaphoreDelete(items);
+    if(spaces != NULL)
+        vSemaphoreDelete(spaces);
+    vPortFree(storage);
+}
+
+bool PolicyQueue::begin(uint16_t len, uint16_t item_size, QueuePolicy policy, QueueKeyFn key){
+
+    //Coalescing makes no sense without a way to compare items
+    if(len == 0 || item_size == 0 || (policy == QUEUE_COALESCE && key == NULL))
+        return false;
+
+    this->len = len;
+    this->item_size = item_size;
+    this->policy = policy;
+    this->key = key;
+
+    storage = (uint8_t*)pvPortMalloc((uint32_t)len * item_size);
+    items = xSemaphoreCreateCounting(len, 0);
+    if(policy == QUEUE_BLOCK)
+        spaces = xSemaphoreCreateCounting(len, len);
+
+    return storage != NULL && items != NULL && (policy != QUEUE_BLOCK || spaces != NULL);
+}
+
+//Must be called with the lock taken
+//added tells if the number of items grew (and so "items" must be given)
+BaseType_t PolicyQueue::push(const void *item, bool *added){
+
+    *added = false;
+
+    if(policy == QUEUE_COALESCE){
+        uint32_t k = key(item);
+        for(uint16_t i = 0, idx = tail; i < count; i++, idx = (idx + 1) % len){
+            if(key(slot(idx)) == k){
+                memcpy(slot(idx), item, item_size);
+                drops++;
+                return pdTRUE;
+            }
+        }
+    }
+
+    if(count == len){
+        if(policy == QUEUE_DROP_NEWEST || policy == QUEUE_BLOCK){
+            drops++;
+            return pdFALSE;
+        }
+        //QUEUE_DROP_OLDEST and QUEUE_COALESCE: forget the oldest one
+        tail = (tail + 1) % len;
+        count--;
+        drops++;
+    }
+    else
+        *added = true;
+
+    memcpy(slot(head), item, item_size);
+    head = (head + 1) % len;
+    count++;
+
+    return pdTRUE;
+}
+
+void PolicyQueue::pop(void *item){
+
+    memcpy(item, slot(tail), item_size);
+    tail = (tail + 1) % len;
+    count--;
+}
+
+BaseType_t PolicyQueue::send(const void *item, TickType_t ticks){
+
+    BaseType_t ret;
+    bool added;
+
+    //Only the blocking policy waits, the rest decide under the lock
+    if(policy == QUEUE_BLOCK && xSemaphoreTake(spaces, ticks) != pdTRUE){
+        portENTER_CRITICAL(&lock);
+        drops++;
+        portEXIT_CRITICAL(&lock);
+        return pdFALSE;
+    }
+
+    portENTER_CRITICAL(&lock);
+    ret = push(item, &added);
+    portEXIT_CRITICAL(&lock);
+
+    if(added)
+        xSemaphoreGive(items);
+
+    return ret;
+}
+
+BaseType_t PolicyQueue::sendFromISR(const void *item, BaseType_t *task_woken){
+
+    BaseType_t ret;
+    bool added;
+
+    //ISRs can't wait, a blocking queue behaves like QUEUE_DROP_NEWEST here
+    if(policy == QUEUE_BLOCK && xSemaphoreTakeFromISR(spaces, task_woken) != pdTRUE){
+        portENTER_CRITICAL_ISR(&lock);
+        drops++;
+        portEXIT_CRITICAL_ISR(&lock);
+        return pdFALSE;
+    }
+
+    portENTER_CRITICAL_ISR(&lock);
+    ret = push(item, &added);
+    portEXIT_CRITICAL_ISR(&lock);
+
+    if(added)
+        xSemaphoreGiveFromISR(items, task_woken);
+
+    return ret;
+}
+
+BaseType_t PolicyQueue::receive(void *item, TickType_t ticks){
+
+    if(xSemaphoreTake(items, ticks) != pdTRUE)
+        return pdFALSE;
+
+    portENTER_CRITICAL(&lock);
+    pop(item);
+    portEXIT_CRITICAL(&lock);
+
+    if(policy == QUEUE_BLOCK)
+        xSemaphoreGive(spaces);
+
+    return pdTRUE;
+}
+
+uint16_t PolicyQueue::waiting(){
+
+    uint16_t n;
+
+    portENTER_CRITICAL(&lock);
+    n = count;
+    portEXIT_CRITICAL(&lock);
+
+    return n;
+}
@@ -0,0 +1,67 @@
+#ifndef POLICYQUEUE_H_
+#define POLICYQUEUE_H_
+
+#include <Arduino.h>
+
+/*
+    Queue with a selectable overflow policy.
+
+    A FreeRTOS queue only knows one thing to do when it is full: block the
+    sender for some ticks and then give up. This queue lets every instance
+    choose what happens when a producer is faster than the consumer:
+
+        - QUEUE_BLOCK:       wait up to the given ticks for a free slot (like xQueueSend)
+        - QUEUE_DROP_NEWEST: never wait, the new item is thrown away
+        - QUEUE_DROP_OLDEST: never wait, the oldest item is overwritten
+        - QUEUE_COALESCE:    never wait, an item with the same key is replaced
+                             in place (latest value wins). If no item has that
+                             key and the queue is full, the oldest is dropped.
+
+    Items are copied by value, just like xQueueSend/xQueueReceive.
+    Every lost item (rejected, overwritten or coalesced) is counted.
+*/
+
+enum QueuePolicy {QUEUE_BLOCK, QUEUE_DROP_NEWEST, QUEUE_DROP_OLDEST, QUEUE_COALESCE};
+
+//Returns the key of an item, only needed for QUEUE_COALESCE
+typedef uint32_t (*QueueKeyFn)(const void *item);
+
+class PolicyQueue{
+
+public:
+    PolicyQueue();
+    ~PolicyQueue();
+
+    //Allocates the storage (len items of item_size bytes) and the semaphores.
+    //Returns false if there's no memory.
+    bool begin(uint16_t len, uint16_t item_size, QueuePolicy policy, QueueKeyFn key = NULL);
+
+    //Returns pdTRUE if the item is in the queue (it may have replaced another one).
+    //ticks is only used with QUEUE_BLOCK
+    BaseType_t send(const void *item, TickType_t ticks);
+    BaseType_t sendFromISR(const void *item, BaseType_t *task_woken);
+
+    BaseType_t receive(void *item, TickType_t ticks);
+
+    uint16_t waiting();
+    uint32_t dropped() const { return drops; }
+    QueuePolicy getPolicy() const { return policy; }
+
+private:
+    BaseType_t push(const void *item, bool *added);
+    void pop(void *item);
+    uint8_t *slot(uint16_t i) { return storage + (uint32_t)i * item_size; }
+
+    uint8_t *storage;
+    uint16_t len, item_size;
+    uint16_t head, tail, count;        //head: next write, tail: next read
+    volatile uint32_t drops;
+    QueuePolicy policy;
+    QueueKeyFn key;
+
+    portMUX_TYPE lock = portMUX_INITIALIZER_UNLOCKED;
+    SemaphoreHandle_t items;           //counts items, receivers wait on it
+    SemaphoreHandle_t spaces;          //counts free slots, only for QUEUE_BLOCK
+};
+
+#endif
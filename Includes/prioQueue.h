@@ -0,0 +1,154 @@
+#ifndef PRIOQUEUE_H_
+#define PRIOQUEUE_H_
+
+#include <Arduino.h>
+
+/*
+    Priority (or deadline) ordered message queue.
+
+    FreeRTOS queues are FIFO: an urgent message waits behind everything that
+    was sent before it. This queue always hands out the message with the
+    smallest rank first. The rank can be:
+        - a priority, where 0 is the most urgent
+        - a deadline in ticks, e.g. xTaskGetTickCount() + 100
+    Ranks are compared with wrap-around arithmetic so tick deadlines keep
+    working after the tick counter overflows. Messages with the same rank come
+    out in the order they were sent.
+
+    Messages are kept in a bounded binary heap inside the object (N slots,
+    no heap allocation). Like a kernel queue it supports blocking send and
+    receive, and send can be called from an ISR.
+
+    Usage:
+        static PrioQueue<uint16_t, 8> queue1;
+        queue1.begin();
+        queue1.send(num, 0, 10);              //rank 0: urgent
+        queue1.receive(&num, portMAX_DELAY);
+*/
+
+template <typename T, uint16_t N>
+class PrioQueue{
+
+public:
+
+    bool begin(){
+        count = 0;
+        seq = 0;
+        items = xSemaphoreCreateCountingStatic(N, 0, &items_buf);
+        spaces = xSemaphoreCreateCountingStatic(N, N, &spaces_buf);
+        return items != NULL && spaces != NULL;
+    }
+
+    BaseType_t send(const T &item, uint32_t rank, TickType_t ticks){
+
+        if(xSemaphoreTake(spaces, ticks) != pdTRUE)
+            return pdFALSE;
+
+        portENTER_CRITICAL(&lock);
+        push(item, rank);
+        portEXIT_CRITICAL(&lock);
+
+        xSemaphoreGive(items);
+        return pdTRUE;
+    }
+
+    //Never blocks: returns pdFALSE if the queue is full
+    BaseType_t sendFromISR(const T &item, uint32_t rank, BaseType_t *task_woken){
+
+        if(xSemaphoreTakeFromISR(spaces, task_woken) != pdTRUE)
+            return pdFALSE;
+
+        portENTER_CRITICAL_ISR(&lock);
+        push(item, rank);
+        portEXIT_CRITICAL_ISR(&lock);
+
+        xSemaphoreGiveFromISR(items, task_woken);
+        return pdTRUE;
+    }
+
+    //rank is optional, useful to know if a deadline has already passed
+    BaseType_t receive(T *item, TickType_t ticks, uint32_t *rank = NULL){
+
+        if(xSemaphoreTake(items, ticks) != pdTRUE)
+            return pdFALSE;
+
+        portENTER_CRITICAL(&lock);
+        if(rank != NULL)
+            *rank = heap[0].rank;
+        pop(item);
+        portEXIT_CRITICAL(&lock);
+
+        xSemaphoreGive(spaces);
+        return pdTRUE;
+    }
+
+    uint16_t waiting(){
+        uint16_t n;
+        portENTER_CRITICAL(&lock);
+        n = count;
+        portEXIT_CRITICAL(&lock);
+        return n;
+    }
+
+private:
+
+    typedef struct{
+        uint32_t rank;
+        uint32_t seq;       //send order, breaks ties so equal ranks stay FIFO
+        T item;
+    }entry;
+
+    //true if a has to come out before b
+    static bool before(const entry &a, const entry &b){
+        if(a.rank != b.rank)
+            return (int32_t)(a.rank - b.rank) < 0;
+        return (int32_t)(a.seq - b.seq) < 0;
+    }
+
+    //Sift up: the hole moves towards the root until the new entry fits
+    void push(const T &item, uint32_t rank){
+
+        uint16_t i = count++;
+        entry e;
+        e.rank = rank;
+        e.seq = seq++;
+        e.item = item;
+
+        while(i > 0){
+            uint16_t parent = (i - 1) / 2;
+            if(!before(e, heap[parent]))
+                break;
+            heap[i] = heap[parent];
+            i = parent;
+        }
+        heap[i] = e;
+    }
+
+    //Sift down: the last entry is moved from the root to its place
+    void pop(T *item){
+
+        *item = heap[0].item;
+        entry last = heap[--count];
+        uint16_t i = 0, child;
+
+        while((child = 2 * i + 1) < count){
+            if(child + 1 < count && before(heap[child + 1], heap[child]))
+                child++;
+            if(!before(heap[child], last))
+                break;
+            heap[i] = heap[child];
+            i = child;
+        }
+        heap[i] = last;
+    }
+
+    entry heap[N];
+    uint16_t count;
+    uint32_t seq;
+
+    portMUX_TYPE lock = portMUX_INITIALIZER_UNLOCKED;
+    SemaphoreHandle_t items, spaces;
+    StaticSemaphore_t items_buf, spaces_buf;
+};
+
+#endif
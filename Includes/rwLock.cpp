@@ -0,0 +1,70 @@
+#include <Arduino.h>
+#include <rwLock.h>
+
+RWLock::RWLock(){
+    state = 0;
+    writer = NULL;
+    wmutex = NULL;
+    slow_reads = 0;
+}
+
+RWLock::~RWLock(){
+    if(wmutex != NULL)
+        vSemaphoreDelete(wmutex);
+}
+
+bool RWLock::begin(){
+    wmutex = xSemaphoreCreateMutex();
+    return wmutex != NULL;
+}
+
+void RWLock::readLock(){
+
+    uint32_t s = state.load(std::memory_order_relaxed);
+
+    //Fast path: no writer, just count ourselves in
+    while(!(s & WRITER)){
+        if(state.compare_exchange_weak(s, s + 1, std::memory_order_acquire))
+            return;
+    }
+
+    //A writer holds or wants the lock. Wait on its mutex (this boosts it),
+    //and while we hold the mutex no writer can be inside, so count ourselves in.
+    slow_reads++;
+    xSemaphoreTake(wmutex, portMAX_DELAY);
+    state.fetch_add(1, std::memory_order_acquire);
+    xSemaphoreGive(wmutex);
+}
+
+void RWLock::readUnlock(){
+
+    uint32_t old = state.fetch_sub(1, std::memory_order_acq_rel);
+
+    //Last reader out while a writer waits: wake it up
+    if(old == (WRITER | 1))
+        xTaskNotifyGive(writer.load(std::memory_order_acquire));
+}
+
+void RWLock::writeLock(){
+
+    xSemaphoreTake(wmutex, portMAX_DELAY);
+
+    writer.store(xTaskGetCurrentTaskHandle(), std::memory_order_release);
+
+    //Same word for the bit and the readers, so the last reader can't miss it
+    uint32_t old = state.fetch_or(WRITER, std::memory_order_acq_rel);
+
+    if((old & ~WRITER) != 0){
+        while((state.load(std::memory_order_acquire) & ~WRITER) != 0)
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    }
+}
+
+void RWLock::writeUnlock(){
+
+    state.fetch_and(~WRITER, std::memory_order_release);
+    writer.store(NULL, std::memory_order_relaxed);
+
+    //Waiting readers and writers are woken by the mutex, highest priority first
+    xSemaphoreGive(wmutex);
+}
@@ -0,0 +1,58 @@
+#ifndef RWLOCK_H_
+#define RWLOCK_H_
+
+#include <Arduino.h>
+#include <atomic>
+
+/*
+    Reader-writer lock, writer preferring
+
+    avgMutex lets only one task at a time look at avg, even if all of them
+    just want to read it. With this lock any number of readers can hold it
+    together, and a writer gets it alone.
+
+        - Readers: if no writer holds or wants the lock, reading is one
+          compare-and-swap, no kernel call at all.
+        - Writers: take an internal FreeRTOS mutex (so writers queue up with
+          priority inheritance between them), raise the WRITER bit so no new
+          reader gets in, and wait for the readers inside to leave.
+        - A reader that finds the WRITER bit blocks on that same FreeRTOS mutex.
+          The kernel then raises the writer's priority to the reader's, so a
+          low priority writer can't keep a high priority reader waiting.
+
+    Writer preferring: as soon as a writer shows up, new readers wait.
+
+    Only for tasks. The writer is woken with a task notification when the
+    last reader leaves, so a writer task shouldn't use notifications for
+    anything else while it's waiting for the lock.
+*/
+
+class RWLock{
+
+public:
+    RWLock();
+    ~RWLock();
+
+    bool begin();
+
+    void readLock();
+    void readUnlock();
+
+    void writeLock();
+    void writeUnlock();
+
+    //How many readLock() calls needed the kernel
+    uint32_t slowReads() const { return slow_reads; }
+    void resetStats(){ slow_reads = 0; }
+
+private:
+    //Lock word: low bits count the readers inside, the top bit is the writer
+    static const uint32_t WRITER = 0x80000000UL;
+
+    std::atomic<uint32_t> state;
+    std::atomic<TaskHandle_t> writer;
+    SemaphoreHandle_t wmutex;
+    std::atomic<uint32_t> slow_reads;
+};
+
+#endif
@@ -0,0 +1,74 @@
+#ifndef SPAWNTASK_H_
+#define SPAWNTASK_H_
+
+#include <Arduino.h>
+#include <new>
+
+/*
+    Start a task with a parameter passed BY VALUE
+
+    Several lessons do this:
+        xTaskCreatePinnedToCore(producer, task_name, 1024, (void *)&i, 1, NULL, app_cpu);
+        xSemaphoreTake(bin_sem, portMAX_DELAY);     //wait until the task copied i
+    because &i points to the creator's stack, and i changes (or dies) as soon
+    as the creator goes on. The semaphore makes the creator wait for every
+    single task to start.
+
+    spawnTask copies the parameter into a small heap block that belongs to the
+    new task. The task copies it onto its own stack, frees the block, and
+    calls our function with it. The creator never waits and no semaphore is
+    needed:
+
+        void producer(const uint8_t &num){ ... }
+        spawnTask(producer, task_name, 1024, i, 1, NULL, app_cpu);
+
+    The parameter can be any copyable type (a number, a struct, a String...).
+    If the function returns, the task deletes itself.
+*/
+
+template <typename P>
+struct spawnBlock{
+    void (*fn)(const P&);
+    P params;
+};
+
+template <typename P>
+void spawnTrampoline(void *arg){
+
+    spawnBlock<P> *block = (spawnBlock<P>*)arg;
+    void (*fn)(const P&) = block->fn;
+
+    {
+        //Our own copy, on our own stack
+        P params(block->params);
+        block->~spawnBlock<P>();
+        vPortFree(block);
+
+        fn(params);
+    }
+
+    vTaskDelete(NULL);
+}
+
+//Same arguments as xTaskCreatePinnedToCore, but params is copied
+template <typename P>
+BaseType_t spawnTask(void (*fn)(const P&), const char *name, uint32_t stack, const P &params,
+                     UBaseType_t priority, TaskHandle_t *handle, BaseType_t core = tskNO_AFFINITY){
+
+    void *mem = pvPortMalloc(sizeof(spawnBlock<P>));
+    if(mem == NULL)
+        return pdFAIL;
+
+    spawnBlock<P> *block = new (mem) spawnBlock<P>{fn, params};
+
+    BaseType_t ret = xTaskCreatePinnedToCore(spawnTrampoline<P>, name, stack, block, priority, handle, core);
+
+    //The task was never created, so the block is still ours
+    if(ret != pdPASS){
+        block->~spawnBlock<P>();
+        vPortFree(block);
+    }
+    return ret;
+}
+
+#endif
@@ -0,0 +1,119 @@
+#ifndef SPSCRING_H_
+#define SPSCRING_H_
+
+#include <Arduino.h>
+#include <atomic>
+
+/*
+    Ring buffer for ONE producer and ONE consumer: SpscRing<T, N>
+
+    The HW interrupt challenges (EigthTest_HWInterrupts_Challenge.cpp,
+    EleventhTest_Challenge.cpp) share circBuf between the ISR and a task
+    with plain rd/wr indexes and a fullFlag:
+        - fullFlag isn't volatile or atomic, and both sides write it:
+          readCircBuf() clears it while the ISR may be setting it
+        - nothing orders the sample write against the index update, so
+          the reader can see the new wr before the sample (in the multicore
+          version the ISR is on core 0 and the reader on core 1)
+
+    Here each index has one writer: the producer only writes head, the
+    consumer only writes tail. Both count up forever and wrap on their own
+    (32 bits), so head - tail is the number of items and there's no need
+    for a full flag: empty is head == tail, full is head - tail == N.
+    The slot is index & (N - 1), which is why N must be a power of 2.
+
+    The order that makes it safe:
+        producer: write the slot, THEN publish head (release)
+        consumer: read head (acquire), THEN read the slot, THEN publish tail
+    so the consumer never sees an index before the data it covers, and the
+    producer never reuses a slot that is still being read.
+
+        static SpscRing<uint16_t, 32> ring;
+        ring.push(analogRead(adc_pin));         //ISR, returns false when full
+        while(ring.pop(&val)) ...               //task
+
+    Never blocks and never calls the kernel, so the producer and the
+    consumer can be any mix of tasks and ISRs, on either core. Wake the
+    consumer with a semaphore or a notification as before.
+*/
+
+template <typename T, uint32_t N>
+class SpscRing{
+
+    static_assert(N >= 2 && (N & (N - 1)) == 0, "SpscRing size must be a power of 2");
+
+public:
+
+    SpscRing() : head(0), tail(0), tail_cache(0), head_cache(0) {}
+
+    //Producer only
+    bool push(const T &item){
+        uint32_t h = head.load(std::memory_order_relaxed);
+        if(h - tail_cache == N){
+            //Looks full with the old tail: read the real one
+            tail_cache = tail.load(std::memory_order_acquire);
+            if(h - tail_cache == N)
+                return false;
+        }
+        buf[h & (N - 1)] = item;
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+    //Producer only: up to n items, returns how many fit. One head update
+    //for all of them.
+    uint32_t pushBlock(const T *items, uint32_t n){
+        uint32_t h = head.load(std::memory_order_relaxed);
+        tail_cache = tail.load(std::memory_order_acquire);
+        uint32_t room = N - (h - tail_cache);
+        if(n > room)
+            n = room;
+        for(uint32_t i = 0; i < n; i++)
+            buf[(h + i) & (N - 1)] = items[i];
+        head.store(h + n, std::memory_order_release);
+        return n;
+    }
+
+    //Consumer only
+    bool pop(T *item){
+        uint32_t t = tail.load(std::memory_order_relaxed);
+        if(t == head_cache){
+            head_cache = head.load(std::memory_order_acquire);
+            if(t == head_cache)
+                return false;
+        }
+        *item = buf[t & (N - 1)];
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    //Consumer only
+    uint32_t popBlock(T *items, uint32_t n){
+        uint32_t t = tail.load(std::memory_order_relaxed);
+        head_cache = head.load(std::memory_order_acquire);
+        uint32_t avail = head_cache - t;
+        if(n > avail)
+            n = avail;
+        for(uint32_t i = 0; i < n; i++)
+            items[i] = buf[(t + i) & (N - 1)];
+        tail.store(t + n, std::memory_order_release);
+        return n;
+    }
+
+    //Exact for the side that calls it, a snapshot for the other one
+    uint32_t size() const {
+        return head.load(std::memory_order_acquire) - tail.load(std::memory_order_acquire);
+    }
+    bool empty() const { return size() == 0; }
+    bool full() const { return size() == N; }
+    static uint32_t capacity(){ return N; }
+
+private:
+    T buf[N];
+    std::atomic<uint32_t> head;             //next slot to write, producer's
+    std::atomic<uint32_t> tail;             //next slot to read, consumer's
+    uint32_t tail_cache;                    //producer's last look at tail
+    uint32_t head_cache;                    //consumer's last look at head
+};
+
+#endif
@@ -0,0 +1,440 @@
+#ifndef STREAMSTATS_H_
+#define STREAMSTATS_H_
+
+#include <Arduino.h>
+
+/*
+    Streaming statistics over a sample stream, O(1) per sample
+
+    The HW interrupt challenges (EigthTest_HWInterrupts_Challenge.cpp,
+    EleventhTest_Challenge.cpp) add 10 samples to avg and divide by 10, but
+    never reset avg, so every "average" carries 1/10 of the previous one.
+    And all you get is that one number.
+
+    Here every sample goes through a few small integer kernels, and each one
+    keeps its own answer up to date:
+        MovingAvg<N>        mean of the last N samples: a running sum, add the
+                            new sample and subtract the one leaving the window
+        Ema<K>              exponential moving average, alpha = 1/2^K, so the
+                            update is a subtract and a shift
+        Welford             mean and variance of everything since reset(),
+                            Welford's update (no sum of squares to cancel out)
+        MinMax<N>           min and max of the last N samples with two monotonic
+                            deques: every sample goes in and out once
+        PercentileSketch<BITS, SHIFT>
+                            a histogram of 2^(BITS - SHIFT) bins, the answer
+                            is within 2^SHIFT counts of the true percentile
+        StreamStats<N>      all of the above, and snapshot() in floats
+
+    Samples are ADC counts, 0 to 32767 (the ESP32 gives 12 bits). The state is
+    fixed point with STATS_Q fraction bits; floats only show up when a result
+    is read. Every kernel has add() for one sample and addBlock() for a
+    buffer (like the blocks of Includes/adcPipeline.h), unrolled by 4.
+
+        static StreamStats<10> stats;
+        stats.add(sample);                      //processing task
+        StatsSnapshot s = stats.snapshot();     //s.mean, s.stddev, s.p99...
+
+    Not thread safe: one task adds, and a mutex if another one reads.
+*/
+
+enum {STATS_Q = 16};                    //fraction bits
+
+template <uint16_t N>
+class MovingAvg{
+
+    static_assert(N > 0, "MovingAvg window can't be empty");
+
+public:
+    MovingAvg(){ reset(); }
+
+    void reset(){
+        memset(win, 0, sizeof(win));
+        pos = 0;
+        count = 0;
+        total = 0;
+    }
+
+    void add(int32_t x){
+        total += x - win[pos];
+        win[pos] = x;
+        if(++pos == N)
+            pos = 0;
+        if(count < N)
+            count++;
+    }
+
+    void addBlock(const uint16_t *x, uint32_t n){
+
+        //Chunks that end at the wrap, so the loop has no test in it
+        while(n > 0){
+            uint32_t chunk = (uint32_t)(N - pos) < n ? (uint32_t)(N - pos) : n;
+            int32_t *w = win + pos;
+            int32_t t = total;
+            uint32_t i = 0;
+            for(; i + 4 <= chunk; i += 4){
+                t += (int32_t)x[i] - w[i];          w[i] = x[i];
+                t += (int32_t)x[i + 1] - w[i + 1];  w[i + 1] = x[i + 1];
+                t += (int32_t)x[i + 2] - w[i + 2];  w[i + 2] = x[i + 2];
+                t += (int32_t)x[i + 3] - w[i + 3];  w[i + 3] = x[i + 3];
+            }
+            for(; i < chunk; i++){
+                t += (int32_t)x[i] - w[i];
+                w[i] = x[i];
+            }
+            total = t;
+            pos += chunk;
+            if(pos == N)
+                pos = 0;
+            count = count + chunk < N ? count + chunk : N;
+            x += chunk;
+            n -= chunk;
+        }
+    }
+
+    int32_t sum() const { return total; }
+    uint16_t size() const { return count; }
+    int32_t meanQ() const { return count ? ((int64_t)total << STATS_Q) / count : 0; }
+    float mean() const { return count ? (float)total / count : 0.0f; }
+
+private:
+    int32_t win[N];
+    uint16_t pos;
+    uint16_t count;                     //N once the window is full
+    int32_t total;                      //32767 * 65535 still fits
+};
+
+template <uint8_t K>
+class Ema{
+
+    static_assert(K > 0 && K < 16, "Ema: alpha = 1/2^K, K from 1 to 15");
+
+public:
+    Ema(){ reset(); }
+
+    void reset(){ state = 0; primed = false; }
+
+    void add(int32_t x){
+        int32_t xq = x << STATS_Q;
+        if(!primed){
+            //Start at the first sample, not at 0
+            state = xq;
+            primed = true;
+        }
+        state += (xq - state) >> K;
+    }
+
+    void addBlock(const uint16_t *x, uint32_t n){
+
+        if(n == 0)
+            return;
+        if(!primed){
+            add(*x++);
+            n--;
+        }
+        //Each step needs the last one: unrolling only saves the loop overhead
+        int32_t s = state;
+        uint32_t i = 0;
+        for(; i + 4 <= n; i += 4){
+            s += (((int32_t)x[i] << STATS_Q) - s) >> K;
+            s += (((int32_t)x[i + 1] << STATS_Q) - s) >> K;
+            s += (((int32_t)x[i + 2] << STATS_Q) - s) >> K;
+            s += (((int32_t)x[i + 3] << STATS_Q) - s) >> K;
+        }
+        for(; i < n; i++)
+            s += (((int32_t)x[i] << STATS_Q) - s) >> K;
+        state = s;
+    }
+
+    int32_t valueQ() const { return state; }
+    float value() const { return (float)state / (1 << STATS_Q); }
+
+private:
+    int32_t state;
+    bool primed;
+};
+
+/*
+    M2 is the sum of squared distances to the mean, in 64 bits with STATS_Q
+    fraction bits: with 12-bit samples that's tens of millions of samples
+    before it could overflow, reset() long before that.
+
+    addBlock() doesn't update per sample: it sums the block (exact, in
+    integers) and merges it with the running values (Chan et al.), so the
+    per-sample work is two adds and a multiply, no division.
+*/
+class Welford{
+
+public:
+    Welford(){ reset(); }
+
+    void reset(){ n = 0; mean_q = 0; m2_q = 0; }
+
+    void add(int32_t x){
+        int32_t xq = x << STATS_Q;
+        n++;
+        int32_t delta = xq - mean_q;
+        mean_q += delta / (int32_t)n;
+        m2_q += ((int64_t)delta * (xq - mean_q)) >> STATS_Q;
+    }
+
+    void addBlock(const uint16_t *x, uint32_t len){
+
+        while(len > 0){
+            //Keeps the block's sum of squares << STATS_Q in 63 bits
+            uint32_t m = len < (uint32_t)BLOCK_MAX ? len : (uint32_t)BLOCK_MAX;
+            uint32_t s0 = 0, s1 = 0;
+            uint64_t q0 = 0, q1 = 0;
+            uint32_t i = 0;
+            for(; i + 4 <= m; i += 4){
+                uint32_t a = x[i], b = x[i + 1], c = x[i + 2], d = x[i + 3];
+                s0 += a + c;
+                s1 += b + d;
+                q0 += a * a + c * c;
+                q1 += b * b + d * d;
+            }
+            for(; i < m; i++){
+                s0 += x[i];
+                q0 += x[i] * x[i];
+            }
+            merge(m, (int64_t)s0 + s1, (int64_t)(q0 + q1));
+            x += m;
+            len -= m;
+        }
+    }
+
+    uint32_t count() const { return n; }
+    int32_t meanQ() const { return mean_q; }
+    int64_t m2Q() const { return m2_q; }
+    float mean() const { return (float)mean_q / (1 << STATS_Q); }
+    float variance() const { return n > 1 ? (float)m2_q / (1 << STATS_Q) / (n - 1) : 0.0f; }
+    float stddev() const { return sqrtf(variance()); }
+
+private:
+    enum {BLOCK_MAX = 4096};
+
+    void merge(uint32_t m, int64_t s, int64_t q){
+
+        //The block on its own: mean, and M2 = sum(x^2) - sum(x)^2 / m
+        int64_t mb_q = (s << STATS_Q) / m;
+        int64_t m2b_q = (q << STATS_Q) - s * mb_q;
+        uint32_t total = n + m;
+        int64_t delta = mb_q - mean_q;
+
+        mean_q += delta * m / total;
+        m2_q += m2b_q + ((delta * delta) >> STATS_Q) * m / total * n;
+        n = total;
+    }
+
+    uint32_t n;
+    int32_t mean_q;
+    int64_t m2_q;
+};
+
+template <uint16_t N>
+class MinMax{
+
+    static_assert(N > 0, "MinMax window can't be empty");
+
+public:
+    MinMax(){ reset(); }
+
+    void reset(){
+        idx = 0;
+        lo.clear();
+        hi.clear();
+    }
+
+    //A sample that is no smaller than a newer one can never be the max
+    //again: it's dropped from the back. The front leaves when it gets old.
+    void add(int32_t x){
+        lo.push(idx, x, false);
+        hi.push(idx, x, true);
+        idx++;
+    }
+
+    void addBlock(const uint16_t *x, uint32_t n){
+        uint32_t i = 0;
+        for(; i + 4 <= n; i += 4){
+            add(x[i]);
+            add(x[i + 1]);
+            add(x[i + 2]);
+            add(x[i + 3]);
+        }
+        for(; i < n; i++)
+            add(x[i]);
+    }
+
+    bool empty() const { return idx == 0; }
+    int32_t min() const { return lo.front(); }
+    int32_t max() const { return hi.front(); }
+
+private:
+    //Ring of at most N (index, value) pairs, values monotonic from the front
+    struct Deque{
+        uint32_t at[N];
+        int32_t val[N];
+        uint16_t head, len;
+
+        void clear(){ head = 0; len = 0; val[0] = 0; }
+
+        int32_t front() const { return val[head]; }
+
+        void push(uint32_t i, int32_t x, bool keep_max){
+            while(len > 0){
+                uint16_t back = head + len - 1 < N ? head + len - 1 : head + len - 1 - N;
+                if(keep_max ? val[back] > x : val[back] < x)
+                    break;
+                len--;
+            }
+            if(len > 0 && i - at[head] >= N){
+                if(++head == N)
+                    head = 0;
+                len--;
+            }
+            uint16_t slot = head + len < N ? head + len : head + len - N;
+            at[slot] = i;
+            val[slot] = x;
+            len++;
+        }
+    };
+
+    uint32_t idx;                       //samples seen, wraps
+    Deque lo, hi;
+};
+
+template <uint8_t BITS, uint8_t SHIFT>
+class PercentileSketch{
+
+    static_assert(BITS <= 15 && SHIFT < BITS, "PercentileSketch: samples up to 15 bits");
+
+public:
+    enum {BINS = 1 << (BITS - SHIFT)};
+
+    PercentileSketch(){ reset(); }
+
+    void reset(){
+        memset(bins, 0, sizeof(bins));
+        n = 0;
+    }
+
+    void add(int32_t x){
+        if(x < 0)
+            x = 0;
+        else if(x >= (1 << BITS))
+            x = (1 << BITS) - 1;
+        bins[x >> SHIFT]++;
+        n++;
+    }
+
+    void addBlock(const uint16_t *x, uint32_t len){
+        uint32_t i = 0;
+        for(; i + 4 <= len; i += 4){
+            add(x[i]);
+            add(x[i + 1]);
+            add(x[i + 2]);
+            add(x[i + 3]);
+        }
+        for(; i < len; i++)
+            add(x[i]);
+    }
+
+    //p from 0 to 100: the middle of the bin where the p% of the samples
+    //is reached. O(BINS), for reading only.
+    int32_t percentile(uint8_t p) const {
+
+        if(n == 0)
+            return 0;
+        uint64_t target = ((uint64_t)n * p + 99) / 100;
+        if(target == 0)
+            target = 1;
+        uint32_t seen = 0;
+        for(uint32_t b = 0; b < BINS; b++){
+            seen += bins[b];
+            if(seen >= target)
+                return (b << SHIFT) + ((1 << SHIFT) >> 1);
+        }
+        return (1 << BITS) - 1;
+    }
+
+    //Old samples count half: call it every so often to follow a drifting
+    //signal instead of everything since reset()
+    void halve(){
+        n = 0;
+        for(uint32_t b = 0; b < BINS; b++){
+            bins[b] >>= 1;
+            n += bins[b];
+        }
+    }
+
+    uint32_t count() const { return n; }
+
+private:
+    uint32_t bins[BINS];
+    uint32_t n;
+};
+
+struct StatsSnapshot{
+    uint32_t count;                     //since reset()
+    float mean;                         //last N samples
+    float ema;
+    float total_mean;                   //since reset()
+    float stddev;                       //since reset()
+    int32_t min, max;                   //last N samples
+    int32_t p50, p90, p99;              //since reset() (or halve())
+};
+
+//N: window of the moving average and the min/max. EMA alpha = 1/2^K.
+//Percentiles of 12-bit samples, within 16 counts.
+template <uint16_t N, uint8_t K = 3, uint8_t BITS = 12, uint8_t SHIFT = 4>
+class StreamStats{
+
+public:
+    void reset(){
+        window.reset();
+        ema.reset();
+        welford.reset();
+        minmax.reset();
+        pct.reset();
+    }
+
+    void add(int32_t x){
+        window.add(x);
+        ema.add(x);
+        welford.add(x);
+        minmax.add(x);
+        pct.add(x);
+    }
+
+    //Kernel by kernel, so each one keeps its state in registers
+    void addBlock(const uint16_t *x, uint32_t n){
+        window.addBlock(x, n);
+        ema.addBlock(x, n);
+        welford.addBlock(x, n);
+        minmax.addBlock(x, n);
+        pct.addBlock(x, n);
+    }
+
+    StatsSnapshot snapshot() const {
+        StatsSnapshot s;
+        s.count = welford.count();
+        s.mean = window.mean();
+        s.ema = ema.value();
+        s.total_mean = welford.mean();
+        s.stddev = welford.stddev();
+        s.min = minmax.empty() ? 0 : minmax.min();
+        s.max = minmax.empty() ? 0 : minmax.max();
+        s.p50 = pct.percentile(50);
+        s.p90 = pct.percentile(90);
+        s.p99 = pct.percentile(99);
+        return s;
+    }
+
+    MovingAvg<N> window;
+    Ema<K> ema;
+    Welford welford;
+    MinMax<N> minmax;
+    PercentileSketch<BITS, SHIFT> pct;
+};
+
+#endif
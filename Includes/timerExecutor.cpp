@@ -0,0 +1,175 @@
+#include <Arduino.h>
+#include <timerExecutor.h>
+
+static const UBaseType_t idle_prio = configMAX_PRIORITIES - 1;
+
+bool TimerExecutor::begin(uint8_t workers, uint32_t stack, BaseType_t core){
+
+    if(!jobs.begin())
+        return false;
+
+    for(uint8_t i = 0; i < workers; i++)
+        if(xTaskCreatePinnedToCore(workerTask, "TimerWorker", stack, this, idle_prio, NULL, core) != pdPASS)
+            return false;
+    return true;
+}
+
+TimerHandle_t TimerExecutor::create(const char *name, TickType_t period, UBaseType_t auto_reload, void *id,
+                                    TimerCallbackFunction_t callback, UBaseType_t priority){
+
+    Entry *e = (Entry*)pvPortMalloc(sizeof(Entry));
+    if(e == NULL)
+        return NULL;
+
+    e->exec = this;
+    e->callback = callback;
+    e->id = id;
+    //Lower than idle_prio, or the worker wouldn't give the CPU back
+    e->priority = (priority == EXEC_FAST || priority < idle_prio) ? priority : idle_prio - 1;
+    memset(&e->stats, 0, sizeof(e->stats));
+    e->pending = 0;
+    e->deleted = false;
+    e->retired = false;
+
+    TimerHandle_t timer = xTimerCreate(name, period, auto_reload, e, expired);
+    if(timer == NULL)
+        vPortFree(e);
+    return timer;
+}
+
+void TimerExecutor::destroy(TimerHandle_t timer){
+
+    Entry *e = entry(timer);
+
+    //From here on, its jobs are skipped
+    portENTER_CRITICAL(&lock);
+    e->deleted = true;
+    portEXIT_CRITICAL(&lock);
+
+    //The daemon runs the commands in order: when retire() runs, the timer
+    //is gone and expired() won't be called for it again
+    xTimerDelete(timer, portMAX_DELAY);
+    xTimerPendFunctionCall(retire, e, 0, portMAX_DELAY);
+}
+
+//Runs in the timer daemon. The last job frees the entry if any are left.
+void TimerExecutor::retire(void *param1, uint32_t param2){
+
+    Entry *e = (Entry*)param1;
+    portENTER_CRITICAL(&e->exec->lock);
+    e->retired = true;
+    bool unused = e->pending == 0;
+    portEXIT_CRITICAL(&e->exec->lock);
+
+    if(unused)
+        vPortFree(e);
+}
+
+//True if it was the last job of a retired entry: free it
+bool TimerExecutor::jobDone(Entry *e){
+    portENTER_CRITICAL(&lock);
+    bool last = --e->pending == 0 && e->retired;
+    portEXIT_CRITICAL(&lock);
+    return last;
+}
+
+void *TimerExecutor::getID(TimerHandle_t timer){
+    return entry(timer)->id;
+}
+
+void TimerExecutor::setID(TimerHandle_t timer, void *id){
+    entry(timer)->id = id;
+}
+
+ExecStats TimerExecutor::stats(TimerHandle_t timer){
+    ExecStats s;
+    portENTER_CRITICAL(&lock);
+    s = entry(timer)->stats;
+    portEXIT_CRITICAL(&lock);
+    return s;
+}
+
+void TimerExecutor::resetStats(TimerHandle_t timer){
+    portENTER_CRITICAL(&lock);
+    memset(&entry(timer)->stats, 0, sizeof(ExecStats));
+    portEXIT_CRITICAL(&lock);
+}
+
+void TimerExecutor::account(Entry *e, uint32_t wait_us, uint32_t run_us){
+    portENTER_CRITICAL(&lock);
+    ExecStats &s = e->stats;
+    s.runs++;
+    s.wait_sum_us += wait_us;
+    s.run_sum_us += run_us;
+    if(wait_us > s.wait_max_us)
+        s.wait_max_us = wait_us;
+    if(run_us > s.run_max_us)
+        s.run_max_us = run_us;
+    portEXIT_CRITICAL(&lock);
+}
+
+//Runs in the timer daemon
+void TimerExecutor::expired(TimerHandle_t timer){
+
+    Entry *e = entry(timer);
+    TimerExecutor *exec = e->exec;
+    uint32_t now = micros();
+
+    portENTER_CRITICAL(&exec->lock);
+    bool deleted = e->deleted;
+    if(!deleted && e->priority != EXEC_FAST)
+        e->pending++;
+    portEXIT_CRITICAL(&exec->lock);
+
+    //Expired while destroy() was waiting for the daemon
+    if(deleted)
+        return;
+
+    if(e->priority == EXEC_FAST){
+        e->callback(timer);
+        exec->account(e, 0, micros() - now);
+        return;
+    }
+
+    //Rank 0 comes out first: the highest priority
+    Job job = {timer, e, now};
+    if(exec->jobs.send(job, idle_prio - e->priority, 0) != pdTRUE){
+        portENTER_CRITICAL(&exec->lock);
+        e->stats.dropped++;
+        e->pending--;
+        portEXIT_CRITICAL(&exec->lock);
+    }
+}
+
+void TimerExecutor::workerTask(void *parameters){
+    ((TimerExecutor*)parameters)->runWorker();
+}
+
+void TimerExecutor::runWorker(){
+
+    Job job;
+
+    while(1){
+        jobs.receive(&job, portMAX_DELAY);
+        Entry *e = job.e;
+
+        portENTER_CRITICAL(&lock);
+        bool deleted = e->deleted;
+        portEXIT_CRITICAL(&lock);
+
+        if(!deleted){
+            //May be preempted right here by anything above the job's priority:
+            //that's part of the wait
+            vTaskPrioritySet(NULL, e->priority);
+            uint32_t start = micros();
+            e->callback(job.timer);
+            uint32_t end = micros();
+            vTaskPrioritySet(NULL, idle_prio);
+
+            account(e, start - job.expired_us, end - start);
+        }
+
+        if(jobDone(e))
+            vPortFree(e);
+    }
+}
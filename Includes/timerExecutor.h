@@ -0,0 +1,104 @@
+#ifndef TIMEREXECUTOR_H_
+#define TIMEREXECUTOR_H_
+
+#include <Arduino.h>
+#include <prioQueue.h>
+
+/*
+    Timer callbacks out of the timer daemon
+
+    Every software timer callback runs in the timer daemon, one after the
+    other. If one of them is slow (myTimerCallback in SeventhTest_SWTimers.cpp
+    does a Serial.println, which blocks when the UART buffer is full), every
+    timer that expires meanwhile waits for it.
+
+    TimerExecutor creates normal FreeRTOS timers (start/stop/reset them with
+    the usual xTimer* calls), but their daemon callback only decides where
+    the real callback runs:
+        - EXEC_FAST: right there in the daemon, like a normal timer. For
+          callbacks that only set a flag, give a semaphore...
+        - a priority: the callback goes to a pool of worker tasks through a
+          PrioQueue (Includes/prioQueue.h), and a worker runs it at that
+          priority. The daemon is free again right away.
+
+        static TimerExecutor exec;
+        exec.begin(2);                                  //2 workers
+        TimerHandle_t t = exec.create("Slow", 1000 / portTICK_PERIOD_MS, pdTRUE, (void*)1, myTimerCallback, 1);
+        xTimerStart(t, portMAX_DELAY);
+
+    The timer's ID belongs to the executor: use TimerExecutor::getID/setID
+    instead of pvTimerGetTimerID/vTimerSetTimerID, and destroy() instead of
+    xTimerDelete. destroy() deletes the timer and skips the jobs it still
+    has in the queue; a callback already running in a worker finishes, but
+    must not use its handle after that.
+
+    For every timer the executor counts how long callbacks waited for a
+    worker (from the expiry) and how long they ran, in us. If the queue is
+    full the expiry is dropped (the daemon must not block) and counted.
+    Pooled callbacks of the same timer can overlap if it expires again
+    before the last one finished.
+*/
+
+struct ExecStats{
+    uint32_t runs;
+    uint32_t dropped;                       //queue full
+    uint32_t wait_max_us;
+    uint32_t run_max_us;
+    uint64_t wait_sum_us;
+    uint64_t run_sum_us;
+};
+
+class TimerExecutor{
+
+public:
+    enum {QUEUE_LEN = 32};
+    static const UBaseType_t EXEC_FAST = ~(UBaseType_t)0;
+
+    //Workers wait for jobs at the highest priority, so they pick them up
+    //right away, then drop to the job's priority to run it
+    bool begin(uint8_t workers = 2, uint32_t stack = 4096, BaseType_t core = tskNO_AFFINITY);
+
+    //Like xTimerCreate. priority: EXEC_FAST or the workers' priority for this callback.
+    TimerHandle_t create(const char *name, TickType_t period, UBaseType_t auto_reload, void *id,
+                         TimerCallbackFunction_t callback, UBaseType_t priority);
+    //Like xTimerDelete(timer, portMAX_DELAY), so not from an EXEC_FAST callback
+    void destroy(TimerHandle_t timer);
+
+    static void *getID(TimerHandle_t timer);
+    static void setID(TimerHandle_t timer, void *id);
+
+    ExecStats stats(TimerHandle_t timer);
+    void resetStats(TimerHandle_t timer);
+
+private:
+    struct Entry{
+        TimerExecutor *exec;
+        TimerCallbackFunction_t callback;
+        void *id;
+        UBaseType_t priority;
+        ExecStats stats;
+        uint32_t pending;                   //jobs queued or running
+        bool deleted;                       //destroy() called: skip its jobs
+        bool retired;                       //the daemon is done with it too
+    };
+
+    //The entry travels with the job: the handle may be gone when it runs
+    struct Job{
+        TimerHandle_t timer;
+        Entry *e;
+        uint32_t expired_us;
+    };
+
+    static Entry *entry(TimerHandle_t timer){ return (Entry*)pvTimerGetTimerID(timer); }
+    static void expired(TimerHandle_t timer);
+    static void retire(void *param1, uint32_t param2);
+    bool jobDone(Entry *e);
+    static void workerTask(void *parameters);
+    void runWorker();
+    void account(Entry *e, uint32_t wait_us, uint32_t run_us);
+
+    PrioQueue<Job, QUEUE_LEN> jobs;
+    portMUX_TYPE lock = portMUX_INITIALIZER_UNLOCKED;     //stats
+};
+
+#endif
@@ -0,0 +1,310 @@
+#include <Arduino.h>
+#include <timerWheel.h>
+
+//************************************************************
+//Lists (call with the lock taken)
+
+static void listInit(WheelLink *head){
+    head->next = head->prev = head;
+}
+
+static bool listEmpty(const WheelLink *head){
+    return head->next == head;
+}
+
+TimerWheel::TimerWheel(){
+    for(uint8_t l = 0; l < LEVELS; l++)
+        for(uint8_t s = 0; s < SLOTS; s++)
+            listInit(&wheel[l][s]);
+    occupied = 0;
+    wheel_now = 0;
+    planned_wake = 0;
+    active = 0;
+    wakes = 0;
+    busy = moved = cascade_cycles = 0;
+    sleeping = false;
+    advancing = false;
+    task = NULL;
+}
+
+//Files the timer by how far away it is: level 0 for the next 64 ticks,
+//level 1 for the next 64*64...
+void TimerWheel::insert(WheelTimer *t){
+
+    TickType_t when = t->expires;
+    int32_t delta = (int32_t)(when - wheel_now);
+    uint8_t level;
+
+    if(delta < 0){
+        //Already late: the next tick to be processed
+        when = wheel_now;
+        level = 0;
+    }
+    else if(delta < (1L << SLOT_BITS))
+        level = 0;
+    else if(delta < (1L << (2 * SLOT_BITS)))
+        level = 1;
+    else if(delta < (1L << (3 * SLOT_BITS)))
+        level = 2;
+    else{
+        level = 3;
+        //Further than the wheels reach: park it as far as possible, it will
+        //be filed again when that slot cascades
+        if(delta >= (1L << (4 * SLOT_BITS)))
+            when = wheel_now + (1L << (4 * SLOT_BITS)) - 1;
+    }
+
+    uint8_t slot = (when >> (level * SLOT_BITS)) & (SLOTS - 1);
+    WheelLink *head = &wheel[level][slot];
+
+    t->link.next = head;
+    t->link.prev = head->prev;
+    head->prev->next = &t->link;
+    head->prev = &t->link;
+    t->level = level;
+    t->slot = slot;
+    if(level == 0)
+        occupied |= 1ULL << slot;
+}
+
+void TimerWheel::unlink(WheelTimer *t){
+    t->link.prev->next = t->link.next;
+    t->link.next->prev = t->link.prev;
+    if(t->level == 0 && listEmpty(&wheel[0][t->slot]))
+        occupied &= ~(1ULL << t->slot);
+}
+
+//Spreads the current slot of a level over the finer levels. A slot can
+//hold thousands of timers: the lock is let go every CASCADE_BATCH of them,
+//so interrupts on this core and the other core's start/stop can get in.
+//Whatever they file can't land in this slot again (it is at least one
+//slot of this level away), so the loop still ends.
+void TimerWheel::cascade(uint8_t level){
+
+    WheelLink *head = &wheel[level][(wheel_now >> (level * SLOT_BITS)) & (SLOTS - 1)];
+    uint32_t n = 0, t0 = ESP.getCycleCount();
+
+    while(!listEmpty(head)){
+        WheelTimer *t = (WheelTimer*)head->next;
+        unlink(t);
+        insert(t);
+        if(++n % CASCADE_BATCH == 0){
+            portEXIT_CRITICAL(&lock);
+            portENTER_CRITICAL(&lock);
+        }
+    }
+    moved += n;
+    cascade_cycles += ESP.getCycleCount() - t0;
+}
+
+//First tick from wheel_now that has work: a level 0 slot with timers, or
+//the hand of level 0 going round (cascade)
+TickType_t TimerWheel::nextEvent(){
+
+    uint8_t pos = wheel_now & (SLOTS - 1);
+    uint32_t to_cascade = pos ? SLOTS - pos : 0;
+    uint64_t ahead = pos ? (occupied >> pos) | (occupied << (SLOTS - pos)) : occupied;
+    uint32_t k = ahead ? __builtin_ctzll(ahead) : SLOTS;
+
+    return wheel_now + (k < to_cascade ? k : to_cascade);
+}
+
+//Runs every tick up to now. Callbacks are called without the lock, and
+//while they run arm() must leave the hand alone (advancing).
+void TimerWheel::advance(TickType_t now){
+
+    portENTER_CRITICAL(&lock);
+    advancing = true;
+
+    while(1){
+        //Jump over the ticks with nothing to do. The hand never goes back.
+        TickType_t next = nextEvent();
+        if((int32_t)(next - now) > 0){
+            if((int32_t)(now + 1 - wheel_now) > 0)
+                wheel_now = now + 1;
+            break;
+        }
+        wheel_now = next;
+
+        if((wheel_now & (SLOTS - 1)) == 0){
+            //Each level only cascades when the one below went round
+            cascade(1);
+            if(((wheel_now >> SLOT_BITS) & (SLOTS - 1)) == 0){
+                cascade(2);
+                if(((wheel_now >> (2 * SLOT_BITS)) & (SLOTS - 1)) == 0)
+                    cascade(3);
+            }
+        }
+
+        //Everything in this slot expires now (or is late)
+        WheelLink *head = &wheel[0][wheel_now & (SLOTS - 1)];
+        while(!listEmpty(head)){
+            WheelTimer *t = (WheelTimer*)head->next;
+            unlink(t);
+            //Not due yet (filed from the hand at another time): file it again,
+            //it can't come back to this slot
+            if((int32_t)(t->expires - wheel_now) > 0){
+                insert(t);
+                continue;
+            }
+            if(t->auto_reload){
+                //From the expected time, not from now, so it doesn't drift
+                t->expires += t->period;
+                insert(t);
+            }
+            else{
+                t->active = false;
+                active--;
+            }
+
+            WheelTimerCallback callback = t->callback;
+            portEXIT_CRITICAL(&lock);
+            callback((TimerHandle_t)t);
+            portENTER_CRITICAL(&lock);
+        }
+
+        wheel_now++;
+    }
+
+    advancing = false;
+    portEXIT_CRITICAL(&lock);
+}
+
+//************************************************************
+//Timer task
+
+void TimerWheel::serviceTask(void *parameters){
+    ((TimerWheel*)parameters)->run();
+}
+
+void TimerWheel::run(){
+
+    while(1){
+        portENTER_CRITICAL(&lock);
+        if(active == 0){
+            sleeping = true;
+            portEXIT_CRITICAL(&lock);
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+            continue;
+        }
+        TickType_t next = nextEvent();
+        TickType_t now = xTaskGetTickCount();
+        planned_wake = next;
+        portEXIT_CRITICAL(&lock);
+
+        //Sleep until there's something to do, or a timer that expires
+        //sooner is started
+        if((int32_t)(next - now) > 0){
+            ulTaskNotifyTake(pdTRUE, next - now);
+            continue;
+        }
+
+        wakes++;
+        uint32_t t0 = ESP.getCycleCount();
+        advance(now);
+        busy += ESP.getCycleCount() - t0;
+    }
+}
+
+bool TimerWheel::begin(UBaseType_t priority, uint32_t stack, BaseType_t core){
+    return xTaskCreatePinnedToCore(serviceTask, "TimerWheel", stack, this, priority, &task, core) == pdPASS;
+}
+
+//************************************************************
+//Timers
+
+WheelTimerHandle TimerWheel::create(const char *name, TickType_t period, UBaseType_t auto_reload,
+                                    void *id, WheelTimerCallback callback){
+    WheelTimer *t = (WheelTimer*)pvPortMalloc(sizeof(WheelTimer));
+    if(t != NULL)
+        init(t, name, period, auto_reload, id, callback);
+    return t;
+}
+
+void TimerWheel::init(WheelTimer *t, const char *name, TickType_t period, UBaseType_t auto_reload,
+                      void *id, WheelTimerCallback callback){
+    t->link.next = t->link.prev = NULL;
+    t->expires = 0;
+    t->period = period ? period : 1;
+    t->callback = callback;
+    t->id = id;
+    t->level = t->slot = 0;
+    t->auto_reload = auto_reload;
+    t->active = false;
+}
+
+void TimerWheel::destroy(WheelTimerHandle t){
+    stop(t);
+    vPortFree(t);
+}
+
+//Files the timer from now. Returns true if the task has to look at it
+//sooner than it planned. Lock taken.
+bool TimerWheel::arm(WheelTimer *t, TickType_t now){
+
+    if(t->active)
+        unlink(t);
+    else{
+        //Empty wheel: the hand can jump to now, there's nothing to skip.
+        //Not while advance() is in a callback: it still has to go through
+        //the ticks up to its own (older) now.
+        if(active == 0 && !advancing)
+            wheel_now = now;
+        t->active = true;
+        active++;
+    }
+    t->expires = now + t->period;
+    insert(t);
+
+    bool wake = sleeping || (int32_t)(t->expires - planned_wake) < 0;
+    sleeping = false;
+    return wake;
+}
+
+void TimerWheel::start(WheelTimerHandle t){
+
+    portENTER_CRITICAL(&lock);
+    bool wake = arm(t, xTaskGetTickCount());
+    portEXIT_CRITICAL(&lock);
+
+    if(wake && task != NULL)
+        xTaskNotifyGive(task);
+}
+
+void TimerWheel::startFromISR(WheelTimerHandle t, BaseType_t *task_woken){
+
+    portENTER_CRITICAL_ISR(&lock);
+    bool wake = arm(t, xTaskGetTickCountFromISR());
+    portEXIT_CRITICAL_ISR(&lock);
+
+    if(wake && task != NULL)
+        vTaskNotifyGiveFromISR(task, task_woken);
+}
+
+void TimerWheel::changePeriod(WheelTimerHandle t, TickType_t period){
+    portENTER_CRITICAL(&lock);
+    t->period = period ? period : 1;
+    portEXIT_CRITICAL(&lock);
+    start(t);
+}
+
+//No need to wake the task: at worst it wakes up for nothing
+void TimerWheel::stop(WheelTimerHandle t){
+    portENTER_CRITICAL(&lock);
+    if(t->active){
+        unlink(t);
+        t->active = false;
+        active--;
+    }
+    portEXIT_CRITICAL(&lock);
+}
+
+void TimerWheel::stopFromISR(WheelTimerHandle t){
+    portENTER_CRITICAL_ISR(&lock);
+    if(t->active){
+        unlink(t);
+        t->active = false;
+        active--;
+    }
+    portEXIT_CRITICAL_ISR(&lock);
+}
@@ -0,0 +1,141 @@
+#ifndef TIMERWHEEL_H_
+#define TIMERWHEEL_H_
+
+#include <Arduino.h>
+
+/*
+    Software timers on a hierarchical timing wheel
+
+    The FreeRTOS timer daemon (SeventhTest_SWTimers.cpp) keeps the active
+    timers in a list sorted by expiry time, so starting or resetting a timer
+    walks that list: O(n) with n active timers. With thousands of timeouts
+    (one per connection, one per LED...) that adds up.
+
+    A timing wheel is like a clock face: 64 slots, one per tick, and a timer
+    that expires in 5 ticks goes in the slot 5 places ahead of the hand. No
+    sorting, so start/stop/reset are O(1). Timers further away than 64 ticks
+    go to a coarser wheel (64 slots of 64 ticks), and so on for 4 levels
+    (64^4 ticks, ~4.6 hours at 1 ms per tick; longer timers just wait on the
+    last level and are re-filed). When the hand of a wheel goes round, the
+    next slot of the coarser wheel is spread over the finer one ("cascade").
+
+    Same idea and units as xTimer*: periods in ticks, one-shot or auto-reload,
+    an ID, and the same callback as the daemon's, myTimerCallback(TimerHandle_t).
+    The handle it gets is the wheel timer, so use the wheel's functions on it
+    (they all take a TimerHandle_t too), not the xTimer ones:
+
+        void myTimerCallback(TimerHandle_t timer){
+            if((uint32_t)wheel.getID(timer) == 1) ...
+        }
+        static TimerWheel wheel;
+        wheel.begin();
+        WheelTimerHandle t = wheel.create("LED", 500 / portTICK_PERIOD_MS, pdTRUE, (void*)1, myTimerCallback);
+        wheel.start(t);
+
+    Differences with the daemon:
+        - No command queue. start/stop/reset take a spinlock for a few
+          instructions and are done when they return, from any core, and
+          never block (so no ticks_to_wait argument). ISRs use the FromISR ones.
+        - Callbacks run in the wheel's own task, so they must be short and
+          never block, exactly like timer daemon callbacks.
+*/
+
+class TimerWheel;
+struct WheelTimer;
+
+typedef WheelTimer *WheelTimerHandle;
+typedef TimerCallbackFunction_t WheelTimerCallback;
+
+struct WheelLink{
+    WheelLink *next, *prev;
+};
+
+//Use create() or init() to fill it. 28 bytes: no name, it's only taken to
+//match xTimerCreate.
+struct WheelTimer{
+    WheelLink link;                         //first, so a link is also its timer
+    TickType_t expires;
+    TickType_t period;
+    WheelTimerCallback callback;
+    void *id;
+    uint8_t level, slot;
+    bool auto_reload;
+    bool active;
+};
+
+class TimerWheel{
+
+public:
+    enum {LEVELS = 4, SLOT_BITS = 6, SLOTS = 1 << SLOT_BITS};
+
+    TimerWheel();
+
+    bool begin(UBaseType_t priority = configMAX_PRIORITIES - 1, uint32_t stack = 4096,
+               BaseType_t core = tskNO_AFFINITY);
+
+    //Like xTimerCreate (heap) and xTimerCreateStatic (your own WheelTimer)
+    WheelTimerHandle create(const char *name, TickType_t period, UBaseType_t auto_reload,
+                            void *id, WheelTimerCallback callback);
+    void init(WheelTimer *timer, const char *name, TickType_t period, UBaseType_t auto_reload,
+              void *id, WheelTimerCallback callback);
+    void destroy(WheelTimerHandle timer);   //only for create()d timers
+
+    //Starting an active timer restarts it, like xTimerStart
+    void start(WheelTimerHandle timer);
+    void reset(WheelTimerHandle timer){ start(timer); }
+    void stop(WheelTimerHandle timer);
+    void changePeriod(WheelTimerHandle timer, TickType_t period);   //and starts it
+
+    void startFromISR(WheelTimerHandle timer, BaseType_t *task_woken);
+    void stopFromISR(WheelTimerHandle timer);
+
+    bool isActive(WheelTimerHandle timer) const { return timer->active; }
+    static void *getID(WheelTimerHandle timer){ return timer->id; }
+    static void setID(WheelTimerHandle timer, void *id){ timer->id = id; }
+    static TickType_t getPeriod(WheelTimerHandle timer){ return timer->period; }
+    static TickType_t getExpiryTime(WheelTimerHandle timer){ return timer->expires; }
+
+    //The same, with the handle a callback gets
+    static WheelTimerHandle handle(TimerHandle_t timer){ return (WheelTimerHandle)timer; }
+    void start(TimerHandle_t timer){ start(handle(timer)); }
+    void reset(TimerHandle_t timer){ start(handle(timer)); }
+    void stop(TimerHandle_t timer){ stop(handle(timer)); }
+    void changePeriod(TimerHandle_t timer, TickType_t period){ changePeriod(handle(timer), period); }
+    bool isActive(TimerHandle_t timer) const { return handle(timer)->active; }
+    static void *getID(TimerHandle_t timer){ return handle(timer)->id; }
+    static void setID(TimerHandle_t timer, void *id){ handle(timer)->id = id; }
+    static TickType_t getPeriod(TimerHandle_t timer){ return handle(timer)->period; }
+    static TickType_t getExpiryTime(TimerHandle_t timer){ return handle(timer)->expires; }
+
+    uint32_t activeTimers() const { return active; }
+    uint32_t wakeups() const { return wakes; }      //times the wheel task ran
+    uint32_t busyCycles() const { return busy; }    //in the wheel task, callbacks included
+    uint32_t cascaded() const { return moved; }     //timers re-filed by cascades
+    uint32_t cascadeCycles() const { return cascade_cycles; }
+
+private:
+    enum {CASCADE_BATCH = 32};             //timers re-filed per critical section
+
+    static void serviceTask(void *parameters);
+    void run();
+    void advance(TickType_t now);
+    void insert(WheelTimer *t);
+    void unlink(WheelTimer *t);
+    void cascade(uint8_t level);
+    TickType_t nextEvent();
+    bool arm(WheelTimer *t, TickType_t now);
+
+    WheelLink wheel[LEVELS][SLOTS];         //list heads, empty when pointing to themselves
+    uint64_t occupied;                      //level 0 slots with timers, for nextEvent()
+    TickType_t wheel_now;                   //next tick to process
+    TickType_t planned_wake;                //when the task will look again
+    uint32_t active;
+    uint32_t wakes;
+    uint32_t busy, moved, cascade_cycles;
+    bool sleeping;                          //task waiting for a timer to start
+    bool advancing;                         //advance() running, maybe in a callback
+    TaskHandle_t task;
+    portMUX_TYPE lock = portMUX_INITIALIZER_UNLOCKED;
+};
+
+#endif
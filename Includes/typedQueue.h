@@ -0,0 +1,175 @@
+#ifndef TYPEDQUEUE_H_
+#define TYPEDQUEUE_H_
+
+#include <Arduino.h>
+#include <new>
+#include <utility>
+
+/*
+    Type-safe queue with static storage: Queue<T, N>
+
+    With the kernel queue every call looks like
+        queue2 = xQueueCreate(msg_queue_len, sizeof(blink));
+        xQueueSend(queue2, (void*)&b, 10);
+    nothing stops us from sending a uint16_t into a queue of blinks, and
+    the message is built in a local variable and then copied into the queue
+    (and copied out again on the other side).
+
+    Queue<blink, 5> knows its element type, so the compiler checks it, and
+    the storage for the N elements lives inside the object. It also has:
+        - emplace(ticks, args...): builds the element directly in its slot
+        - produce(ticks, fn):      same, but fn(T&) fills in the slot (handy for
+                                   C structs with char arrays, like blink)
+        - consume(ticks, fn):      calls fn(T&) with the element still in its
+                                   slot, then destroys it
+    so a message can go from producer to consumer without being copied.
+
+    Any number of tasks can send, but only ONE task may receive/consume from
+    a given queue: the consumer works on its slot without holding the lock.
+    Producers only take the spinlock to claim a slot and to publish it, and
+    build the element in between, so constructors and produce() functions
+    run with interrupts on and can take as long as they need. A slot that
+    is finished before the ones claimed earlier waits for them: the
+    consumer gets the elements in the order the slots were claimed.
+*/
+
+template <typename T, uint16_t N>
+class Queue{
+
+public:
+
+    Queue(){
+        head = tail = published = 0;
+        memset(ready, 0, sizeof(ready));
+        items = spaces = NULL;
+    }
+
+    ~Queue(){
+        //Destroy whatever is still waiting
+        while(items != NULL && xSemaphoreTake(items, 0) == pdTRUE){
+            slot(tail)->~T();
+            tail = (tail + 1) % N;
+        }
+    }
+
+    Queue(const Queue&) = delete;
+    Queue& operator=(const Queue&) = delete;
+
+    bool begin(){
+        items = xSemaphoreCreateCountingStatic(N, 0, &items_buf);
+        spaces = xSemaphoreCreateCountingStatic(N, N, &spaces_buf);
+        return items != NULL && spaces != NULL;
+    }
+
+    //Build the element in its slot from the constructor (or aggregate) arguments
+    template <typename... Args>
+    BaseType_t emplace(TickType_t ticks, Args&&... args){
+
+        if(xSemaphoreTake(spaces, ticks) != pdTRUE)
+            return pdFALSE;
+
+        uint16_t i = claim();
+        new (slot(i)) T{std::forward<Args>(args)...};
+        for(uint16_t n = publish(i); n > 0; n--)
+            xSemaphoreGive(items);
+        return pdTRUE;
+    }
+
+    //fn(T&) fills in a value-initialized element in its slot
+    template <typename Fn>
+    BaseType_t produce(TickType_t ticks, Fn fn){
+
+        if(xSemaphoreTake(spaces, ticks) != pdTRUE)
+            return pdFALSE;
+
+        uint16_t i = claim();
+        fn(*new (slot(i)) T());
+        for(uint16_t n = publish(i); n > 0; n--)
+            xSemaphoreGive(items);
+        return pdTRUE;
+    }
+
+    //Same as xQueueSend: one copy into the slot
+    BaseType_t send(const T &item, TickType_t ticks){
+        return emplace(ticks, item);
+    }
+
+    BaseType_t sendFromISR(const T &item, BaseType_t *task_woken){
+
+        if(xSemaphoreTakeFromISR(spaces, task_woken) != pdTRUE)
+            return pdFALSE;
+
+        uint16_t i = claim();
+        new (slot(i)) T(item);
+        for(uint16_t n = publish(i); n > 0; n--)
+            xSemaphoreGiveFromISR(items, task_woken);
+        return pdTRUE;
+    }
+
+    //fn gets the element by reference while it's still in the queue
+    template <typename Fn>
+    BaseType_t consume(TickType_t ticks, Fn fn){
+
+        if(xSemaphoreTake(items, ticks) != pdTRUE)
+            return pdFALSE;
+
+        //Producers won't touch this slot until "spaces" is given back
+        T *p = slot(tail);
+        fn(*p);
+        p->~T();
+        tail = (tail + 1) % N;
+
+        xSemaphoreGive(spaces);
+        return pdTRUE;
+    }
+
+    //Same as xQueueReceive: one copy out of the slot
+    BaseType_t receive(T *item, TickType_t ticks){
+        return consume(ticks, [item](T &t){ *item = std::move(t); });
+    }
+
+    UBaseType_t waiting(){
+        return uxSemaphoreGetCount(items);
+    }
+
+private:
+
+    T *slot(uint16_t i){
+        return reinterpret_cast<T*>(storage) + i;
+    }
+
+    //A free slot is guaranteed by "spaces", this only picks which one
+    uint16_t claim(){
+        portENTER_CRITICAL_SAFE(&lock);
+        uint16_t i = head;
+        head = (head + 1) % N;
+        portEXIT_CRITICAL_SAFE(&lock);
+        return i;
+    }
+
+    //Marks slot i as built and moves "published" over every built slot in
+    //a row from there. Returns how many, to give "items" that many times.
+    uint16_t publish(uint16_t i){
+        uint16_t n = 0;
+        portENTER_CRITICAL_SAFE(&lock);
+        ready[i] = true;
+        while(ready[published]){
+            ready[published] = false;
+            published = (published + 1) % N;
+            n++;
+        }
+        portEXIT_CRITICAL_SAFE(&lock);
+        return n;
+    }
+
+    alignas(T) uint8_t storage[N * sizeof(T)];
+    uint16_t head, tail;
+    uint16_t published;                 //slots before it were given to "items"
+    bool ready[N];                      //built, waiting for an earlier slot
+
+    portMUX_TYPE lock = portMUX_INITIALIZER_UNLOCKED;
+    SemaphoreHandle_t items, spaces;
+    StaticSemaphore_t items_buf, spaces_buf;
+};
+
+#endif
@@ -0,0 +1,221 @@
+#ifndef WORKPOOL_H_
+#define WORKPOOL_H_
+
+#include <Arduino.h>
+#include <atomic>
+#include <mpmcRing.h>
+
+/*
+    Work-stealing consumer pool: WorkPool<T, DEQ_LEN, MAX_WORKERS>
+
+    In Sixth_Challenge_2.cpp both consumers pull from one queue: both cores
+    fight for the same queue head, and a consumer stuck on serialMutex can't
+    hand its work to anyone. Here every worker has its own deque:
+
+        - producers push to the least loaded deque (or to a given one)
+        - a worker takes from the front of its own deque (oldest first)
+        - a worker with nothing to do steals the oldest item of the busiest
+          deque, so a backlog behind a slow item gets picked up by the others
+
+        static WorkPool<uint16_t, 16, 4> pool;
+        pool.begin(2);
+        pool.push(item, portMAX_DELAY);             //producers
+        pool.take(worker_num, &item, portMAX_DELAY);//worker 0, 1...
+
+    Every deque has its own spinlock, held only to move one item, so the
+    workers only meet when one of them steals. Every deque stays FIFO: the
+    classic thief takes the newest item, but here the oldest one is the one
+    hurting the latency the most. Idle workers sleep on their
+    task notification: a push wakes the worker it went to if it's asleep,
+    or another sleeping worker to steal it. Producers only sleep when every
+    deque is full.
+
+    NOTE: take() uses the worker task's notification value, like
+    ulTaskNotifyTake(). Each worker number must always be used by one task.
+*/
+
+template <typename T, uint16_t DEQ_LEN, uint8_t MAX_WORKERS>
+class WorkPool{
+
+    static_assert(MAX_WORKERS > 0 && MAX_WORKERS <= 32, "one idle bit per worker");
+
+public:
+
+    WorkPool() : workers(0), idle(0) {}
+
+    bool begin(uint8_t num_workers){
+        if(num_workers == 0 || num_workers > MAX_WORKERS)
+            return false;
+        workers = num_workers;
+        idle.store(0);
+        for(uint8_t i = 0; i < MAX_WORKERS; i++){
+            deques[i].front = deques[i].count = 0;
+            deques[i].task.store(NULL);
+            deques[i].taken = deques[i].stolen = 0;
+        }
+        return producers.begin();
+    }
+
+    //********** Producers
+
+    //To the least loaded worker
+    BaseType_t push(const T &item, TickType_t ticks){
+        return pushTo(leastLoaded(), item, ticks);
+    }
+
+    //To worker w if it has room, else to the least loaded one
+    BaseType_t pushTo(uint8_t w, const T &item, TickType_t ticks){
+
+        TickType_t start = xTaskGetTickCount();
+
+        while(!tryPush(w, item)){
+            producers.enter();
+            if(tryPush(w, item)){
+                producers.leave();
+                break;
+            }
+            TickType_t spent = xTaskGetTickCount() - start;
+            if(ticks != portMAX_DELAY && spent >= ticks){
+                producers.leave();
+                return pdFALSE;
+            }
+            producers.sleep(ticks == portMAX_DELAY ? portMAX_DELAY : ticks - spent);
+        }
+        return pdTRUE;
+    }
+
+    //********** Workers
+
+    BaseType_t take(uint8_t w, T *item, TickType_t ticks){
+
+        TickType_t start = xTaskGetTickCount();
+        uint32_t bit = 1UL << w;
+
+        if(deques[w].task.load(std::memory_order_relaxed) == NULL)
+            deques[w].task.store(xTaskGetCurrentTaskHandle(), std::memory_order_relaxed);
+
+        while(!tryTake(w, item)){
+            //Say we're idle, and look again before sleeping
+            idle.fetch_or(bit, std::memory_order_seq_cst);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if(tryTake(w, item)){
+                idle.fetch_and(~bit, std::memory_order_relaxed);
+                break;
+            }
+            TickType_t spent = xTaskGetTickCount() - start;
+            if(ticks != portMAX_DELAY && spent >= ticks){
+                idle.fetch_and(~bit, std::memory_order_relaxed);
+                return pdFALSE;
+            }
+            ulTaskNotifyTake(pdTRUE, ticks == portMAX_DELAY ? portMAX_DELAY : ticks - spent);
+            idle.fetch_and(~bit, std::memory_order_relaxed);
+        }
+        producers.wake();
+        return pdTRUE;
+    }
+
+    //********** Statistics
+
+    uint16_t waiting(uint8_t w) const { return deques[w].count; }
+    uint32_t taken(uint8_t w) const { return deques[w].taken; }     //from its own deque
+    uint32_t stolen(uint8_t w) const { return deques[w].stolen; }   //from the others
+
+private:
+
+    struct Deque{
+        T items[DEQ_LEN];
+        volatile uint16_t front, count;
+        std::atomic<TaskHandle_t> task;     //the worker, once it called take()
+        uint32_t taken, stolen;
+        portMUX_TYPE lock = portMUX_INITIALIZER_UNLOCKED;
+    };
+
+    //Reads the counts without the locks, it's only a hint
+    uint8_t leastLoaded() const {
+        uint8_t best = 0;
+        for(uint8_t i = 1; i < workers; i++)
+            if(deques[i].count < deques[best].count)
+                best = i;
+        return best;
+    }
+
+    bool pushBack(uint8_t w, const T &item){
+        Deque &d = deques[w];
+        bool ok = false;
+        portENTER_CRITICAL(&d.lock);
+        if(d.count < DEQ_LEN){
+            d.items[(d.front + d.count) % DEQ_LEN] = item;
+            d.count++;
+            ok = true;
+        }
+        portEXIT_CRITICAL(&d.lock);
+        return ok;
+    }
+
+    bool tryPush(uint8_t w, const T &item){
+
+        if(!pushBack(w, item)){
+            w = leastLoaded();
+            if(!pushBack(w, item))
+                return false;
+        }
+
+        //Wake the owner if it sleeps, or else any sleeping worker to steal it.
+        //Clearing its idle bit claims it, so the next push wakes someone else.
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        uint32_t sleeping = idle.load(std::memory_order_relaxed);
+        while(sleeping != 0){
+            uint8_t target = (sleeping & (1UL << w)) ? w : __builtin_ctz(sleeping);
+            if(idle.compare_exchange_weak(sleeping, sleeping & ~(1UL << target), std::memory_order_relaxed)){
+                TaskHandle_t task = deques[target].task.load(std::memory_order_relaxed);
+                if(task != NULL)
+                    xTaskNotifyGive(task);
+                break;
+            }
+        }
+        return true;
+    }
+
+    bool popFront(uint8_t w, T *item){
+        Deque &d = deques[w];
+        bool ok = false;
+        portENTER_CRITICAL(&d.lock);
+        if(d.count > 0){
+            *item = d.items[d.front];
+            d.front = (d.front + 1) % DEQ_LEN;
+            d.count--;
+            ok = true;
+        }
+        portEXIT_CRITICAL(&d.lock);
+        return ok;
+    }
+
+    //Own deque first, then steal from the busiest one
+    bool tryTake(uint8_t w, T *item){
+
+        if(popFront(w, item)){
+            deques[w].taken++;
+            return true;
+        }
+
+        while(1){
+            uint8_t victim = w;
+            for(uint8_t i = 0; i < workers; i++)
+                if(i != w && deques[i].count > deques[victim].count)
+                    victim = i;
+            if(victim == w)
+                return false;
+            if(popFront(victim, item)){
+                deques[w].stolen++;
+                return true;
+            }
+        }
+    }
+
+    Deque deques[MAX_WORKERS];
+    uint8_t workers;
+    std::atomic<uint32_t> idle;             //one bit per sleeping worker
+    WaitList producers;                     //waiting for room in a full pool
+};
+
+#endif